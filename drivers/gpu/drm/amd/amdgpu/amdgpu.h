@@ -452,18 +452,39 @@ int amdgpu_gem_prime_mmap(struct drm_gem_object *obj, struct vm_area_struct *vma
  */
 
 #define AMDGPU_SA_NUM_FENCE_LISTS	32
+#define AMDGPU_SA_MAX_PARTS		4
 
-struct amdgpu_sa_manager {
+struct amdgpu_sa_manager;
+
+/* one independently managed ring of the sub-allocation buffer */
+struct amdgpu_sa_part {
 	wait_queue_head_t	wq;
-	struct amdgpu_bo	*bo;
+	struct amdgpu_sa_manager *manager;
 	struct list_head	*hole;
 	struct list_head	flist[AMDGPU_SA_NUM_FENCE_LISTS];
 	struct list_head	olist;
+	unsigned		offset;
+	unsigned		size;
+	/* only a spanning allocation may use it, protected by wq.lock */
+	bool			reserved;
+	/* statistics, protected by wq.lock */
+	u64			allocs;
+	u64			fallbacks;
+	u64			waits;
+	u64			wait_ns;
+};
+
+struct amdgpu_sa_manager {
+	struct amdgpu_bo	*bo;
 	unsigned		size;
 	uint64_t		gpu_addr;
 	void			*cpu_ptr;
 	uint32_t		domain;
 	uint32_t		align;
+	unsigned		num_parts;
+	struct amdgpu_sa_part	parts[AMDGPU_SA_MAX_PARTS];
+	/* serializes allocations larger than a partition */
+	struct mutex		span_lock;
 };
 
 /* sub-allocation buffer */
@@ -471,9 +492,12 @@ struct amdgpu_sa_bo {
 	struct list_head		olist;
 	struct list_head		flist;
 	struct amdgpu_sa_manager	*manager;
+	struct amdgpu_sa_part		*part;
 	unsigned			soffset;
 	unsigned			eoffset;
 	struct dma_fence	        *fence;
+	/* next partition of an allocation spanning several */
+	struct amdgpu_sa_bo		*span;
 };
 
 /*
@@ -726,9 +750,14 @@ int amdgpu_queue_mgr_map(struct amdgpu_device *adev,
  * context related structures
  */
 
+/* The per ring fence history grows up to amdgpu_sched_jobs << this */
+#define AMDGPU_CTX_MAX_FENCES_SHIFT	4
+
 struct amdgpu_ctx_ring {
 	uint64_t		sequence;
+	/* fences of the last num_fences submissions, indexed by sequence */
 	struct dma_fence	**fences;
+	unsigned		num_fences;
 	struct drm_sched_entity	entity;
 };
 
@@ -740,7 +769,6 @@ struct amdgpu_ctx {
 	unsigned        reset_counter_query;
 	uint32_t		vram_lost_counter;
 	spinlock_t		ring_lock;
-	struct dma_fence	**fences;
 	struct amdgpu_ctx_ring	rings[AMDGPU_MAX_RINGS];
 	bool			preamble_presented;
 	enum drm_sched_priority init_priority;
@@ -763,6 +791,9 @@ int amdgpu_ctx_add_fence(struct amdgpu_ctx *ctx, struct amdgpu_ring *ring,
 			      struct dma_fence *fence, uint64_t *seq);
 struct dma_fence *amdgpu_ctx_get_fence(struct amdgpu_ctx *ctx,
 				   struct amdgpu_ring *ring, uint64_t seq);
+struct dma_fence *amdgpu_ctx_get_pending_fence(struct amdgpu_ctx *ctx,
+					       struct amdgpu_ring *ring,
+					       uint64_t seq);
 void amdgpu_ctx_priority_override(struct amdgpu_ctx *ctx,
 				  enum drm_sched_priority priority);
 
@@ -810,6 +841,10 @@ struct amdgpu_bo_list {
 	unsigned first_userptr;
 	unsigned num_entries;
 	struct amdgpu_bo_list_entry *array;
+
+	/* all BOs validated into their preferred domains at num_bo_moves */
+	bool resident;
+	u64 resident_moves;
 };
 
 struct amdgpu_bo_list *
@@ -1100,6 +1135,7 @@ struct amdgpu_cs_parser {
 	uint64_t			bytes_moved_vis_threshold;
 	uint64_t			bytes_moved;
 	uint64_t			bytes_moved_vis;
+	bool				all_preferred;
 	struct amdgpu_bo_list_entry	*evictable;
 
 	/* user fence */
@@ -1229,6 +1265,7 @@ struct amdgpu_firmware {
  * Benchmarking
  */
 void amdgpu_benchmark(struct amdgpu_device *adev, int test_number);
+void amdgpu_benchmark_suite(struct amdgpu_device *adev, struct seq_file *m);
 
 
 /*
@@ -1592,6 +1629,7 @@ struct amdgpu_device {
 	struct amdgpu_wb		wb;
 	atomic64_t			num_bytes_moved;
 	atomic64_t			num_evictions;
+	atomic64_t			num_bo_moves;
 	atomic64_t			num_vram_cpu_page_faults;
 	atomic_t			gpu_reset_counter;
 	atomic_t			vram_lost_counter;
@@ -1603,6 +1641,8 @@ struct amdgpu_device {
 		s64			accum_us; /* accumulated microseconds */
 		s64			accum_us_vis; /* for visible VRAM */
 		u32			log2_max_MBps;
+		u32			measured_MBps; /* copy engine throughput */
+		atomic64_t		num_throttled; /* moves denied by budget */
 	} mm_stats;
 
 	/* display */
@@ -1902,6 +1942,8 @@ void amdgpu_device_pci_config_reset(struct amdgpu_device *adev);
 bool amdgpu_device_need_post(struct amdgpu_device *adev);
 void amdgpu_update_display_priority(struct amdgpu_device *adev);
 
+void amdgpu_cs_report_copy_rate(struct amdgpu_device *adev, u64 num_bytes,
+				s64 time_ns);
 void amdgpu_cs_report_moved_bytes(struct amdgpu_device *adev, u64 num_bytes,
 				  u64 num_vis_bytes);
 void amdgpu_ttm_placement_from_domain(struct amdgpu_bo *abo, u32 domain);
@@ -27,6 +27,8 @@
 
 #define AMDGPU_BENCHMARK_ITERATIONS 1024
 #define AMDGPU_BENCHMARK_COMMON_MODES_N 17
+#define AMDGPU_BENCHMARK_SUBMISSIONS 256
+#define AMDGPU_BENCHMARK_EVICT_BOS 64
 
 static int amdgpu_benchmark_do_move(struct amdgpu_device *adev, unsigned size,
 				    uint64_t saddr, uint64_t daddr, int n)
@@ -140,6 +142,325 @@ out_cleanup:
 	}
 }
 
+/*
+ * Benchmark suite
+ *
+ * Results are printed one per line as "<name> <value> <unit>", either
+ * into debugfs or the kernel log. Parts which need a working GPU ring
+ * are skipped when the buffer functions ring isn't ready, so the CPU
+ * side still gets measured e.g. with virtual display only setups.
+ */
+static void amdgpu_benchmark_report(struct seq_file *m, const char *name,
+				    u64 value, const char *unit)
+{
+	if (m)
+		seq_printf(m, "%s %llu %s\n", name, value, unit);
+	else
+		DRM_INFO("amdgpu: benchmark %s %llu %s\n", name, value, unit);
+}
+
+static u64 amdgpu_benchmark_rate(u64 n, s64 us)
+{
+	return div64_u64(n * USEC_PER_SEC, max_t(s64, us, 1));
+}
+
+static void amdgpu_benchmark_bo_create(struct amdgpu_device *adev,
+				       struct seq_file *m, u32 domain,
+				       const char *create, const char *destroy)
+{
+	struct amdgpu_bo **bos;
+	ktime_t time;
+	s64 create_us;
+	int i, n, r = 0;
+
+	bos = kcalloc(AMDGPU_BENCHMARK_ITERATIONS, sizeof(*bos), GFP_KERNEL);
+	if (!bos)
+		return;
+
+	time = ktime_get();
+	for (n = 0; n < AMDGPU_BENCHMARK_ITERATIONS; n++) {
+		r = amdgpu_bo_create(adev, PAGE_SIZE, PAGE_SIZE, true, domain,
+				     0, NULL, NULL, 0, &bos[n]);
+		if (r)
+			break;
+	}
+	create_us = ktime_us_delta(ktime_get(), time);
+
+	time = ktime_get();
+	for (i = 0; i < n; i++)
+		amdgpu_bo_unref(&bos[i]);
+
+	if (r) {
+		DRM_ERROR("Error (%d) while benchmarking BO creation.\n", r);
+	} else {
+		amdgpu_benchmark_report(m, create,
+					amdgpu_benchmark_rate(n, create_us),
+					"ops/s");
+		amdgpu_benchmark_report(m, destroy,
+					amdgpu_benchmark_rate(n, ktime_us_delta(
+							ktime_get(), time)),
+					"ops/s");
+	}
+	kfree(bos);
+}
+
+/*
+ * Emit bare fences to the buffer functions ring and measure how long it
+ * takes from committing each one until a waiter sees it signaled, i.e.
+ * the GPU round trip plus interrupt and fence processing.
+ */
+static void amdgpu_benchmark_ring_fence(struct amdgpu_device *adev,
+					struct seq_file *m)
+{
+	struct amdgpu_ring *ring = adev->mman.buffer_funcs_ring;
+	s64 total_ns = 0;
+	int i, r = 0;
+
+	/* the ring is written directly, keep the scheduler off it */
+	if (ring->sched.thread)
+		kthread_park(ring->sched.thread);
+
+	for (i = 0; i < AMDGPU_BENCHMARK_SUBMISSIONS; i++) {
+		struct dma_fence *fence;
+		ktime_t time;
+
+		r = amdgpu_ring_alloc(ring, ring->funcs->emit_frame_size);
+		if (r)
+			break;
+
+		r = amdgpu_fence_emit(ring, &fence);
+		if (r) {
+			amdgpu_ring_undo(ring);
+			break;
+		}
+		time = ktime_get();
+		amdgpu_ring_commit(ring);
+
+		r = dma_fence_wait(fence, false);
+		total_ns += ktime_to_ns(ktime_sub(ktime_get(), time));
+		dma_fence_put(fence);
+		if (r)
+			break;
+	}
+
+	if (ring->sched.thread)
+		kthread_unpark(ring->sched.thread);
+
+	if (r) {
+		DRM_ERROR("Error (%d) while benchmarking ring fences.\n", r);
+		return;
+	}
+
+	amdgpu_benchmark_report(m, "ring_fence_latency",
+				div_u64(total_ns, AMDGPU_BENCHMARK_SUBMISSIONS),
+				"ns");
+}
+
+static int amdgpu_benchmark_pin(struct amdgpu_device *adev, unsigned size,
+				u32 domain, struct amdgpu_bo **bo, u64 *addr)
+{
+	int r;
+
+	r = amdgpu_bo_create(adev, size, PAGE_SIZE, true, domain, 0, NULL,
+			     NULL, 0, bo);
+	if (r)
+		return r;
+
+	r = amdgpu_bo_reserve(*bo, false);
+	if (!r) {
+		r = amdgpu_bo_pin(*bo, domain, addr);
+		amdgpu_bo_unreserve(*bo);
+	}
+	if (r)
+		amdgpu_bo_unref(bo);
+	return r;
+}
+
+static void amdgpu_benchmark_unpin(struct amdgpu_bo **bo)
+{
+	if (!*bo)
+		return;
+
+	if (likely(amdgpu_bo_reserve(*bo, true) == 0)) {
+		amdgpu_bo_unpin(*bo);
+		amdgpu_bo_unreserve(*bo);
+	}
+	amdgpu_bo_unref(bo);
+}
+
+/*
+ * Submit small kernel copy jobs through the scheduler and measure how
+ * long it takes until each job is pushed to the ring and until its fence
+ * signals. This doesn't include the command submission ioctl.
+ */
+static void amdgpu_benchmark_submit(struct amdgpu_device *adev,
+				    struct seq_file *m)
+{
+	struct amdgpu_ring *ring = adev->mman.buffer_funcs_ring;
+	struct amdgpu_bo *bo = NULL;
+	s64 submit_ns = 0, complete_ns = 0;
+	u64 addr;
+	int i, r;
+
+	r = amdgpu_benchmark_pin(adev, 2 * PAGE_SIZE, AMDGPU_GEM_DOMAIN_GTT,
+				 &bo, &addr);
+	if (r)
+		goto out;
+
+	for (i = 0; i < AMDGPU_BENCHMARK_SUBMISSIONS; i++) {
+		struct drm_sched_fence *s_fence;
+		struct dma_fence *fence = NULL;
+		ktime_t time = ktime_get();
+
+		r = amdgpu_copy_buffer(ring, addr, addr + PAGE_SIZE, PAGE_SIZE,
+				       NULL, &fence, false, false);
+		if (r)
+			goto out;
+
+		s_fence = to_drm_sched_fence(fence);
+		if (s_fence) {
+			r = dma_fence_wait(&s_fence->scheduled, false);
+			submit_ns += ktime_to_ns(ktime_sub(ktime_get(), time));
+		}
+		if (!r)
+			r = dma_fence_wait(fence, false);
+		complete_ns += ktime_to_ns(ktime_sub(ktime_get(), time));
+		dma_fence_put(fence);
+		if (r)
+			goto out;
+	}
+
+	amdgpu_benchmark_report(m, "sched_copy_submit_latency",
+				div_u64(submit_ns, AMDGPU_BENCHMARK_SUBMISSIONS),
+				"ns");
+	amdgpu_benchmark_report(m, "sched_copy_complete_latency",
+				div_u64(complete_ns,
+					AMDGPU_BENCHMARK_SUBMISSIONS),
+				"ns");
+
+out:
+	if (r)
+		DRM_ERROR("Error (%d) while benchmarking submission.\n", r);
+	amdgpu_benchmark_unpin(&bo);
+}
+
+/* Move a set of 1MB VRAM BOs to GTT and back */
+static void amdgpu_benchmark_evict(struct amdgpu_device *adev,
+				   struct seq_file *m)
+{
+	struct ttm_operation_ctx ctx = { false, false };
+	struct amdgpu_bo *bos[AMDGPU_BENCHMARK_EVICT_BOS];
+	static const u32 domains[] = {
+		AMDGPU_GEM_DOMAIN_GTT, AMDGPU_GEM_DOMAIN_VRAM
+	};
+	static const char * const names[] = {
+		"evict_throughput", "restore_throughput"
+	};
+	int i, j, n, r = 0;
+
+	for (n = 0; n < AMDGPU_BENCHMARK_EVICT_BOS; n++) {
+		r = amdgpu_bo_create(adev, SZ_1M, PAGE_SIZE, true,
+				     AMDGPU_GEM_DOMAIN_VRAM, 0, NULL, NULL, 0,
+				     &bos[n]);
+		if (r)
+			goto out;
+	}
+
+	for (j = 0; j < ARRAY_SIZE(domains); j++) {
+		ktime_t time = ktime_get();
+
+		for (i = 0; i < n; i++) {
+			r = amdgpu_bo_reserve(bos[i], false);
+			if (r)
+				goto out;
+			amdgpu_ttm_placement_from_domain(bos[i], domains[j]);
+			r = ttm_bo_validate(&bos[i]->tbo, &bos[i]->placement,
+					    &ctx);
+			amdgpu_bo_unreserve(bos[i]);
+			if (r)
+				goto out;
+		}
+		for (i = 0; i < n; i++) {
+			long t = reservation_object_wait_timeout_rcu(
+				bos[i]->tbo.resv, true, false,
+				MAX_SCHEDULE_TIMEOUT);
+			if (t < 0) {
+				r = t;
+				goto out;
+			}
+		}
+
+		/* MB/s, with n MB moved */
+		amdgpu_benchmark_report(m, names[j],
+					amdgpu_benchmark_rate(n, ktime_us_delta(
+							ktime_get(), time)),
+					"MB/s");
+	}
+
+out:
+	if (r)
+		DRM_ERROR("Error (%d) while benchmarking eviction.\n", r);
+	for (i = 0; i < n; i++)
+		amdgpu_bo_unref(&bos[i]);
+}
+
+static void amdgpu_benchmark_pte(struct amdgpu_device *adev,
+				 struct seq_file *m)
+{
+	struct amdgpu_vm_bench_result res;
+	int r;
+
+	r = amdgpu_vm_benchmark(adev, &res);
+	if (r == -ENOSPC)
+		return;
+	if (r) {
+		DRM_ERROR("Error (%d) while benchmarking PTE updates.\n", r);
+		return;
+	}
+
+	amdgpu_benchmark_report(m, "pte_update_linear",
+				amdgpu_benchmark_rate(res.num_pages,
+						      res.linear_us),
+				"ptes/s");
+	amdgpu_benchmark_report(m, "pte_update_64k",
+				amdgpu_benchmark_rate(res.num_pages,
+						      res.chunked_us),
+				"ptes/s");
+	amdgpu_benchmark_report(m, "pte_clear",
+				amdgpu_benchmark_rate(res.num_pages,
+						      res.clear_us),
+				"ptes/s");
+}
+
+/**
+ * amdgpu_benchmark_suite - run the structured benchmarks
+ *
+ * @adev: amdgpu_device pointer
+ * @m: seq_file to print the results to, or NULL for the kernel log
+ */
+void amdgpu_benchmark_suite(struct amdgpu_device *adev, struct seq_file *m)
+{
+	struct amdgpu_ring *ring = adev->mman.buffer_funcs_ring;
+	bool gpu = ring && ring->ready;
+
+	amdgpu_benchmark_report(m, "gpu_rings", gpu, "bool");
+
+	amdgpu_benchmark_bo_create(adev, m, AMDGPU_GEM_DOMAIN_CPU,
+				   "bo_create_cpu", "bo_destroy_cpu");
+	amdgpu_benchmark_bo_create(adev, m, AMDGPU_GEM_DOMAIN_GTT,
+				   "bo_create_gtt", "bo_destroy_gtt");
+
+	if (!gpu)
+		return;
+
+	amdgpu_benchmark_bo_create(adev, m, AMDGPU_GEM_DOMAIN_VRAM,
+				   "bo_create_vram", "bo_destroy_vram");
+	amdgpu_benchmark_ring_fence(adev, m);
+	amdgpu_benchmark_submit(adev, m);
+	amdgpu_benchmark_evict(adev, m);
+	amdgpu_benchmark_pte(adev, m);
+}
+
 void amdgpu_benchmark(struct amdgpu_device *adev, int test_number)
 {
 	int i;
@@ -218,6 +539,10 @@ void amdgpu_benchmark(struct amdgpu_device *adev, int test_number)
 					      AMDGPU_GEM_DOMAIN_VRAM,
 					      AMDGPU_GEM_DOMAIN_VRAM);
 		break;
+	case 9:
+		/* everything, see amdgpu_benchmark_suite */
+		amdgpu_benchmark_suite(adev, NULL);
+		break;
 
 	default:
 		DRM_ERROR("Unknown benchmark\n");
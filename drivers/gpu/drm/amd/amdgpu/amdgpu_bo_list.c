@@ -178,6 +178,7 @@ static int amdgpu_bo_list_set(struct amdgpu_device *adev,
 	list->first_userptr = first_userptr;
 	list->array = array;
 	list->num_entries = num_entries;
+	list->resident = false;
 
 	trace_amdgpu_cs_bo_status(list->num_entries, total_size);
 	return 0;
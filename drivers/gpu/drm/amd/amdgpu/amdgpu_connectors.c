@@ -922,7 +922,14 @@ amdgpu_connector_vga_detect(struct drm_connector *connector, bool force)
 		}
 	}
 
-	amdgpu_connector_update_scratch_regs(connector, ret);
+	/*
+	 * The output poll worker detects VGA connectors without the modeset
+	 * locks, see DRM_CONNECTOR_POLL_PARALLEL below, which the scratch
+	 * registers are updated under everywhere else. A change it finds
+	 * leads to a forced probe, which updates them.
+	 */
+	if (!drm_kms_helper_is_poll_worker())
+		amdgpu_connector_update_scratch_regs(connector, ret);
 
 out:
 	if (!drm_kms_helper_is_poll_worker()) {
@@ -1916,6 +1923,9 @@ amdgpu_connector_add(struct amdgpu_device *adev,
 		if (i2c_bus->valid) {
 			connector->polled = DRM_CONNECTOR_POLL_CONNECT |
 			                    DRM_CONNECTOR_POLL_DISCONNECT;
+			/* VGA detection only probes DDC when not forced */
+			if (connector->funcs == &amdgpu_connector_vga_funcs)
+				connector->polled |= DRM_CONNECTOR_POLL_PARALLEL;
 		}
 	} else
 		connector->polled = DRM_CONNECTOR_POLL_HPD;
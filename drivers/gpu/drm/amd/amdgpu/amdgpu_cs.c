@@ -26,6 +26,7 @@
  */
 #include <linux/pagemap.h>
 #include <linux/sync_file.h>
+#include <linux/dma-fence-array.h>
 #include <drm/drmP.h>
 #include <drm/amdgpu_drm.h>
 #include <drm/drm_syncobj.h>
@@ -202,6 +203,11 @@ free_chunk:
 	return ret;
 }
 
+/* Floor for the automatic move rate, in MB/s */
+#define AMDGPU_MOVE_RATE_MIN_MBPS	8u
+/* Share of the measured copy bandwidth the automatic move rate allows */
+#define AMDGPU_MOVE_RATE_SHARE_SHIFT	6
+
 /* Convert microseconds to bytes. */
 static u64 us_to_bytes(struct amdgpu_device *adev, s64 us)
 {
@@ -263,6 +269,18 @@ static void amdgpu_cs_get_threshold_for_moves(struct amdgpu_device *adev,
 
 	spin_lock(&adev->mm_stats.lock);
 
+	/* With an automatic move rate, let buffer moves take a fixed share
+	 * of what the copy engine has actually been measured to deliver,
+	 * but never less than the static default.
+	 */
+	if (amdgpu_moverate < 0) {
+		u32 measured_MBps = READ_ONCE(adev->mm_stats.measured_MBps);
+
+		adev->mm_stats.log2_max_MBps =
+			ilog2(max(AMDGPU_MOVE_RATE_MIN_MBPS,
+				  measured_MBps >> AMDGPU_MOVE_RATE_SHARE_SHIFT));
+	}
+
 	/* Increase the amount of accumulated us. */
 	time_us = ktime_to_us(ktime_get());
 	increment_us = time_us - adev->mm_stats.last_update_us;
@@ -339,6 +357,32 @@ void amdgpu_cs_report_moved_bytes(struct amdgpu_device *adev, u64 num_bytes,
 	spin_unlock(&adev->mm_stats.lock);
 }
 
+/* Called when a TTM copy finished, with the time the copy engine took for it.
+ * Keeps a running average of the achieved copy bandwidth in MB/s. This may
+ * run in interrupt context, so it doesn't take mm_stats.lock; a lost update
+ * only drops one sample.
+ */
+void amdgpu_cs_report_copy_rate(struct amdgpu_device *adev, u64 num_bytes,
+				s64 time_ns)
+{
+	u32 old_MBps, new_MBps;
+	u64 sample;
+
+	if (time_ns <= 0)
+		return;
+
+	/* bytes per ns * 1000 is MB/s */
+	sample = div64_u64(num_bytes * 1000, time_ns);
+	sample = min_t(u64, sample, U32_MAX);
+
+	old_MBps = READ_ONCE(adev->mm_stats.measured_MBps);
+	if (old_MBps)
+		new_MBps = old_MBps - (old_MBps >> 3) + ((u32)sample >> 3);
+	else
+		new_MBps = sample;
+	WRITE_ONCE(adev->mm_stats.measured_MBps, new_MBps);
+}
+
 static int amdgpu_cs_bo_validate(struct amdgpu_cs_parser *p,
 				 struct amdgpu_bo *bo)
 {
@@ -352,8 +396,13 @@ static int amdgpu_cs_bo_validate(struct amdgpu_cs_parser *p,
 	uint32_t domain;
 	int r;
 
-	if (bo->pin_count)
+	/* Pinned BOs stay where they are, maybe outside their preferred domain */
+	if (bo->pin_count) {
+		if (!(amdgpu_mem_type_to_domain(bo->tbo.mem.mem_type) &
+		      bo->preferred_domains))
+			p->all_preferred = false;
 		return 0;
+	}
 
 	/* Don't move this buffer if we have depleted our allowance
 	 * to move it. Don't move anything if the threshold is zero.
@@ -391,6 +440,14 @@ retry:
 		goto retry;
 	}
 
+	if (!(amdgpu_mem_type_to_domain(bo->tbo.mem.mem_type) &
+	      bo->preferred_domains)) {
+		p->all_preferred = false;
+		/* The move budget kept this BO out of its preferred domain */
+		if (domain != bo->preferred_domains)
+			atomic64_inc(&adev->mm_stats.num_throttled);
+	}
+
 	return r;
 }
 
@@ -451,6 +508,11 @@ static bool amdgpu_cs_try_evict(struct amdgpu_cs_parser *p,
 		if (unlikely(r))
 			break;
 
+		/* The list can't be treated as resident with this BO moved away */
+		if (!(amdgpu_mem_type_to_domain(bo->tbo.mem.mem_type) &
+		      bo->preferred_domains))
+			p->all_preferred = false;
+
 		p->evictable = list_prev_entry(p->evictable, tv.head);
 		list_move(&candidate->tv.head, &p->validated);
 
@@ -521,6 +583,39 @@ static int amdgpu_cs_list_validate(struct amdgpu_cs_parser *p,
 	return 0;
 }
 
+/*
+ * A BO list which an earlier submission validated completely into the
+ * preferred domains doesn't need to be validated again as long as no BO was
+ * moved since, amdgpu_bo_move_notify() counts every move. Changes to the
+ * domains or placement flags of a BO are counted as well. This saves walking
+ * the whole list through TTM for each submission of large working sets.
+ */
+static bool amdgpu_cs_bo_list_resident(struct amdgpu_cs_parser *p)
+{
+	struct amdgpu_bo_list *list = p->bo_list;
+
+	if (!list || !list->resident)
+		return false;
+
+	/* userptrs and user fences may need to be bound */
+	if (list->first_userptr != list->num_entries || p->uf_entry.robj)
+		return false;
+
+	return list->resident_moves == atomic64_read(&p->adev->num_bo_moves);
+}
+
+static void amdgpu_cs_bo_list_set_resident(struct amdgpu_cs_parser *p)
+{
+	struct amdgpu_bo_list *list = p->bo_list;
+
+	if (!list)
+		return;
+
+	/* Nobody can move our BOs while we have them reserved */
+	list->resident = p->all_preferred;
+	list->resident_moves = atomic64_read(&p->adev->num_bo_moves);
+}
+
 static int amdgpu_cs_parser_bos(struct amdgpu_cs_parser *p,
 				union drm_amdgpu_cs *cs)
 {
@@ -650,10 +745,14 @@ static int amdgpu_cs_parser_bos(struct amdgpu_cs_parser *p,
 		goto error_validate;
 	}
 
-	r = amdgpu_cs_list_validate(p, &p->validated);
-	if (r) {
-		DRM_ERROR("amdgpu_cs_list_validate(validated) failed.\n");
-		goto error_validate;
+	if (!amdgpu_cs_bo_list_resident(p)) {
+		p->all_preferred = true;
+		r = amdgpu_cs_list_validate(p, &p->validated);
+		if (r) {
+			DRM_ERROR("amdgpu_cs_list_validate(validated) failed.\n");
+			goto error_validate;
+		}
+		amdgpu_cs_bo_list_set_resident(p);
 	}
 
 	amdgpu_cs_report_moved_bytes(p->adev, p->bytes_moved,
@@ -1036,8 +1135,8 @@ static int amdgpu_cs_process_fence_dep(struct amdgpu_cs_parser *p,
 			return r;
 		}
 
-		fence = amdgpu_ctx_get_fence(ctx, ring,
-					     deps[i].handle);
+		fence = amdgpu_ctx_get_pending_fence(ctx, ring,
+						     deps[i].handle);
 		if (IS_ERR(fence)) {
 			r = PTR_ERR(fence);
 			amdgpu_ctx_put(ctx);
@@ -1425,36 +1524,95 @@ static int amdgpu_cs_wait_all_fences(struct amdgpu_device *adev,
 				     union drm_amdgpu_wait_fences *wait,
 				     struct drm_amdgpu_fence *fences)
 {
+	unsigned long timeout = amdgpu_gem_timeout(wait->in.timeout_ns);
 	uint32_t fence_count = wait->in.fence_count;
-	unsigned int i;
+	struct dma_fence_array *fence_array;
+	struct dma_fence **array, **shared;
+	unsigned int i, count = 0, pending = 0;
 	long r = 1;
 
+	array = kcalloc(fence_count, sizeof(struct dma_fence *), GFP_KERNEL);
+	if (array == NULL)
+		return -ENOMEM;
+
+	/* Keep the signaled fences as well, their errors are reported too */
 	for (i = 0; i < fence_count; i++) {
 		struct dma_fence *fence;
-		unsigned long timeout = amdgpu_gem_timeout(wait->in.timeout_ns);
 
 		fence = amdgpu_cs_get_fence(adev, filp, &fences[i]);
-		if (IS_ERR(fence))
-			return PTR_ERR(fence);
-		else if (!fence)
-			continue;
+		if (IS_ERR(fence)) {
+			r = PTR_ERR(fence);
+			goto err_put_fences;
+		} else if (fence) {
+			array[count++] = fence;
+		}
+	}
 
-		r = dma_fence_wait_timeout(fence, true, timeout);
-		dma_fence_put(fence);
-		if (r < 0)
-			return r;
+	shared = kcalloc(count, sizeof(struct dma_fence *), GFP_KERNEL);
+	if (shared == NULL) {
+		r = -ENOMEM;
+		goto err_put_fences;
+	}
 
-		if (r == 0)
-			break;
+	/* Only wait for the fences which are still pending */
+	for (i = 0; i < count; i++) {
+		if (!dma_fence_is_signaled(array[i]))
+			shared[pending++] = array[i];
+	}
+
+	if (pending == 0) {
+		kfree(shared);
+		goto check_errors;
+	}
+
+	if (pending == 1) {
+		r = dma_fence_wait_timeout(shared[0], true, timeout);
+		kfree(shared);
+		goto check_errors;
+	}
+
+	/* Wait for all of them at once. The fence array owns the pointers
+	 * and its own references, we still need ours for the errors.
+	 */
+	for (i = 0; i < pending; i++)
+		dma_fence_get(shared[i]);
+
+	fence_array = dma_fence_array_create(pending, shared,
+					     dma_fence_context_alloc(1), 1,
+					     false);
+	if (!fence_array) {
+		for (i = 0; i < pending; i++)
+			dma_fence_put(shared[i]);
+		kfree(shared);
+		r = -ENOMEM;
+		goto err_put_fences;
+	}
 
-		if (fence->error)
-			return fence->error;
+	r = dma_fence_wait_timeout(&fence_array->base, true, timeout);
+	dma_fence_put(&fence_array->base);
+
+check_errors:
+	if (r < 0)
+		goto err_put_fences;
+
+	/* Errors are only set before signaling, even on a timeout */
+	for (i = 0; i < count; i++) {
+		if (array[i]->error) {
+			r = array[i]->error;
+			goto err_put_fences;
+		}
 	}
 
 	memset(wait, 0, sizeof(*wait));
 	wait->out.status = (r > 0);
+	r = 0;
 
-	return 0;
+err_put_fences:
+	for (i = 0; i < count; i++)
+		dma_fence_put(array[i]);
+	kfree(array);
+
+	return r;
 }
 
 /**
@@ -1492,7 +1650,7 @@ static int amdgpu_cs_wait_any_fence(struct amdgpu_device *adev,
 			goto err_free_fence_array;
 		} else if (fence) {
 			array[i] = fence;
-		} else { /* NULL, the fence has been already signaled */
+		} else { /* NULL, the fence is too old and has signaled */
 			r = 1;
 			first = i;
 			goto out;
@@ -1602,6 +1760,7 @@ int amdgpu_cs_find_mapping(struct amdgpu_cs_parser *parser,
 
 	if (!((*bo)->flags & AMDGPU_GEM_CREATE_VRAM_CONTIGUOUS)) {
 		(*bo)->flags |= AMDGPU_GEM_CREATE_VRAM_CONTIGUOUS;
+		atomic64_inc(&parser->adev->num_bo_moves);
 		amdgpu_ttm_placement_from_domain(*bo, (*bo)->allowed_domains);
 		r = ttm_bo_validate(&(*bo)->tbo, &(*bo)->placement, &ctx);
 		if (r)
@@ -62,17 +62,11 @@ static int amdgpu_ctx_init(struct amdgpu_device *adev,
 	ctx->adev = adev;
 	kref_init(&ctx->refcount);
 	spin_lock_init(&ctx->ring_lock);
-	ctx->fences = kcalloc(amdgpu_sched_jobs * AMDGPU_MAX_RINGS,
-			      sizeof(struct dma_fence*), GFP_KERNEL);
-	if (!ctx->fences)
-		return -ENOMEM;
-
 	mutex_init(&ctx->lock);
 
-	for (i = 0; i < AMDGPU_MAX_RINGS; ++i) {
+	/* Fence history is allocated on first submission to a ring */
+	for (i = 0; i < AMDGPU_MAX_RINGS; ++i)
 		ctx->rings[i].sequence = 1;
-		ctx->rings[i].fences = &ctx->fences[amdgpu_sched_jobs * i];
-	}
 
 	ctx->reset_counter = atomic_read(&adev->gpu_reset_counter);
 	ctx->reset_counter_query = ctx->reset_counter;
@@ -106,8 +100,7 @@ failed:
 	for (j = 0; j < i; j++)
 		drm_sched_entity_fini(&adev->rings[j]->sched,
 				      &ctx->rings[j].entity);
-	kfree(ctx->fences);
-	ctx->fences = NULL;
+	mutex_destroy(&ctx->lock);
 	return r;
 }
 
@@ -119,11 +112,13 @@ static void amdgpu_ctx_fini(struct amdgpu_ctx *ctx)
 	if (!adev)
 		return;
 
-	for (i = 0; i < AMDGPU_MAX_RINGS; ++i)
-		for (j = 0; j < amdgpu_sched_jobs; ++j)
+	for (i = 0; i < AMDGPU_MAX_RINGS; ++i) {
+		for (j = 0; j < ctx->rings[i].num_fences; ++j)
 			dma_fence_put(ctx->rings[i].fences[j]);
-	kfree(ctx->fences);
-	ctx->fences = NULL;
+		kfree(ctx->rings[i].fences);
+		ctx->rings[i].fences = NULL;
+		ctx->rings[i].num_fences = 0;
+	}
 
 	for (i = 0; i < adev->num_rings; i++)
 		drm_sched_entity_fini(&adev->rings[i]->sched,
@@ -329,6 +324,38 @@ int amdgpu_ctx_put(struct amdgpu_ctx *ctx)
 	return 0;
 }
 
+/*
+ * Double the fence history of a ring, keeping the fences of the last
+ * num_fences submissions. Only called with ctx->lock held, readers are
+ * protected by ring_lock.
+ */
+static int amdgpu_ctx_ring_grow(struct amdgpu_ctx *ctx,
+				struct amdgpu_ctx_ring *cring)
+{
+	unsigned num_fences = cring->num_fences ?
+		cring->num_fences * 2 : amdgpu_sched_jobs;
+	struct dma_fence **fences, **old;
+	uint64_t seq;
+
+	fences = kcalloc(num_fences, sizeof(*fences), GFP_KERNEL);
+	if (!fences)
+		return -ENOMEM;
+
+	spin_lock(&ctx->ring_lock);
+	old = cring->fences;
+	seq = cring->sequence > cring->num_fences ?
+		cring->sequence - cring->num_fences : 1;
+	for (; seq < cring->sequence; ++seq)
+		fences[seq & (num_fences - 1)] =
+			old[seq & (cring->num_fences - 1)];
+	cring->fences = fences;
+	cring->num_fences = num_fences;
+	spin_unlock(&ctx->ring_lock);
+
+	kfree(old);
+	return 0;
+}
+
 int amdgpu_ctx_add_fence(struct amdgpu_ctx *ctx, struct amdgpu_ring *ring,
 			      struct dma_fence *fence, uint64_t* handler)
 {
@@ -337,7 +364,11 @@ int amdgpu_ctx_add_fence(struct amdgpu_ctx *ctx, struct amdgpu_ring *ring,
 	unsigned idx = 0;
 	struct dma_fence *other = NULL;
 
-	idx = seq & (amdgpu_sched_jobs - 1);
+	/* amdgpu_ctx_wait_prev_fence makes room for the new fence */
+	if (WARN_ON(!cring->num_fences))
+		return -EINVAL;
+
+	idx = seq & (cring->num_fences - 1);
 	other = cring->fences[idx];
 	if (other)
 		BUG_ON(!dma_fence_is_signaled(other));
@@ -373,12 +404,55 @@ struct dma_fence *amdgpu_ctx_get_fence(struct amdgpu_ctx *ctx,
 	}
 
 
-	if (seq + amdgpu_sched_jobs < cring->sequence) {
+	if (seq + cring->num_fences < cring->sequence) {
 		spin_unlock(&ctx->ring_lock);
 		return NULL;
 	}
 
-	fence = dma_fence_get(cring->fences[seq & (amdgpu_sched_jobs - 1)]);
+	fence = dma_fence_get(cring->fences[seq & (cring->num_fences - 1)]);
+	spin_unlock(&ctx->ring_lock);
+
+	return fence;
+}
+
+/**
+ * amdgpu_ctx_get_pending_fence - get a fence only if it hasn't signaled
+ *
+ * @ctx: the context
+ * @ring: ring the submission was made to
+ * @seq: sequence number of the submission
+ *
+ * Like amdgpu_ctx_get_fence, but returns NULL without taking a reference
+ * when the fence has already signaled. This loses the error of the fence, so
+ * it is only meant for dependencies, which have nothing to wait for then.
+ */
+struct dma_fence *amdgpu_ctx_get_pending_fence(struct amdgpu_ctx *ctx,
+					       struct amdgpu_ring *ring,
+					       uint64_t seq)
+{
+	struct amdgpu_ctx_ring *cring = &ctx->rings[ring->idx];
+	struct dma_fence *fence;
+
+	spin_lock(&ctx->ring_lock);
+
+	if (seq == ~0ull)
+		seq = cring->sequence - 1;
+
+	if (seq >= cring->sequence) {
+		spin_unlock(&ctx->ring_lock);
+		return ERR_PTR(-EINVAL);
+	}
+
+	if (seq + cring->num_fences < cring->sequence) {
+		spin_unlock(&ctx->ring_lock);
+		return NULL;
+	}
+
+	fence = cring->fences[seq & (cring->num_fences - 1)];
+	if (fence && !dma_fence_is_signaled(fence))
+		dma_fence_get(fence);
+	else
+		fence = NULL;
 	spin_unlock(&ctx->ring_lock);
 
 	return fence;
@@ -414,18 +488,30 @@ void amdgpu_ctx_priority_override(struct amdgpu_ctx *ctx,
 int amdgpu_ctx_wait_prev_fence(struct amdgpu_ctx *ctx, unsigned ring_id)
 {
 	struct amdgpu_ctx_ring *cring = &ctx->rings[ring_id];
-	unsigned idx = cring->sequence & (amdgpu_sched_jobs - 1);
-	struct dma_fence *other = cring->fences[idx];
-
-	if (other) {
-		signed long r;
-		r = dma_fence_wait(other, true);
-		if (r < 0) {
-			if (r != -ERESTARTSYS)
-				DRM_ERROR("Error (%ld) waiting for fence!\n", r);
+	struct dma_fence *other;
+	signed long r;
 
+	if (!cring->num_fences) {
+		r = amdgpu_ctx_ring_grow(ctx, cring);
+		if (r)
 			return r;
-		}
+	}
+
+	other = cring->fences[cring->sequence & (cring->num_fences - 1)];
+	if (!other || dma_fence_is_signaled(other))
+		return 0;
+
+	/* Rather grow the history than stall on the oldest submission */
+	if (cring->num_fences < (amdgpu_sched_jobs << AMDGPU_CTX_MAX_FENCES_SHIFT) &&
+	    !amdgpu_ctx_ring_grow(ctx, cring))
+		return 0;
+
+	r = dma_fence_wait(other, true);
+	if (r < 0) {
+		if (r != -ERESTARTSYS)
+			DRM_ERROR("Error (%ld) waiting for fence!\n", r);
+
+		return r;
 	}
 
 	return 0;
@@ -767,10 +767,73 @@ static int amdgpu_debugfs_evict_vram(struct seq_file *m, void *data)
 	return 0;
 }
 
+static int amdgpu_debugfs_mm_stats(struct seq_file *m, void *data)
+{
+	struct drm_info_node *node = (struct drm_info_node *)m->private;
+	struct drm_device *dev = node->minor->dev;
+	struct amdgpu_device *adev = dev->dev_private;
+	s64 accum_us, accum_us_vis;
+	u32 log2_max_MBps;
+
+	spin_lock(&adev->mm_stats.lock);
+	accum_us = adev->mm_stats.accum_us;
+	accum_us_vis = adev->mm_stats.accum_us_vis;
+	log2_max_MBps = adev->mm_stats.log2_max_MBps;
+	spin_unlock(&adev->mm_stats.lock);
+
+	seq_printf(m, "bytes moved: %lld\n",
+		   (long long)atomic64_read(&adev->num_bytes_moved));
+	seq_printf(m, "evictions: %lld\n",
+		   (long long)atomic64_read(&adev->num_evictions));
+	seq_printf(m, "throttled moves: %lld\n",
+		   (long long)atomic64_read(&adev->mm_stats.num_throttled));
+	seq_printf(m, "move rate: %u MB/s\n",
+		   log2_max_MBps ? 1u << log2_max_MBps : 0);
+	seq_printf(m, "measured copy rate: %u MB/s\n",
+		   READ_ONCE(adev->mm_stats.measured_MBps));
+	seq_printf(m, "move budget: %lld us, visible %lld us\n",
+		   accum_us, accum_us_vis);
+	return 0;
+}
+
+static int amdgpu_debugfs_ih_stats(struct seq_file *m, void *data)
+{
+	struct drm_info_node *node = (struct drm_info_node *)m->private;
+	struct drm_device *dev = node->minor->dev;
+	struct amdgpu_device *adev = dev->dev_private;
+	struct amdgpu_irq_stats *stats = &adev->irq.stats;
+	unsigned i;
+
+	seq_printf(m, "deferred: %llu\n", stats->deferred);
+	seq_printf(m, "overflows: %llu\n", stats->overflows);
+	seq_printf(m, "irq time: %llu ns\n", stats->irq_ns);
+	seq_printf(m, "work time: %llu ns\n", stats->work_ns);
+
+	seq_printf(m, "entries per src_id:\n");
+	for (i = 0; i < AMDGPU_MAX_IRQ_SRC_ID; i++) {
+		if (stats->entries[i])
+			seq_printf(m, "  %3u: %llu\n", i, stats->entries[i]);
+	}
+	return 0;
+}
+
+static int amdgpu_debugfs_benchmark(struct seq_file *m, void *data)
+{
+	struct drm_info_node *node = (struct drm_info_node *)m->private;
+	struct drm_device *dev = node->minor->dev;
+	struct amdgpu_device *adev = dev->dev_private;
+
+	amdgpu_benchmark_suite(adev, m);
+	return 0;
+}
+
 static const struct drm_info_list amdgpu_debugfs_list[] = {
 	{"amdgpu_vbios", amdgpu_debugfs_get_vbios_dump},
 	{"amdgpu_test_ib", &amdgpu_debugfs_test_ib},
-	{"amdgpu_evict_vram", &amdgpu_debugfs_evict_vram}
+	{"amdgpu_evict_vram", &amdgpu_debugfs_evict_vram},
+	{"amdgpu_mm_stats", &amdgpu_debugfs_mm_stats},
+	{"amdgpu_ih_stats", &amdgpu_debugfs_ih_stats},
+	{"amdgpu_benchmark", &amdgpu_debugfs_benchmark}
 };
 
 int amdgpu_debugfs_init(struct amdgpu_device *adev)
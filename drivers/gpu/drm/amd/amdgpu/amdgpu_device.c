@@ -2060,6 +2060,12 @@ int amdgpu_device_init(struct amdgpu_device *adev,
 		else
 			DRM_INFO("amdgpu: acceleration disabled, skipping move tests\n");
 	}
+	if ((amdgpu_testing & 2)) {
+		if (adev->accel_working)
+			amdgpu_vm_test(adev);
+		else
+			DRM_INFO("amdgpu: acceleration disabled, skipping VM tests\n");
+	}
 	if (amdgpu_benchmarking) {
 		if (adev->accel_working)
 			amdgpu_benchmark(adev, amdgpu_benchmarking);
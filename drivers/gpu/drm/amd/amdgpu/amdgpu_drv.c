@@ -148,10 +148,10 @@ module_param_named(gttsize, amdgpu_gtt_size, int, 0600);
 MODULE_PARM_DESC(moverate, "Maximum buffer migration rate in MB/s. (32, 64, etc., -1=auto, 0=1=disabled)");
 module_param_named(moverate, amdgpu_moverate, int, 0600);
 
-MODULE_PARM_DESC(benchmark, "Run benchmark");
+MODULE_PARM_DESC(benchmark, "Run benchmark (1-8 = BO moves, 9 = full suite)");
 module_param_named(benchmark, amdgpu_benchmarking, int, 0444);
 
-MODULE_PARM_DESC(test, "Run tests");
+MODULE_PARM_DESC(test, "Run tests (1 = BO moves, 2 = VM page tables)");
 module_param_named(test, amdgpu_testing, int, 0444);
 
 MODULE_PARM_DESC(audio, "Audio enable (-1 = auto, 0 = disable, 1 = enable)");
@@ -308,6 +308,29 @@ int amdgpu_fence_wait_empty(struct amdgpu_ring *ring)
 	return r;
 }
 
+/**
+ * amdgpu_fence_get - get a reference to an emitted fence
+ *
+ * @ring: ring the fence was emitted on
+ * @seq: sequence number of the fence
+ *
+ * Returns a reference to the fence for @seq or NULL if it has already
+ * signaled. @seq must not be older than the fences still tracked.
+ */
+struct dma_fence *amdgpu_fence_get(struct amdgpu_ring *ring, uint32_t seq)
+{
+	struct dma_fence *fence, **ptr;
+
+	ptr = &ring->fence_drv.fences[seq & ring->fence_drv.num_fences_mask];
+	rcu_read_lock();
+	fence = rcu_dereference(*ptr);
+	if (fence && (fence->seqno != seq || !dma_fence_get_rcu(fence)))
+		fence = NULL;
+	rcu_read_unlock();
+
+	return fence;
+}
+
 /**
  * amdgpu_fence_wait_polling - busy wait for givn sequence number
  *
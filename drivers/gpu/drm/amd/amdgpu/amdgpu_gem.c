@@ -504,6 +504,11 @@ out:
  *
  * Update the bo_va directly after setting its address. Errors are not
  * vital here, so they are not reported back to userspace.
+ *
+ * Userspace batches VA operations by setting AMDGPU_VM_DELAY_UPDATE on all
+ * but the last one. That one then clears all ranges freed by the batch in as
+ * few PTE updates as possible and walks the directories once. Delayed
+ * mappings of other BOs are updated by the next CS using them.
  */
 static void amdgpu_gem_va_update_vm(struct amdgpu_device *adev,
 				    struct amdgpu_vm *vm,
@@ -723,6 +728,9 @@ int amdgpu_gem_op_ioctl(struct drm_device *dev, void *data,
 		if (robj->allowed_domains == AMDGPU_GEM_DOMAIN_VRAM)
 			robj->allowed_domains |= AMDGPU_GEM_DOMAIN_GTT;
 
+		/* BO lists holding it need to be validated again */
+		atomic64_inc(&adev->num_bo_moves);
+
 		if (robj->flags & AMDGPU_GEM_CREATE_VM_ALWAYS_VALID)
 			amdgpu_vm_bo_invalidate(adev, robj, true);
 
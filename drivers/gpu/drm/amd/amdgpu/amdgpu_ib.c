@@ -270,10 +270,15 @@ int amdgpu_ib_pool_init(struct amdgpu_device *adev)
 	if (adev->ib_pool_ready) {
 		return 0;
 	}
+	/* One partition per CPU, so IB allocation on one CPU doesn't
+	 * stall behind fences of submissions made from another
+	 */
 	r = amdgpu_sa_bo_manager_init(adev, &adev->ring_tmp_bo,
 				      AMDGPU_IB_POOL_SIZE*64*1024,
 				      AMDGPU_GPU_PAGE_SIZE,
-				      AMDGPU_GEM_DOMAIN_GTT);
+				      AMDGPU_GEM_DOMAIN_GTT,
+				      min_t(unsigned, num_online_cpus(),
+					    AMDGPU_SA_MAX_PARTS));
 	if (r) {
 		return r;
 	}
@@ -149,6 +149,7 @@ void amdgpu_ih_ring_fini(struct amdgpu_device *adev)
 int amdgpu_ih_process(struct amdgpu_device *adev)
 {
 	struct amdgpu_iv_entry entry;
+	ktime_t start;
 	u32 wptr;
 
 	if (!adev->irq.ih.enabled || adev->shutdown)
@@ -161,6 +162,8 @@ restart_ih:
 	if (atomic_xchg(&adev->irq.ih.lock, 1))
 		return IRQ_NONE;
 
+	start = ktime_get();
+
 	DRM_DEBUG("%s: rptr %d, wptr %d\n", __func__, adev->irq.ih.rptr, wptr);
 
 	/* Order reading of wptr vs. reading of IH ring data */
@@ -168,6 +171,7 @@ restart_ih:
 
 	while (adev->irq.ih.rptr != wptr) {
 		u32 ring_index = adev->irq.ih.rptr >> 2;
+		u32 iv_dw;
 
 		/* Prescreening of high-frequency interrupts */
 		if (!amdgpu_ih_prescreen_iv(adev)) {
@@ -183,10 +187,18 @@ restart_ih:
 			&adev->irq.ih.ring[ring_index];
 		amdgpu_ih_decode_iv(adev, &entry);
 		adev->irq.ih.rptr &= adev->irq.ih.ptr_mask;
+		iv_dw = ((adev->irq.ih.rptr - (ring_index << 2)) &
+			 adev->irq.ih.ptr_mask) >> 2;
+
+		if (entry.src_id < AMDGPU_MAX_IRQ_SRC_ID)
+			adev->irq.stats.entries[entry.src_id]++;
 
-		amdgpu_irq_dispatch(adev, &entry);
+		/* Leave bulk sources to the IH work item */
+		if (!amdgpu_irq_defer(adev, &entry, iv_dw))
+			amdgpu_irq_dispatch(adev, &entry);
 	}
 	amdgpu_ih_set_rptr(adev);
+	adev->irq.stats.irq_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
 	atomic_set(&adev->irq.ih.lock, 0);
 
 	/* make sure wptr hasn't changed while processing */
@@ -208,40 +220,23 @@ restart_ih:
  * table. The return value indicates whether this is a new fault, or
  * a fault that was already known and is already being handled.
  *
- * If there are too many pending page faults, this will fail. Retry
- * interrupts should be ignored in this case until there is enough
- * free space.
+ * The table is lock-free, so this can race with faults being cleared
+ * from other CPUs. It grows when needed, but if there are too many
+ * pending page faults, this will fail. Retry interrupts should be
+ * ignored in this case until there is enough free space.
  *
  * Returns 0 if the fault was added, 1 if the fault was already known,
  * -ENOSPC if there are too many pending faults.
  */
 int amdgpu_ih_add_fault(struct amdgpu_device *adev, u64 key)
 {
-	unsigned long flags;
-	int r = -ENOSPC;
-
 	if (WARN_ON_ONCE(!adev->irq.ih.faults))
 		/* Should be allocated in <IP>_ih_sw_init on GPUs that
 		 * support retry faults and require retry filtering.
 		 */
-		return r;
-
-	spin_lock_irqsave(&adev->irq.ih.faults->lock, flags);
-
-	/* Only let the hash table fill up to 50% for best performance */
-	if (adev->irq.ih.faults->count >= (1 << (AMDGPU_PAGEFAULT_HASH_BITS-1)))
-		goto unlock_out;
-
-	r = chash_table_copy_in(&adev->irq.ih.faults->hash, key, NULL);
-	if (!r)
-		adev->irq.ih.faults->count++;
+		return -ENOSPC;
 
-	/* chash_table_copy_in should never fail unless we're losing count */
-	WARN_ON_ONCE(r < 0);
-
-unlock_out:
-	spin_unlock_irqrestore(&adev->irq.ih.faults->lock, flags);
-	return r;
+	return chash_lf_set_add(adev->irq.ih.faults, key, GFP_ATOMIC);
 }
 
 /**
@@ -256,19 +251,8 @@ unlock_out:
  */
 void amdgpu_ih_clear_fault(struct amdgpu_device *adev, u64 key)
 {
-	unsigned long flags;
-	int r;
-
 	if (!adev->irq.ih.faults)
 		return;
 
-	spin_lock_irqsave(&adev->irq.ih.faults->lock, flags);
-
-	r = chash_table_remove(&adev->irq.ih.faults->hash, key, NULL);
-	if (!WARN_ON_ONCE(r < 0)) {
-		adev->irq.ih.faults->count--;
-		WARN_ON_ONCE(adev->irq.ih.faults->count < 0);
-	}
-
-	spin_unlock_irqrestore(&adev->irq.ih.faults->lock, flags);
+	WARN_ON_ONCE(chash_lf_set_remove(adev->irq.ih.faults, key));
 }
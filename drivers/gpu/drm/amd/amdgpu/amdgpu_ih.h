@@ -72,11 +72,7 @@ enum amdgpu_ih_clientid
 #define AMDGPU_IH_CLIENTID_LEGACY 0
 
 #define AMDGPU_PAGEFAULT_HASH_BITS 8
-struct amdgpu_retryfault_hashtable {
-	DECLARE_CHASH_TABLE(hash, AMDGPU_PAGEFAULT_HASH_BITS, 8, 0);
-	spinlock_t	lock;
-	int		count;
-};
+#define AMDGPU_PAGEFAULT_HASH_MAX_BITS 11
 
 /*
  * R6xx+ IH ring
@@ -96,10 +92,11 @@ struct amdgpu_ih_ring {
 	bool			use_doorbell;
 	bool			use_bus_addr;
 	dma_addr_t		rb_dma_addr; /* only used when use_bus_addr = true */
-	struct amdgpu_retryfault_hashtable *faults;
+	struct chash_lf_set	*faults;
 };
 
 #define AMDGPU_IH_SRC_DATA_MAX_SIZE_DW 4
+#define AMDGPU_IH_SNAPSHOT_MAX_SIZE_DW 3
 
 struct amdgpu_iv_entry {
 	unsigned client_id;
@@ -112,6 +109,8 @@ struct amdgpu_iv_entry {
 	unsigned pas_id;
 	unsigned pasid_src;
 	unsigned src_data[AMDGPU_IH_SRC_DATA_MAX_SIZE_DW];
+	/* registers latched from the irq handler for threaded sources */
+	uint32_t snapshot[AMDGPU_IH_SNAPSHOT_MAX_SIZE_DW];
 	const uint32_t *iv_entry;
 };
 
@@ -91,6 +91,29 @@ static void amdgpu_irq_reset_work_func(struct work_struct *work)
 		amdgpu_device_gpu_recover(adev, NULL, false);
 }
 
+/**
+ * amdgpu_irq_ih_work_func - process deferred IVs
+ *
+ * @work: work struct
+ *
+ * Processes the IVs of threaded sources that the irq handler queued,
+ * e.g. VM fault and thermal interrupts, which can come in storms.
+ */
+static void amdgpu_irq_ih_work_func(struct work_struct *work)
+{
+	struct amdgpu_device *adev = container_of(work, struct amdgpu_device,
+						  irq.ih_work);
+	struct amdgpu_irq_deferred_iv iv;
+	ktime_t start = ktime_get();
+
+	while (kfifo_get(&adev->irq.deferred, &iv)) {
+		iv.entry.iv_entry = iv.iv;
+		amdgpu_irq_dispatch(adev, &iv.entry);
+	}
+
+	adev->irq.stats.work_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+}
+
 /* Disable *all* interrupts */
 static void amdgpu_irq_disable_all(struct amdgpu_device *adev)
 {
@@ -254,6 +277,8 @@ int amdgpu_irq_init(struct amdgpu_device *adev)
 	}
 
 	INIT_WORK(&adev->reset_work, amdgpu_irq_reset_work_func);
+	INIT_WORK(&adev->irq.ih_work, amdgpu_irq_ih_work_func);
+	INIT_KFIFO(adev->irq.deferred);
 
 	adev->irq.installed = true;
 	r = drm_irq_install(adev->ddev, adev->ddev->pdev->irq);
@@ -262,6 +287,7 @@ int amdgpu_irq_init(struct amdgpu_device *adev)
 		if (!amdgpu_device_has_dc_support(adev))
 			flush_work(&adev->hotplug_work);
 		cancel_work_sync(&adev->reset_work);
+		cancel_work_sync(&adev->irq.ih_work);
 		return r;
 	}
 
@@ -290,6 +316,7 @@ void amdgpu_irq_fini(struct amdgpu_device *adev)
 		if (!amdgpu_device_has_dc_support(adev))
 			flush_work(&adev->hotplug_work);
 		cancel_work_sync(&adev->reset_work);
+		cancel_work_sync(&adev->irq.ih_work);
 	}
 
 	for (i = 0; i < AMDGPU_IH_CLIENTID_MAX; ++i) {
@@ -411,6 +438,60 @@ void amdgpu_irq_dispatch(struct amdgpu_device *adev,
 	}
 }
 
+/**
+ * amdgpu_irq_defer - queue an IV for the IH work item
+ *
+ * @adev: amdgpu device pointer
+ * @entry: interrupt vector
+ * @iv_dw: size of the raw IV in dwords
+ *
+ * Copies the IV of a threaded source so that the work item can process
+ * it after the IH ring moved on. Registers describing the interrupt are
+ * latched right away, later they may already describe another one. Called
+ * from the irq handler with the IH lock held, so there is only a single
+ * producer.
+ * Returns true if the IV was consumed, queued or dropped because the queue
+ * is full, false if it must be dispatched now.
+ */
+bool amdgpu_irq_defer(struct amdgpu_device *adev,
+		      struct amdgpu_iv_entry *entry, unsigned iv_dw)
+{
+	unsigned client_id = entry->client_id;
+	unsigned src_id = entry->src_id;
+	struct amdgpu_irq_deferred_iv iv;
+	struct amdgpu_irq_src *src;
+
+	if (client_id >= AMDGPU_IH_CLIENTID_MAX ||
+	    src_id >= AMDGPU_MAX_IRQ_SRC_ID ||
+	    adev->irq.virq[src_id] ||
+	    !adev->irq.client[client_id].sources)
+		return false;
+
+	src = adev->irq.client[client_id].sources[src_id];
+	if (!src || !src->threaded)
+		return false;
+
+	if (src->funcs->snapshot)
+		src->funcs->snapshot(adev, src, entry);
+
+	if (WARN_ON_ONCE(iv_dw > AMDGPU_IRQ_IV_MAX_DW))
+		return false;
+
+	/* Processing it now would overtake the queued ones */
+	if (kfifo_is_full(&adev->irq.deferred)) {
+		adev->irq.stats.overflows++;
+		return true;
+	}
+
+	iv.entry = *entry;
+	memcpy(iv.iv, entry->iv_entry, iv_dw * 4);
+	kfifo_put(&adev->irq.deferred, iv);
+	adev->irq.stats.deferred++;
+
+	schedule_work(&adev->irq.ih_work);
+	return true;
+}
+
 /**
  * amdgpu_irq_update - update hw interrupt state
  *
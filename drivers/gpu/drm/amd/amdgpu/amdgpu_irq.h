@@ -25,11 +25,17 @@
 #define __AMDGPU_IRQ_H__
 
 #include <linux/irqdomain.h>
+#include <linux/kfifo.h>
 #include "amdgpu_ih.h"
 
 #define AMDGPU_MAX_IRQ_SRC_ID	0x100
 #define AMDGPU_MAX_IRQ_CLIENT_ID	0x100
 
+/* number of IVs which can wait for the IH work item */
+#define AMDGPU_IRQ_DEFERRED_SIZE	128
+/* largest IV in dwords */
+#define AMDGPU_IRQ_IV_MAX_DW		8
+
 struct amdgpu_device;
 struct amdgpu_iv_entry;
 
@@ -43,6 +49,8 @@ struct amdgpu_irq_src {
 	atomic_t				*enabled_types;
 	const struct amdgpu_irq_src_funcs	*funcs;
 	void *data;
+	/* processed by the IH work item instead of in the irq handler */
+	bool					threaded;
 };
 
 struct amdgpu_irq_client {
@@ -57,6 +65,25 @@ struct amdgpu_irq_src_funcs {
 	int (*process)(struct amdgpu_device *adev,
 		       struct amdgpu_irq_src *source,
 		       struct amdgpu_iv_entry *entry);
+
+	/* latch state a threaded source needs into entry->snapshot */
+	void (*snapshot)(struct amdgpu_device *adev,
+			 struct amdgpu_irq_src *source,
+			 struct amdgpu_iv_entry *entry);
+};
+
+/* copy of an IV handed from the irq handler to the IH work item */
+struct amdgpu_irq_deferred_iv {
+	struct amdgpu_iv_entry	entry;
+	uint32_t		iv[AMDGPU_IRQ_IV_MAX_DW];
+};
+
+struct amdgpu_irq_stats {
+	u64	entries[AMDGPU_MAX_IRQ_SRC_ID]; /* IVs per src_id */
+	u64	deferred;	/* IVs handed to the work item */
+	u64	overflows;	/* threaded IVs dropped, queue full */
+	u64	irq_ns;		/* time spent in the irq handler */
+	u64	work_ns;	/* time spent in the work item */
 };
 
 struct amdgpu_irq {
@@ -76,6 +103,12 @@ struct amdgpu_irq {
 	struct irq_domain		*domain; /* GPU irq controller domain */
 	unsigned			virq[AMDGPU_MAX_IRQ_SRC_ID];
 	uint32_t                        srbm_soft_reset;
+
+	/* bulk IVs are processed outside of the irq handler */
+	struct work_struct		ih_work;
+	DECLARE_KFIFO(deferred, struct amdgpu_irq_deferred_iv,
+		      AMDGPU_IRQ_DEFERRED_SIZE);
+	struct amdgpu_irq_stats		stats;
 };
 
 void amdgpu_irq_preinstall(struct drm_device *dev);
@@ -90,6 +123,8 @@ int amdgpu_irq_add_id(struct amdgpu_device *adev,
 		      struct amdgpu_irq_src *source);
 void amdgpu_irq_dispatch(struct amdgpu_device *adev,
 			 struct amdgpu_iv_entry *entry);
+bool amdgpu_irq_defer(struct amdgpu_device *adev,
+		      struct amdgpu_iv_entry *entry, unsigned iv_dw);
 int amdgpu_irq_update(struct amdgpu_device *adev, struct amdgpu_irq_src *src,
 		      unsigned type);
 int amdgpu_irq_get(struct amdgpu_device *adev, struct amdgpu_irq_src *src,
@@ -732,6 +732,8 @@ int amdgpu_bo_pin_restricted(struct amdgpu_bo *bo, u32 domain,
 	/* force to pin into visible video ram */
 	if (!(bo->flags & AMDGPU_GEM_CREATE_NO_CPU_ACCESS))
 		bo->flags |= AMDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED;
+	/* the placement flags changed, see amdgpu_cs_bo_list_resident() */
+	atomic64_inc(&adev->num_bo_moves);
 	amdgpu_ttm_placement_from_domain(bo, domain);
 	for (i = 0; i < bo->placement.num_placement; i++) {
 		unsigned fpfn, lpfn;
@@ -959,6 +961,9 @@ void amdgpu_bo_move_notify(struct ttm_buffer_object *bo,
 	if (evict)
 		atomic64_inc(&adev->num_evictions);
 
+	/* invalidates the resident state of any BO list, see amdgpu_cs.c */
+	atomic64_inc(&adev->num_bo_moves);
+
 	/* update statistics */
 	if (!new_mem)
 		return;
@@ -981,7 +986,11 @@ int amdgpu_bo_fault_reserve_notify(struct ttm_buffer_object *bo)
 	abo = ttm_to_amdgpu_bo(bo);
 
 	/* Remember that this BO was accessed by the CPU */
-	abo->flags |= AMDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED;
+	if (!(abo->flags & AMDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED)) {
+		abo->flags |= AMDGPU_GEM_CREATE_CPU_ACCESS_REQUIRED;
+		/* the placement flags changed, see amdgpu_cs_bo_list_resident() */
+		atomic64_inc(&adev->num_bo_moves);
+	}
 
 	if (bo->mem.mem_type != TTM_PL_VRAM)
 		return 0;
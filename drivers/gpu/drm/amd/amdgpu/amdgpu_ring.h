@@ -92,6 +92,7 @@ int amdgpu_fence_emit(struct amdgpu_ring *ring, struct dma_fence **fence);
 int amdgpu_fence_emit_polling(struct amdgpu_ring *ring, uint32_t *s);
 void amdgpu_fence_process(struct amdgpu_ring *ring);
 int amdgpu_fence_wait_empty(struct amdgpu_ring *ring);
+struct dma_fence *amdgpu_fence_get(struct amdgpu_ring *ring, uint32_t seq);
 signed long amdgpu_fence_wait_polling(struct amdgpu_ring *ring,
 				      uint32_t wait_seq,
 				      signed long timeout);
@@ -157,6 +158,16 @@ struct amdgpu_ring_funcs {
 			      enum drm_sched_priority priority);
 };
 
+/* In-flight throughput sample of a buffer move on a ring */
+struct amdgpu_copy_rate {
+	struct dma_fence_cb	scheduled_cb;
+	struct dma_fence_cb	finished_cb;
+	/* fence emitted right before the sampled job, if still pending */
+	struct dma_fence	*prev;
+	u64			bytes;
+	atomic_t		busy;
+};
+
 struct amdgpu_ring {
 	struct amdgpu_device		*adev;
 	const struct amdgpu_ring_funcs	*funcs;
@@ -208,6 +219,9 @@ struct amdgpu_ring {
 	/* protected by priority_mutex */
 	int			priority;
 
+	/* only one copy sample in flight per ring */
+	struct amdgpu_copy_rate	copy_rate;
+
 #if defined(CONFIG_DEBUG_FS)
 	struct dentry *ent;
 #endif
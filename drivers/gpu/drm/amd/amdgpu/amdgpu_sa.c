@@ -40,30 +40,65 @@
  *
  * If we are asked to block we wait on all the oldest fence of all
  * rings. We just wait for any of those fence to complete.
+ *
+ * The buffer can be split into several partitions, each managed as
+ * its own ring. Allocations go to the partition of the current CPU. When
+ * that one is full the others are tried before blocking, and the wait is
+ * on the oldest fence of every ring across all partitions, so a stalled
+ * ring in one partition doesn't hold up an allocation another partition
+ * could satisfy.
+ *
+ * Allocations larger than a partition take over as many partitions from
+ * the start of the buffer as they need. Each of those is reserved while it
+ * drains and then filled completely, the pieces are chained together and
+ * freed with the same fence.
  */
 #include <drm/drmP.h>
 #include "amdgpu.h"
 
 static void amdgpu_sa_bo_remove_locked(struct amdgpu_sa_bo *sa_bo);
-static void amdgpu_sa_bo_try_free(struct amdgpu_sa_manager *sa_manager);
+static void amdgpu_sa_bo_try_free(struct amdgpu_sa_part *part);
 
 int amdgpu_sa_bo_manager_init(struct amdgpu_device *adev,
 			      struct amdgpu_sa_manager *sa_manager,
-			      unsigned size, u32 align, u32 domain)
+			      unsigned size, u32 align, u32 domain,
+			      unsigned num_parts)
 {
-	int i, r;
+	unsigned part_size;
+	int i, j, r;
+
+	if (WARN_ON(!num_parts || num_parts > AMDGPU_SA_MAX_PARTS))
+		return -EINVAL;
+
+	/* the partitions share the buffer, whatever their number */
+	part_size = rounddown(size / num_parts, align);
 
-	init_waitqueue_head(&sa_manager->wq);
 	sa_manager->bo = NULL;
 	sa_manager->size = size;
 	sa_manager->domain = domain;
 	sa_manager->align = align;
-	sa_manager->hole = &sa_manager->olist;
-	INIT_LIST_HEAD(&sa_manager->olist);
-	for (i = 0; i < AMDGPU_SA_NUM_FENCE_LISTS; ++i)
-		INIT_LIST_HEAD(&sa_manager->flist[i]);
+	sa_manager->num_parts = num_parts;
+	mutex_init(&sa_manager->span_lock);
+	for (i = 0; i < num_parts; ++i) {
+		struct amdgpu_sa_part *part = &sa_manager->parts[i];
+
+		init_waitqueue_head(&part->wq);
+		part->manager = sa_manager;
+		part->offset = part_size * i;
+		/* the last one gets what rounding left over */
+		part->size = i == num_parts - 1 ? size - part->offset : part_size;
+		part->reserved = false;
+		part->hole = &part->olist;
+		INIT_LIST_HEAD(&part->olist);
+		for (j = 0; j < AMDGPU_SA_NUM_FENCE_LISTS; ++j)
+			INIT_LIST_HEAD(&part->flist[j]);
+		part->allocs = 0;
+		part->fallbacks = 0;
+		part->waits = 0;
+		part->wait_ns = 0;
+	}
 
-	r = amdgpu_bo_create(adev, size, align, true, domain,
+	r = amdgpu_bo_create(adev, sa_manager->size, align, true, domain,
 			     0, NULL, NULL, 0, &sa_manager->bo);
 	if (r) {
 		dev_err(adev->dev, "(%d) failed to allocate bo for manager\n", r);
@@ -77,16 +112,21 @@ void amdgpu_sa_bo_manager_fini(struct amdgpu_device *adev,
 			       struct amdgpu_sa_manager *sa_manager)
 {
 	struct amdgpu_sa_bo *sa_bo, *tmp;
+	unsigned i;
+
+	for (i = 0; i < sa_manager->num_parts; ++i) {
+		struct amdgpu_sa_part *part = &sa_manager->parts[i];
 
-	if (!list_empty(&sa_manager->olist)) {
-		sa_manager->hole = &sa_manager->olist,
-		amdgpu_sa_bo_try_free(sa_manager);
-		if (!list_empty(&sa_manager->olist)) {
-			dev_err(adev->dev, "sa_manager is not empty, clearing anyway\n");
+		if (!list_empty(&part->olist)) {
+			part->hole = &part->olist,
+			amdgpu_sa_bo_try_free(part);
+			if (!list_empty(&part->olist)) {
+				dev_err(adev->dev, "sa_manager is not empty, clearing anyway\n");
+			}
+		}
+		list_for_each_entry_safe(sa_bo, tmp, &part->olist, olist) {
+			amdgpu_sa_bo_remove_locked(sa_bo);
 		}
-	}
-	list_for_each_entry_safe(sa_bo, tmp, &sa_manager->olist, olist) {
-		amdgpu_sa_bo_remove_locked(sa_bo);
 	}
 	amdgpu_bo_unref(&sa_manager->bo);
 	sa_manager->size = 0;
@@ -141,9 +181,9 @@ int amdgpu_sa_bo_manager_suspend(struct amdgpu_device *adev,
 
 static void amdgpu_sa_bo_remove_locked(struct amdgpu_sa_bo *sa_bo)
 {
-	struct amdgpu_sa_manager *sa_manager = sa_bo->manager;
-	if (sa_manager->hole == &sa_bo->olist) {
-		sa_manager->hole = sa_bo->olist.prev;
+	struct amdgpu_sa_part *part = sa_bo->part;
+	if (part->hole == &sa_bo->olist) {
+		part->hole = sa_bo->olist.prev;
 	}
 	list_del_init(&sa_bo->olist);
 	list_del_init(&sa_bo->flist);
@@ -151,15 +191,15 @@ static void amdgpu_sa_bo_remove_locked(struct amdgpu_sa_bo *sa_bo)
 	kfree(sa_bo);
 }
 
-static void amdgpu_sa_bo_try_free(struct amdgpu_sa_manager *sa_manager)
+static void amdgpu_sa_bo_try_free(struct amdgpu_sa_part *part)
 {
 	struct amdgpu_sa_bo *sa_bo, *tmp;
 
-	if (sa_manager->hole->next == &sa_manager->olist)
+	if (part->hole->next == &part->olist)
 		return;
 
-	sa_bo = list_entry(sa_manager->hole->next, struct amdgpu_sa_bo, olist);
-	list_for_each_entry_safe_from(sa_bo, tmp, &sa_manager->olist, olist) {
+	sa_bo = list_entry(part->hole->next, struct amdgpu_sa_bo, olist);
+	list_for_each_entry_safe_from(sa_bo, tmp, &part->olist, olist) {
 		if (sa_bo->fence == NULL ||
 		    !dma_fence_is_signaled(sa_bo->fence)) {
 			return;
@@ -168,45 +208,46 @@ static void amdgpu_sa_bo_try_free(struct amdgpu_sa_manager *sa_manager)
 	}
 }
 
-static inline unsigned amdgpu_sa_bo_hole_soffset(struct amdgpu_sa_manager *sa_manager)
+static inline unsigned amdgpu_sa_bo_hole_soffset(struct amdgpu_sa_part *part)
 {
-	struct list_head *hole = sa_manager->hole;
+	struct list_head *hole = part->hole;
 
-	if (hole != &sa_manager->olist) {
+	if (hole != &part->olist) {
 		return list_entry(hole, struct amdgpu_sa_bo, olist)->eoffset;
 	}
-	return 0;
+	return part->offset;
 }
 
-static inline unsigned amdgpu_sa_bo_hole_eoffset(struct amdgpu_sa_manager *sa_manager)
+static inline unsigned amdgpu_sa_bo_hole_eoffset(struct amdgpu_sa_part *part)
 {
-	struct list_head *hole = sa_manager->hole;
+	struct list_head *hole = part->hole;
 
-	if (hole->next != &sa_manager->olist) {
+	if (hole->next != &part->olist) {
 		return list_entry(hole->next, struct amdgpu_sa_bo, olist)->soffset;
 	}
-	return sa_manager->size;
+	return part->offset + part->size;
 }
 
-static bool amdgpu_sa_bo_try_alloc(struct amdgpu_sa_manager *sa_manager,
+static bool amdgpu_sa_bo_try_alloc(struct amdgpu_sa_part *part,
 				   struct amdgpu_sa_bo *sa_bo,
 				   unsigned size, unsigned align)
 {
 	unsigned soffset, eoffset, wasted;
 
-	soffset = amdgpu_sa_bo_hole_soffset(sa_manager);
-	eoffset = amdgpu_sa_bo_hole_eoffset(sa_manager);
+	soffset = amdgpu_sa_bo_hole_soffset(part);
+	eoffset = amdgpu_sa_bo_hole_eoffset(part);
 	wasted = (align - (soffset % align)) % align;
 
 	if ((eoffset - soffset) >= (size + wasted)) {
 		soffset += wasted;
 
-		sa_bo->manager = sa_manager;
+		sa_bo->manager = part->manager;
+		sa_bo->part = part;
 		sa_bo->soffset = soffset;
 		sa_bo->eoffset = soffset + size;
-		list_add(&sa_bo->olist, sa_manager->hole);
+		list_add(&sa_bo->olist, part->hole);
 		INIT_LIST_HEAD(&sa_bo->flist);
-		sa_manager->hole = &sa_bo->olist;
+		part->hole = &sa_bo->olist;
 		return true;
 	}
 	return false;
@@ -215,25 +256,25 @@ static bool amdgpu_sa_bo_try_alloc(struct amdgpu_sa_manager *sa_manager,
 /**
  * amdgpu_sa_event - Check if we can stop waiting
  *
- * @sa_manager: pointer to the sa_manager
+ * @part: pointer to the sa_manager partition
  * @size: number of bytes we want to allocate
  * @align: alignment we need to match
  *
  * Check if either there is a fence we can wait for or
  * enough free memory to satisfy the allocation directly
  */
-static bool amdgpu_sa_event(struct amdgpu_sa_manager *sa_manager,
+static bool amdgpu_sa_event(struct amdgpu_sa_part *part,
 			    unsigned size, unsigned align)
 {
 	unsigned soffset, eoffset, wasted;
 	int i;
 
 	for (i = 0; i < AMDGPU_SA_NUM_FENCE_LISTS; ++i)
-		if (!list_empty(&sa_manager->flist[i]))
+		if (!list_empty(&part->flist[i]))
 			return true;
 
-	soffset = amdgpu_sa_bo_hole_soffset(sa_manager);
-	eoffset = amdgpu_sa_bo_hole_eoffset(sa_manager);
+	soffset = amdgpu_sa_bo_hole_soffset(part);
+	eoffset = amdgpu_sa_bo_hole_eoffset(part);
 	wasted = (align - (soffset % align)) % align;
 
 	if ((eoffset - soffset) >= (size + wasted)) {
@@ -243,7 +284,7 @@ static bool amdgpu_sa_event(struct amdgpu_sa_manager *sa_manager,
 	return false;
 }
 
-static bool amdgpu_sa_bo_next_hole(struct amdgpu_sa_manager *sa_manager,
+static bool amdgpu_sa_bo_next_hole(struct amdgpu_sa_part *part,
 				   struct dma_fence **fences,
 				   unsigned *tries)
 {
@@ -251,25 +292,25 @@ static bool amdgpu_sa_bo_next_hole(struct amdgpu_sa_manager *sa_manager,
 	unsigned i, soffset, best, tmp;
 
 	/* if hole points to the end of the buffer */
-	if (sa_manager->hole->next == &sa_manager->olist) {
+	if (part->hole->next == &part->olist) {
 		/* try again with its beginning */
-		sa_manager->hole = &sa_manager->olist;
+		part->hole = &part->olist;
 		return true;
 	}
 
-	soffset = amdgpu_sa_bo_hole_soffset(sa_manager);
-	/* to handle wrap around we add sa_manager->size */
-	best = sa_manager->size * 2;
+	soffset = amdgpu_sa_bo_hole_soffset(part);
+	/* to handle wrap around we add part->size */
+	best = part->size * 2;
 	/* go over all fence list and try to find the closest sa_bo
 	 * of the current last
 	 */
 	for (i = 0; i < AMDGPU_SA_NUM_FENCE_LISTS; ++i) {
 		struct amdgpu_sa_bo *sa_bo;
 
-		if (list_empty(&sa_manager->flist[i]))
+		if (list_empty(&part->flist[i]))
 			continue;
 
-		sa_bo = list_first_entry(&sa_manager->flist[i],
+		sa_bo = list_first_entry(&part->flist[i],
 					 struct amdgpu_sa_bo, flist);
 
 		if (!dma_fence_is_signaled(sa_bo->fence)) {
@@ -285,7 +326,7 @@ static bool amdgpu_sa_bo_next_hole(struct amdgpu_sa_manager *sa_manager,
 		tmp = sa_bo->soffset;
 		if (tmp < soffset) {
 			/* wrap around, pretend it's after */
-			tmp += sa_manager->size;
+			tmp += part->size;
 		}
 		tmp -= soffset;
 		if (tmp < best) {
@@ -300,7 +341,7 @@ static bool amdgpu_sa_bo_next_hole(struct amdgpu_sa_manager *sa_manager,
 
 		idx %= AMDGPU_SA_NUM_FENCE_LISTS;
 		++tries[idx];
-		sa_manager->hole = best_bo->olist.prev;
+		part->hole = best_bo->olist.prev;
 
 		/* we knew that this one is signaled,
 		   so it's save to remote it */
@@ -310,55 +351,167 @@ static bool amdgpu_sa_bo_next_hole(struct amdgpu_sa_manager *sa_manager,
 	return false;
 }
 
-int amdgpu_sa_bo_new(struct amdgpu_sa_manager *sa_manager,
-		     struct amdgpu_sa_bo **sa_bo,
-		     unsigned size, unsigned align)
+/*
+ * Try to allocate from a partition without waiting, collecting the
+ * oldest unsignaled fence of each fence list. Called with the
+ * partition's wq.lock held.
+ */
+static bool amdgpu_sa_bo_alloc_locked(struct amdgpu_sa_part *part,
+				      struct amdgpu_sa_bo *sa_bo,
+				      unsigned size, unsigned align,
+				      struct dma_fence **fences)
 {
-	struct dma_fence *fences[AMDGPU_SA_NUM_FENCE_LISTS];
 	unsigned tries[AMDGPU_SA_NUM_FENCE_LISTS];
+	int i;
+
+	for (i = 0; i < AMDGPU_SA_NUM_FENCE_LISTS; ++i) {
+		fences[i] = NULL;
+		tries[i] = 0;
+	}
+
+	do {
+		amdgpu_sa_bo_try_free(part);
+
+		if (amdgpu_sa_bo_try_alloc(part, sa_bo, size, align)) {
+			part->allocs++;
+			return true;
+		}
+
+		/* see if we can skip over some allocations */
+	} while (amdgpu_sa_bo_next_hole(part, fences, tries));
+
+	return false;
+}
+
+/*
+ * Keep the oldest of the fences of each fence list of a partition in
+ * @fences, taking a reference. Called with the partition's wq.lock held.
+ */
+static void amdgpu_sa_bo_merge_fences(struct dma_fence **fences,
+				      struct dma_fence **part_fences)
+{
+	int i;
+
+	for (i = 0; i < AMDGPU_SA_NUM_FENCE_LISTS; ++i) {
+		struct dma_fence *fence = part_fences[i];
+
+		if (!fence)
+			continue;
+
+		/* fences of one context signal in order */
+		if (fences[i] && (fences[i]->context != fence->context ||
+				  !dma_fence_is_later(fences[i], fence)))
+			continue;
+
+		dma_fence_put(fences[i]);
+		fences[i] = dma_fence_get(fence);
+	}
+}
+
+static void amdgpu_sa_bo_put_fences(struct dma_fence **fences)
+{
+	int i;
+
+	for (i = 0; i < AMDGPU_SA_NUM_FENCE_LISTS; ++i)
+		dma_fence_put(fences[i]);
+}
+
+/*
+ * Try the other partitions without waiting. If none of them has space,
+ * add the fences they would have to wait for to @fences.
+ */
+static bool amdgpu_sa_bo_alloc_other(struct amdgpu_sa_manager *sa_manager,
+				     struct amdgpu_sa_part *own,
+				     struct amdgpu_sa_bo *sa_bo,
+				     unsigned size, unsigned align,
+				     struct dma_fence **fences)
+{
+	struct dma_fence *part_fences[AMDGPU_SA_NUM_FENCE_LISTS];
+	unsigned i;
+	bool r;
+
+	for (i = 0; i < sa_manager->num_parts; ++i) {
+		struct amdgpu_sa_part *part = &sa_manager->parts[i];
+
+		if (part == own)
+			continue;
+
+		spin_lock(&part->wq.lock);
+		if (part->reserved) {
+			spin_unlock(&part->wq.lock);
+			continue;
+		}
+		r = amdgpu_sa_bo_alloc_locked(part, sa_bo, size, align,
+					      part_fences);
+		if (r)
+			part->fallbacks++;
+		else
+			amdgpu_sa_bo_merge_fences(fences, part_fences);
+		spin_unlock(&part->wq.lock);
+		if (r)
+			return true;
+	}
+
+	return false;
+}
+
+/*
+ * Allocate from @part, falling back to the other partitions unless this is a
+ * piece of a spanning allocation, which may use reserved partitions.
+ */
+static int amdgpu_sa_bo_new_part(struct amdgpu_sa_manager *sa_manager,
+				 struct amdgpu_sa_part *part,
+				 struct amdgpu_sa_bo **sa_bo,
+				 unsigned size, unsigned align, bool span)
+{
+	struct dma_fence *fences[AMDGPU_SA_NUM_FENCE_LISTS];
+	struct dma_fence *part_fences[AMDGPU_SA_NUM_FENCE_LISTS];
 	unsigned count;
 	int i, r;
 	signed long t;
-
-	if (WARN_ON_ONCE(align > sa_manager->align))
-		return -EINVAL;
-
-	if (WARN_ON_ONCE(size > sa_manager->size))
-		return -EINVAL;
+	ktime_t wait_start;
 
 	*sa_bo = kmalloc(sizeof(struct amdgpu_sa_bo), GFP_KERNEL);
 	if (!(*sa_bo))
 		return -ENOMEM;
 	(*sa_bo)->manager = sa_manager;
+	(*sa_bo)->part = part;
 	(*sa_bo)->fence = NULL;
+	(*sa_bo)->span = NULL;
 	INIT_LIST_HEAD(&(*sa_bo)->olist);
 	INIT_LIST_HEAD(&(*sa_bo)->flist);
 
-	spin_lock(&sa_manager->wq.lock);
 	do {
-		for (i = 0; i < AMDGPU_SA_NUM_FENCE_LISTS; ++i) {
+		for (i = 0; i < AMDGPU_SA_NUM_FENCE_LISTS; ++i)
 			fences[i] = NULL;
-			tries[i] = 0;
-		}
-
-		do {
-			amdgpu_sa_bo_try_free(sa_manager);
-
-			if (amdgpu_sa_bo_try_alloc(sa_manager, *sa_bo,
-						   size, align)) {
-				spin_unlock(&sa_manager->wq.lock);
-				return 0;
-			}
 
-			/* see if we can skip over some allocations */
-		} while (amdgpu_sa_bo_next_hole(sa_manager, fences, tries));
+		spin_lock(&part->wq.lock);
+		if ((span || !part->reserved) &&
+		    amdgpu_sa_bo_alloc_locked(part, *sa_bo, size, align,
+					      part_fences)) {
+			spin_unlock(&part->wq.lock);
+			return 0;
+		}
+		if (span || !part->reserved)
+			amdgpu_sa_bo_merge_fences(fences, part_fences);
+		spin_unlock(&part->wq.lock);
+
+		if (!span && sa_manager->num_parts > 1 &&
+		    amdgpu_sa_bo_alloc_other(sa_manager, part, *sa_bo,
+					     size, align, fences)) {
+			amdgpu_sa_bo_put_fences(fences);
+			return 0;
+		}
 
 		for (i = 0, count = 0; i < AMDGPU_SA_NUM_FENCE_LISTS; ++i)
 			if (fences[i])
-				fences[count++] = dma_fence_get(fences[i]);
+				fences[count++] = fences[i];
 
+		spin_lock(&part->wq.lock);
+		part->waits++;
+		wait_start = ktime_get();
 		if (count) {
-			spin_unlock(&sa_manager->wq.lock);
+			spin_unlock(&part->wq.lock);
 			t = dma_fence_wait_any_timeout(fences, count, false,
 						       MAX_SCHEDULE_TIMEOUT,
 						       NULL);
@@ -366,45 +519,129 @@ int amdgpu_sa_bo_new(struct amdgpu_sa_manager *sa_manager,
 				dma_fence_put(fences[i]);
 
 			r = (t > 0) ? 0 : t;
-			spin_lock(&sa_manager->wq.lock);
+			spin_lock(&part->wq.lock);
 		} else {
 			/* if we have nothing to wait for block */
 			r = wait_event_interruptible_locked(
-				sa_manager->wq,
-				amdgpu_sa_event(sa_manager, size, align)
+				part->wq,
+				(span || !part->reserved) &&
+				amdgpu_sa_event(part, size, align)
 			);
 		}
+		part->wait_ns += ktime_to_ns(ktime_sub(ktime_get(), wait_start));
+		spin_unlock(&part->wq.lock);
 
 	} while (!r);
 
-	spin_unlock(&sa_manager->wq.lock);
 	kfree(*sa_bo);
 	*sa_bo = NULL;
 	return r;
 }
 
+static void __amdgpu_sa_bo_free(struct amdgpu_sa_bo *sa_bo,
+				struct dma_fence *fence)
+{
+	struct amdgpu_sa_part *part = sa_bo->part;
+
+	spin_lock(&part->wq.lock);
+	if (fence && !dma_fence_is_signaled(fence)) {
+		uint32_t idx;
+
+		sa_bo->fence = dma_fence_get(fence);
+		idx = fence->context % AMDGPU_SA_NUM_FENCE_LISTS;
+		list_add_tail(&sa_bo->flist, &part->flist[idx]);
+	} else {
+		amdgpu_sa_bo_remove_locked(sa_bo);
+	}
+	wake_up_all_locked(&part->wq);
+	spin_unlock(&part->wq.lock);
+}
+
+/*
+ * Fill whole partitions from the start of the buffer until @size is
+ * covered. A partition is reserved while we wait for it to drain, so that
+ * new allocations move to the others instead of keeping it busy.
+ */
+static int amdgpu_sa_bo_new_span(struct amdgpu_sa_manager *sa_manager,
+				 struct amdgpu_sa_bo **sa_bo,
+				 unsigned size, unsigned align)
+{
+	struct amdgpu_sa_bo **next = sa_bo;
+	unsigned i, covered = 0;
+	int r = 0;
+
+	mutex_lock(&sa_manager->span_lock);
+	for (i = 0; covered < size; ++i) {
+		struct amdgpu_sa_part *part = &sa_manager->parts[i];
+
+		spin_lock(&part->wq.lock);
+		part->reserved = true;
+		spin_unlock(&part->wq.lock);
+
+		r = amdgpu_sa_bo_new_part(sa_manager, part, next, part->size,
+					  align, true);
+
+		spin_lock(&part->wq.lock);
+		part->reserved = false;
+		wake_up_all_locked(&part->wq);
+		spin_unlock(&part->wq.lock);
+
+		if (r)
+			break;
+
+		covered += part->size;
+		next = &(*next)->span;
+	}
+	mutex_unlock(&sa_manager->span_lock);
+
+	if (r) {
+		struct amdgpu_sa_bo *piece, *tmp;
+
+		for (piece = *sa_bo; piece; piece = tmp) {
+			tmp = piece->span;
+			__amdgpu_sa_bo_free(piece, NULL);
+		}
+		*sa_bo = NULL;
+	}
+
+	return r;
+}
+
+int amdgpu_sa_bo_new(struct amdgpu_sa_manager *sa_manager,
+		     struct amdgpu_sa_bo **sa_bo,
+		     unsigned size, unsigned align)
+{
+	struct amdgpu_sa_part *part;
+
+	if (WARN_ON_ONCE(align > sa_manager->align))
+		return -EINVAL;
+
+	/* the size may come from userspace, e.g. for UVD and VCE IBs */
+	if (size > sa_manager->size)
+		return -EINVAL;
+
+	part = &sa_manager->parts[raw_smp_processor_id() %
+				  sa_manager->num_parts];
+	if (size > part->size)
+		return amdgpu_sa_bo_new_span(sa_manager, sa_bo, size, align);
+
+	return amdgpu_sa_bo_new_part(sa_manager, part, sa_bo, size, align,
+				     false);
+}
+
 void amdgpu_sa_bo_free(struct amdgpu_device *adev, struct amdgpu_sa_bo **sa_bo,
 		       struct dma_fence *fence)
 {
-	struct amdgpu_sa_manager *sa_manager;
+	struct amdgpu_sa_bo *piece, *next;
 
 	if (sa_bo == NULL || *sa_bo == NULL) {
 		return;
 	}
 
-	sa_manager = (*sa_bo)->manager;
-	spin_lock(&sa_manager->wq.lock);
-	if (fence && !dma_fence_is_signaled(fence)) {
-		uint32_t idx;
-
-		(*sa_bo)->fence = dma_fence_get(fence);
-		idx = fence->context % AMDGPU_SA_NUM_FENCE_LISTS;
-		list_add_tail(&(*sa_bo)->flist, &sa_manager->flist[idx]);
-	} else {
-		amdgpu_sa_bo_remove_locked(*sa_bo);
+	for (piece = *sa_bo; piece; piece = next) {
+		next = piece->span;
+		__amdgpu_sa_bo_free(piece, fence);
 	}
-	wake_up_all_locked(&sa_manager->wq);
-	spin_unlock(&sa_manager->wq.lock);
 	*sa_bo = NULL;
 }
 
@@ -414,25 +651,34 @@ void amdgpu_sa_bo_dump_debug_info(struct amdgpu_sa_manager *sa_manager,
 				  struct seq_file *m)
 {
 	struct amdgpu_sa_bo *i;
+	unsigned p;
+
+	for (p = 0; p < sa_manager->num_parts; ++p) {
+		struct amdgpu_sa_part *part = &sa_manager->parts[p];
+
+		spin_lock(&part->wq.lock);
+		seq_printf(m, "partition %u: %llu allocs, %llu fallbacks, "
+			   "%llu waits, %llu us waited\n", p,
+			   part->allocs, part->fallbacks, part->waits,
+			   div_u64(part->wait_ns, NSEC_PER_USEC));
+		list_for_each_entry(i, &part->olist, olist) {
+			uint64_t soffset = i->soffset + sa_manager->gpu_addr;
+			uint64_t eoffset = i->eoffset + sa_manager->gpu_addr;
+			if (&i->olist == part->hole) {
+				seq_printf(m, ">");
+			} else {
+				seq_printf(m, " ");
+			}
+			seq_printf(m, "[0x%010llx 0x%010llx] size %8lld",
+				   soffset, eoffset, eoffset - soffset);
 
-	spin_lock(&sa_manager->wq.lock);
-	list_for_each_entry(i, &sa_manager->olist, olist) {
-		uint64_t soffset = i->soffset + sa_manager->gpu_addr;
-		uint64_t eoffset = i->eoffset + sa_manager->gpu_addr;
-		if (&i->olist == sa_manager->hole) {
-			seq_printf(m, ">");
-		} else {
-			seq_printf(m, " ");
-		}
-		seq_printf(m, "[0x%010llx 0x%010llx] size %8lld",
-			   soffset, eoffset, eoffset - soffset);
-
-		if (i->fence)
-			seq_printf(m, " protected by 0x%08x on context %llu",
-				   i->fence->seqno, i->fence->context);
+			if (i->fence)
+				seq_printf(m, " protected by 0x%08x on context %llu",
+					   i->fence->seqno, i->fence->context);
 
-		seq_printf(m, "\n");
+			seq_printf(m, "\n");
+		}
+		spin_unlock(&part->wq.lock);
 	}
-	spin_unlock(&sa_manager->wq.lock);
 }
 #endif
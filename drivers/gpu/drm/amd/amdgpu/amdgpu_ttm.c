@@ -310,6 +310,73 @@ static struct drm_mm_node *amdgpu_find_mm_node(struct ttm_mem_reg *mem,
 	return mm_node;
 }
 
+static void amdgpu_ttm_copy_rate_finished(struct dma_fence *f,
+					  struct dma_fence_cb *cb)
+{
+	struct amdgpu_copy_rate *rate =
+		container_of(cb, struct amdgpu_copy_rate, finished_cb);
+	struct amdgpu_ring *ring =
+		container_of(rate, struct amdgpu_ring, copy_rate);
+	struct drm_sched_fence *s_fence = to_drm_sched_fence(f);
+	ktime_t start = s_fence->scheduled.timestamp;
+
+	/* The ring executes in order, so the copy only started once the job
+	 * in front of it on the ring was done.
+	 */
+	if (rate->prev) {
+		if (test_bit(DMA_FENCE_FLAG_TIMESTAMP_BIT, &rate->prev->flags) &&
+		    ktime_after(rate->prev->timestamp, start))
+			start = rate->prev->timestamp;
+		dma_fence_put(rate->prev);
+		rate->prev = NULL;
+	}
+
+	if (!f->error)
+		amdgpu_cs_report_copy_rate(ring->adev, rate->bytes,
+					   ktime_to_ns(ktime_sub(f->timestamp,
+								 start)));
+	atomic_set(&rate->busy, 0);
+}
+
+static void amdgpu_ttm_copy_rate_scheduled(struct dma_fence *f,
+					   struct dma_fence_cb *cb)
+{
+	struct amdgpu_copy_rate *rate =
+		container_of(cb, struct amdgpu_copy_rate, scheduled_cb);
+	struct amdgpu_ring *ring =
+		container_of(rate, struct amdgpu_ring, copy_rate);
+	struct drm_sched_fence *s_fence = to_drm_sched_fence(f);
+
+	/* The job was just pushed to the ring, remember what is ahead of it */
+	rate->prev = amdgpu_fence_get(ring,
+				      READ_ONCE(ring->fence_drv.sync_seq) - 1);
+	if (dma_fence_add_callback(&s_fence->finished, &rate->finished_cb,
+				   amdgpu_ttm_copy_rate_finished)) {
+		dma_fence_put(rate->prev);
+		rate->prev = NULL;
+		atomic_set(&rate->busy, 0);
+	}
+}
+
+/* Sample the throughput of large copies for the CS move throttling */
+static void amdgpu_ttm_sample_copy_rate(struct amdgpu_ring *ring,
+					struct dma_fence *fence, u64 bytes)
+{
+	struct amdgpu_copy_rate *rate = &ring->copy_rate;
+	struct drm_sched_fence *s_fence = to_drm_sched_fence(fence);
+
+	if (bytes < SZ_1M || !s_fence)
+		return;
+
+	if (atomic_cmpxchg(&rate->busy, 0, 1))
+		return;
+
+	rate->bytes = bytes;
+	if (dma_fence_add_callback(&s_fence->scheduled, &rate->scheduled_cb,
+				   amdgpu_ttm_copy_rate_scheduled))
+		atomic_set(&rate->busy, 0);
+}
+
 /**
  * amdgpu_copy_ttm_mem_to_mem - Helper function for copy
  *
@@ -401,6 +468,8 @@ int amdgpu_ttm_copy_mem_to_mem(struct amdgpu_device *adev,
 		if (r)
 			goto error;
 
+		amdgpu_ttm_sample_copy_rate(ring, next, cur_size);
+
 		dma_fence_put(fence);
 		fence = next;
 
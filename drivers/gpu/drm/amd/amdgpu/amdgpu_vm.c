@@ -28,6 +28,7 @@
 #include <linux/dma-fence-array.h>
 #include <linux/interval_tree_generic.h>
 #include <linux/idr.h>
+#include <linux/list_sort.h>
 #include <drm/drmP.h>
 #include <drm/amdgpu_drm.h>
 #include "amdgpu.h"
@@ -1605,6 +1606,19 @@ static void amdgpu_vm_prt_fini(struct amdgpu_device *adev, struct amdgpu_vm *vm)
 	kfree(shared);
 }
 
+static int amdgpu_vm_freed_cmp(void *priv, struct list_head *a,
+			       struct list_head *b)
+{
+	struct amdgpu_bo_va_mapping *ma =
+		list_entry(a, struct amdgpu_bo_va_mapping, list);
+	struct amdgpu_bo_va_mapping *mb =
+		list_entry(b, struct amdgpu_bo_va_mapping, list);
+
+	if (ma->start < mb->start)
+		return -1;
+	return ma->start > mb->start;
+}
+
 /**
  * amdgpu_vm_clear_freed - clear freed BOs in the PT
  *
@@ -1613,7 +1627,8 @@ static void amdgpu_vm_prt_fini(struct amdgpu_device *adev, struct amdgpu_vm *vm)
  * @fence: optional resulting fence (unchanged if no work needed to be done
  * or if an error occurred)
  *
- * Make sure all freed BOs are cleared in the PT.
+ * Make sure all freed BOs are cleared in the PT. Adjacent freed ranges are
+ * cleared with a single update.
  * Returns 0 for success.
  *
  * PTs have to be reserved and mutex must be locked!
@@ -1622,23 +1637,40 @@ int amdgpu_vm_clear_freed(struct amdgpu_device *adev,
 			  struct amdgpu_vm *vm,
 			  struct dma_fence **fence)
 {
-	struct amdgpu_bo_va_mapping *mapping;
+	struct amdgpu_bo_va_mapping *mapping, *next;
 	struct dma_fence *f = NULL;
+	LIST_HEAD(range);
+	uint64_t last;
 	int r;
 	uint64_t init_pte_value = 0;
 
+	if (vm->pte_support_ats)
+		init_pte_value = AMDGPU_PTE_DEFAULT_ATC;
+
+	list_sort(NULL, &vm->freed, amdgpu_vm_freed_cmp);
+
 	while (!list_empty(&vm->freed)) {
 		mapping = list_first_entry(&vm->freed,
 			struct amdgpu_bo_va_mapping, list);
-		list_del(&mapping->list);
+		last = mapping->last;
+		list_move_tail(&mapping->list, &range);
 
-		if (vm->pte_support_ats)
-			init_pte_value = AMDGPU_PTE_DEFAULT_ATC;
+		while (!list_empty(&vm->freed)) {
+			next = list_first_entry(&vm->freed,
+				struct amdgpu_bo_va_mapping, list);
+			if (next->start != last + 1)
+				break;
+			last = next->last;
+			list_move_tail(&next->list, &range);
+		}
 
 		r = amdgpu_vm_bo_update_mapping(adev, NULL, NULL, vm,
-						mapping->start, mapping->last,
+						mapping->start, last,
 						init_pte_value, 0, &f);
-		amdgpu_vm_free_mapping(adev, vm, mapping, f);
+		list_for_each_entry_safe(mapping, next, &range, list) {
+			list_del(&mapping->list);
+			amdgpu_vm_free_mapping(adev, vm, mapping, f);
+		}
 		if (r) {
 			dma_fence_put(f);
 			return r;
@@ -2572,3 +2604,421 @@ int amdgpu_vm_ioctl(struct drm_device *dev, void *data, struct drm_file *filp)
 
 	return 0;
 }
+
+/*
+ * VM page table self test, enabled with amdgpu.test=2.
+ *
+ * A private VM is updated with the CPU while a pseudo random trace of map
+ * and unmap operations is replayed on it. The resulting PDEs and PTEs are
+ * read back from the page table BOs by a separate walker and compared
+ * against a flat model of the address space. The VM is never used for a
+ * submission, so the made up addresses it maps never reach the hardware.
+ */
+
+#define AMDGPU_VM_TEST_BASE		(1ULL << 20)	/* in GPU pages */
+#define AMDGPU_VM_TEST_PAGES		(1ULL << 14)
+#define AMDGPU_VM_TEST_OPS		512
+#define AMDGPU_VM_TEST_BENCH_BASE	(1ULL << 21)
+#define AMDGPU_VM_TEST_BENCH_PAGES	(1ULL << 18)	/* 1GB */
+#define AMDGPU_VM_TEST_ADDR_MASK	0x0000FFFFFFFFF000ULL
+#define AMDGPU_VM_TEST_FLAGS		(AMDGPU_PTE_VALID | \
+					 AMDGPU_PTE_READABLE | \
+					 AMDGPU_PTE_WRITEABLE)
+
+struct amdgpu_vm_test {
+	struct amdgpu_device	*adev;
+	struct amdgpu_vm	vm;
+	/* expected address of each page in the window, 0 if unmapped */
+	uint64_t		*model;
+	uint64_t		seed;
+	/* last update when the page tables are updated by the GPU */
+	struct dma_fence	*last;
+};
+
+static uint32_t amdgpu_vm_test_rand(struct amdgpu_vm_test *t)
+{
+	t->seed = t->seed * 6364136223846793005ULL + 1442695040888963407ULL;
+	return t->seed >> 32;
+}
+
+static int amdgpu_vm_test_validate(void *param, struct amdgpu_bo *bo)
+{
+	return amdgpu_bo_validate(bo);
+}
+
+/* Map [start, last] to @dst, or unmap it if @dst is zero */
+static int amdgpu_vm_test_update(struct amdgpu_vm_test *t,
+				 uint64_t start, uint64_t last, uint64_t dst)
+{
+	return amdgpu_vm_bo_update_mapping(t->adev, NULL, NULL, &t->vm,
+					   start, last,
+					   dst ? AMDGPU_VM_TEST_FLAGS : 0, dst,
+					   &t->last);
+}
+
+static int amdgpu_vm_test_wait(struct amdgpu_vm_test *t)
+{
+	long r = 0;
+
+	if (t->last)
+		r = dma_fence_wait(t->last, false);
+	dma_fence_put(t->last);
+	t->last = NULL;
+	return r;
+}
+
+static bool amdgpu_vm_test_contiguous(struct amdgpu_vm_test *t,
+				      uint64_t a, uint64_t b)
+{
+	if (!t->model[a])
+		return !t->model[b];
+
+	return t->model[b] == t->model[a] + AMDGPU_GPU_PAGE_SIZE;
+}
+
+/* Write window pages [first, last] from the model, one update per run */
+static int amdgpu_vm_test_rewrite(struct amdgpu_vm_test *t,
+				  uint64_t first, uint64_t last)
+{
+	uint64_t start = first, i;
+	int r;
+
+	for (i = first + 1; i <= last + 1; ++i) {
+		if (i <= last && amdgpu_vm_test_contiguous(t, i - 1, i))
+			continue;
+
+		r = amdgpu_vm_test_update(t, AMDGPU_VM_TEST_BASE + start,
+					  AMDGPU_VM_TEST_BASE + i - 1,
+					  t->model[start]);
+		if (r)
+			return r;
+		start = i;
+	}
+
+	return 0;
+}
+
+/* Reference walker, reads the entries back from the PD and PT BOs */
+static int amdgpu_vm_test_lookup(struct amdgpu_vm_test *t, uint64_t pfn,
+				 uint64_t *addr)
+{
+	struct amdgpu_device *adev = t->adev;
+	struct amdgpu_vm_pt *entry = &t->vm.root;
+	unsigned level = adev->vm_manager.root_level;
+	uint64_t *table, value;
+	unsigned idx;
+
+	for (; level != AMDGPU_VM_PTB; ++level) {
+		unsigned shift = amdgpu_vm_level_shift(adev, level);
+
+		idx = pfn >> shift;
+		pfn &= (1ULL << shift) - 1;
+		if (!entry->entries || !entry->entries[idx].base.bo)
+			return -ENOENT;
+
+		table = amdgpu_bo_kptr(entry->base.bo);
+		value = table[idx];
+		entry = &entry->entries[idx];
+
+		/* The PDE is used as PTE for the whole page table */
+		if (entry->huge) {
+			*addr = value & AMDGPU_PTE_VALID ?
+				(value & AMDGPU_VM_TEST_ADDR_MASK) +
+				pfn * AMDGPU_GPU_PAGE_SIZE : 0;
+			return 0;
+		}
+
+		if (!(value & AMDGPU_PTE_VALID))
+			return -EINVAL;
+	}
+
+	table = amdgpu_bo_kptr(entry->base.bo);
+	value = table[pfn];
+	*addr = value & AMDGPU_PTE_VALID ?
+		value & AMDGPU_VM_TEST_ADDR_MASK : 0;
+	return 0;
+}
+
+static int amdgpu_vm_test_verify(struct amdgpu_vm_test *t,
+				 uint64_t first, uint64_t last)
+{
+	uint64_t i, addr;
+	int r;
+
+	/* Flush pending write combined stores to the page tables */
+	mb();
+
+	for (i = first; i <= last; ++i) {
+		addr = 0;
+		r = amdgpu_vm_test_lookup(t, AMDGPU_VM_TEST_BASE + i, &addr);
+		if (r || addr != t->model[i]) {
+			DRM_ERROR("VM test: page 0x%llx maps 0x%llx, expected 0x%llx (%d)\n",
+				  AMDGPU_VM_TEST_BASE + i, addr, t->model[i], r);
+			return r ? r : -EINVAL;
+		}
+	}
+
+	return 0;
+}
+
+/* Apply one operation of the trace and check the page tables it touched */
+static int amdgpu_vm_test_op(struct amdgpu_vm_test *t)
+{
+	const uint64_t mask = AMDGPU_VM_PTE_COUNT(t->adev) - 1;
+	uint64_t start, last, count, dst, first_pt, last_pt, i;
+	uint32_t rnd = amdgpu_vm_test_rand(t);
+	int r;
+
+	start = amdgpu_vm_test_rand(t) % AMDGPU_VM_TEST_PAGES;
+	switch (rnd & 3) {
+	case 0:
+		count = 1;
+		break;
+	case 1:
+		count = 1 + (rnd >> 2) % 16;
+		break;
+	case 2:
+		count = 1 + (rnd >> 2) % 4096;
+		break;
+	default:
+		/* whole page tables, candidates for huge pages */
+		start &= ~mask;
+		count = (1 + (rnd >> 2) % 8) * (mask + 1);
+		break;
+	}
+	last = min(start + count, AMDGPU_VM_TEST_PAGES) - 1;
+
+	/* Keep the destination aligned like the VA so fragments get used */
+	if (rnd & 4)
+		dst = (((uint64_t)amdgpu_vm_test_rand(t) % 0x10000 + 1) << 21) +
+			((start & 0x1ff) << 12);
+	else
+		dst = 0;
+
+	for (i = start; i <= last; ++i)
+		t->model[i] = dst ? dst + (i - start) * AMDGPU_GPU_PAGE_SIZE : 0;
+
+	r = amdgpu_vm_test_update(t, AMDGPU_VM_TEST_BASE + start,
+				  AMDGPU_VM_TEST_BASE + last, dst);
+	if (r)
+		return r;
+
+	/* Like the driver does for the remains of a split mapping, rewrite
+	 * the rest of the partially touched page tables, which matters when
+	 * a huge page gets replaced by a page table again.
+	 */
+	first_pt = (AMDGPU_VM_TEST_BASE + start) & ~mask;
+	first_pt -= AMDGPU_VM_TEST_BASE;
+	last_pt = min((AMDGPU_VM_TEST_BASE + last) | mask,
+		      AMDGPU_VM_TEST_BASE + AMDGPU_VM_TEST_PAGES - 1);
+	last_pt -= AMDGPU_VM_TEST_BASE;
+
+	if (first_pt < start) {
+		r = amdgpu_vm_test_rewrite(t, first_pt, start - 1);
+		if (r)
+			return r;
+	}
+	if (last < last_pt) {
+		r = amdgpu_vm_test_rewrite(t, last + 1, last_pt);
+		if (r)
+			return r;
+	}
+
+	r = amdgpu_vm_update_directories(t->adev, &t->vm);
+	if (r)
+		return r;
+
+	return amdgpu_vm_test_verify(t, first_pt, last_pt);
+}
+
+/* Measure the cost of filling and clearing the PTEs for 1GB */
+static int amdgpu_vm_test_bench(struct amdgpu_vm_test *t,
+				struct amdgpu_vm_bench_result *res)
+{
+	const uint64_t start = AMDGPU_VM_TEST_BENCH_BASE;
+	const uint64_t last = start + AMDGPU_VM_TEST_BENCH_PAGES - 1;
+	const uint64_t dst = 1ULL << 30;
+	uint64_t pfn;
+	ktime_t time;
+	int r;
+
+	if (last >= t->adev->vm_manager.max_pfn)
+		return -ENOSPC;
+
+	r = amdgpu_vm_alloc_pts(t->adev, &t->vm,
+				start * AMDGPU_GPU_PAGE_SIZE,
+				AMDGPU_VM_TEST_BENCH_PAGES *
+				AMDGPU_GPU_PAGE_SIZE);
+	if (r)
+		return r;
+
+	r = amdgpu_vm_update_directories(t->adev, &t->vm);
+	if (r)
+		return r;
+
+	res->num_pages = AMDGPU_VM_TEST_BENCH_PAGES;
+
+	time = ktime_get();
+	r = amdgpu_vm_test_update(t, start, last, dst);
+	if (!r)
+		r = amdgpu_vm_test_wait(t);
+	if (r)
+		return r;
+	res->linear_us = ktime_us_delta(ktime_get(), time);
+
+	/* 64KB per update, the common case for sparse bindings */
+	time = ktime_get();
+	for (pfn = start; pfn <= last; pfn += 16) {
+		r = amdgpu_vm_test_update(t, pfn, pfn + 15,
+					  dst + (pfn - start) *
+					  AMDGPU_GPU_PAGE_SIZE);
+		if (r)
+			return r;
+	}
+	r = amdgpu_vm_test_wait(t);
+	if (r)
+		return r;
+	res->chunked_us = ktime_us_delta(ktime_get(), time);
+
+	time = ktime_get();
+	r = amdgpu_vm_test_update(t, start, last, 0);
+	if (!r)
+		r = amdgpu_vm_test_wait(t);
+	if (r)
+		return r;
+	res->clear_us = ktime_us_delta(ktime_get(), time);
+
+	return 0;
+}
+
+/**
+ * amdgpu_vm_test - check the page table update code
+ *
+ * @adev: amdgpu_device pointer
+ *
+ * Replay a map/unmap trace on a CPU updated VM, verify the page tables
+ * against a reference walker and report the update cost.
+ */
+void amdgpu_vm_test(struct amdgpu_device *adev)
+{
+	u32 update_mode = adev->vm_manager.vm_update_mode;
+	struct amdgpu_vm_test *t;
+	unsigned n;
+	int r;
+
+	if (!amdgpu_vm_is_large_bar(adev)) {
+		DRM_INFO("amdgpu: small BAR, skipping VM tests\n");
+		return;
+	}
+
+	if (AMDGPU_VM_TEST_BASE + AMDGPU_VM_TEST_PAGES >
+	    adev->vm_manager.max_pfn) {
+		DRM_INFO("amdgpu: VM too small, skipping VM tests\n");
+		return;
+	}
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return;
+
+	t->model = kvmalloc_array(AMDGPU_VM_TEST_PAGES, sizeof(uint64_t),
+				  GFP_KERNEL | __GFP_ZERO);
+	if (!t->model)
+		goto out_free;
+
+	t->adev = adev;
+	t->seed = 0x5eed;
+
+	/* Nothing else creates VMs while the driver is loading */
+	adev->vm_manager.vm_update_mode = AMDGPU_VM_USE_CPU_FOR_GFX;
+	r = amdgpu_vm_init(adev, &t->vm, AMDGPU_VM_CONTEXT_GFX, 0);
+	adev->vm_manager.vm_update_mode = update_mode;
+	if (r)
+		goto out_free;
+
+	r = amdgpu_bo_reserve(t->vm.root.base.bo, true);
+	if (r)
+		goto out_fini;
+
+	r = amdgpu_vm_validate_pt_bos(adev, &t->vm, amdgpu_vm_test_validate,
+				      NULL);
+	if (!r)
+		r = amdgpu_vm_alloc_pts(adev, &t->vm,
+					AMDGPU_VM_TEST_BASE *
+					AMDGPU_GPU_PAGE_SIZE,
+					AMDGPU_VM_TEST_PAGES *
+					AMDGPU_GPU_PAGE_SIZE);
+	if (!r)
+		r = amdgpu_vm_update_directories(adev, &t->vm);
+
+	for (n = 0; !r && n < AMDGPU_VM_TEST_OPS; ++n)
+		r = amdgpu_vm_test_op(t);
+
+	if (!r)
+		r = amdgpu_vm_test_verify(t, 0, AMDGPU_VM_TEST_PAGES - 1);
+
+	if (!r) {
+		struct amdgpu_vm_bench_result res;
+
+		DRM_INFO("amdgpu: VM page table test passed (%u operations)\n",
+			 n);
+		r = amdgpu_vm_test_bench(t, &res);
+		if (!r)
+			DRM_INFO("amdgpu: VM CPU update of 1GB: %lld us linear, %lld us in 64KB chunks, %lld us clear\n",
+				 res.linear_us, res.chunked_us, res.clear_us);
+		else if (r != -ENOSPC)
+			DRM_ERROR("VM benchmark failed (%d)\n", r);
+	} else {
+		DRM_ERROR("VM page table test failed after %u operations (%d)\n",
+			  n, r);
+	}
+
+	amdgpu_bo_unreserve(t->vm.root.base.bo);
+out_fini:
+	amdgpu_vm_fini(adev, &t->vm);
+out_free:
+	kvfree(t->model);
+	kfree(t);
+}
+
+/**
+ * amdgpu_vm_benchmark - measure page table update throughput
+ *
+ * @adev: amdgpu_device pointer
+ * @res: resulting times
+ *
+ * Map, remap in 64KB chunks and clear 1GB in a fresh VM, using the
+ * configured update mode and waiting for the GPU if it does the updates.
+ */
+int amdgpu_vm_benchmark(struct amdgpu_device *adev,
+			struct amdgpu_vm_bench_result *res)
+{
+	struct amdgpu_vm_test *t;
+	int r;
+
+	t = kzalloc(sizeof(*t), GFP_KERNEL);
+	if (!t)
+		return -ENOMEM;
+
+	t->adev = adev;
+	r = amdgpu_vm_init(adev, &t->vm, AMDGPU_VM_CONTEXT_GFX, 0);
+	if (r)
+		goto out_free;
+
+	r = amdgpu_bo_reserve(t->vm.root.base.bo, true);
+	if (r)
+		goto out_fini;
+
+	r = amdgpu_vm_validate_pt_bos(adev, &t->vm, amdgpu_vm_test_validate,
+				      NULL);
+	if (!r)
+		r = amdgpu_vm_test_bench(t, res);
+	amdgpu_vm_test_wait(t);
+
+	amdgpu_bo_unreserve(t->vm.root.base.bo);
+out_fini:
+	amdgpu_vm_fini(adev, &t->vm);
+out_free:
+	kfree(t);
+	return r;
+}
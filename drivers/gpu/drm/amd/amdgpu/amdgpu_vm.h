@@ -303,6 +303,17 @@ void amdgpu_vm_adjust_size(struct amdgpu_device *adev, uint32_t vm_size,
 			   uint32_t fragment_size_default, unsigned max_level,
 			   unsigned max_bits);
 int amdgpu_vm_ioctl(struct drm_device *dev, void *data, struct drm_file *filp);
+void amdgpu_vm_test(struct amdgpu_device *adev);
+
+struct amdgpu_vm_bench_result {
+	uint64_t	num_pages;
+	s64		linear_us;
+	s64		chunked_us;
+	s64		clear_us;
+};
+
+int amdgpu_vm_benchmark(struct amdgpu_device *adev,
+			struct amdgpu_vm_bench_result *res);
 bool amdgpu_vm_need_pipeline_sync(struct amdgpu_ring *ring,
 				  struct amdgpu_job *job);
 void amdgpu_vm_check_compute_bug(struct amdgpu_device *adev);
@@ -1069,15 +1069,22 @@ static int gmc_v6_0_vm_fault_interrupt_state(struct amdgpu_device *adev,
 	return 0;
 }
 
+static void gmc_v6_0_snapshot_interrupt(struct amdgpu_device *adev,
+					struct amdgpu_irq_src *source,
+					struct amdgpu_iv_entry *entry)
+{
+	entry->snapshot[0] = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_ADDR);
+	entry->snapshot[1] = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_STATUS);
+	/* reset addr and status */
+	WREG32_P(mmVM_CONTEXT1_CNTL2, 1, ~1);
+}
+
 static int gmc_v6_0_process_interrupt(struct amdgpu_device *adev,
 				      struct amdgpu_irq_src *source,
 				      struct amdgpu_iv_entry *entry)
 {
-	u32 addr, status;
-
-	addr = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_ADDR);
-	status = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_STATUS);
-	WREG32_P(mmVM_CONTEXT1_CNTL2, 1, ~1);
+	u32 addr = entry->snapshot[0];
+	u32 status = entry->snapshot[1];
 
 	if (!addr && !status)
 		return 0;
@@ -1138,6 +1145,7 @@ static const struct amdgpu_gart_funcs gmc_v6_0_gart_funcs = {
 static const struct amdgpu_irq_src_funcs gmc_v6_0_irq_funcs = {
 	.set = gmc_v6_0_vm_fault_interrupt_state,
 	.process = gmc_v6_0_process_interrupt,
+	.snapshot = gmc_v6_0_snapshot_interrupt,
 };
 
 static void gmc_v6_0_set_gart_funcs(struct amdgpu_device *adev)
@@ -1150,6 +1158,7 @@ static void gmc_v6_0_set_irq_funcs(struct amdgpu_device *adev)
 {
 	adev->mc.vm_fault.num_types = 1;
 	adev->mc.vm_fault.funcs = &gmc_v6_0_irq_funcs;
+	adev->mc.vm_fault.threaded = true;
 }
 
 const struct amdgpu_ip_block_version gmc_v6_0_ip_block =
@@ -1232,17 +1232,26 @@ static int gmc_v7_0_vm_fault_interrupt_state(struct amdgpu_device *adev,
 	return 0;
 }
 
+static void gmc_v7_0_snapshot_interrupt(struct amdgpu_device *adev,
+					struct amdgpu_irq_src *source,
+					struct amdgpu_iv_entry *entry)
+{
+	entry->snapshot[0] = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_ADDR);
+	entry->snapshot[1] = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_STATUS);
+	entry->snapshot[2] = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_MCCLIENT);
+	/* reset addr and status */
+	WREG32_P(mmVM_CONTEXT1_CNTL2, 1, ~1);
+}
+
 static int gmc_v7_0_process_interrupt(struct amdgpu_device *adev,
 				      struct amdgpu_irq_src *source,
 				      struct amdgpu_iv_entry *entry)
 {
 	u32 addr, status, mc_client;
 
-	addr = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_ADDR);
-	status = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_STATUS);
-	mc_client = RREG32(mmVM_CONTEXT1_PROTECTION_FAULT_MCCLIENT);
-	/* reset addr and status */
-	WREG32_P(mmVM_CONTEXT1_CNTL2, 1, ~1);
+	addr = entry->snapshot[0];
+	status = entry->snapshot[1];
+	mc_client = entry->snapshot[2];
 
 	if (!addr && !status)
 		return 0;
@@ -1317,6 +1326,7 @@ static const struct amdgpu_gart_funcs gmc_v7_0_gart_funcs = {
 static const struct amdgpu_irq_src_funcs gmc_v7_0_irq_funcs = {
 	.set = gmc_v7_0_vm_fault_interrupt_state,
 	.process = gmc_v7_0_process_interrupt,
+	.snapshot = gmc_v7_0_snapshot_interrupt,
 };
 
 static void gmc_v7_0_set_gart_funcs(struct amdgpu_device *adev)
@@ -1329,6 +1339,7 @@ static void gmc_v7_0_set_irq_funcs(struct amdgpu_device *adev)
 {
 	adev->mc.vm_fault.num_types = 1;
 	adev->mc.vm_fault.funcs = &gmc_v7_0_irq_funcs;
+	adev->mc.vm_fault.threaded = true;
 }
 
 const struct amdgpu_ip_block_version gmc_v7_0_ip_block =
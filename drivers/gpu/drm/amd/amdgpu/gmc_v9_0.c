@@ -244,22 +244,29 @@ static int gmc_v9_0_vm_fault_interrupt_state(struct amdgpu_device *adev,
 	return 0;
 }
 
+static void gmc_v9_0_snapshot_interrupt(struct amdgpu_device *adev,
+					struct amdgpu_irq_src *source,
+					struct amdgpu_iv_entry *entry)
+{
+	struct amdgpu_vmhub *hub = &adev->vmhub[entry->vmid_src];
+
+	entry->snapshot[0] = 0;
+	if (!amdgpu_sriov_vf(adev)) {
+		entry->snapshot[0] = RREG32(hub->vm_l2_pro_fault_status);
+		WREG32_P(hub->vm_l2_pro_fault_cntl, 1, ~1);
+	}
+}
+
 static int gmc_v9_0_process_interrupt(struct amdgpu_device *adev,
 				struct amdgpu_irq_src *source,
 				struct amdgpu_iv_entry *entry)
 {
-	struct amdgpu_vmhub *hub = &adev->vmhub[entry->vmid_src];
-	uint32_t status = 0;
+	uint32_t status = entry->snapshot[0];
 	u64 addr;
 
 	addr = (u64)entry->src_data[0] << 12;
 	addr |= ((u64)entry->src_data[1] & 0xf) << 44;
 
-	if (!amdgpu_sriov_vf(adev)) {
-		status = RREG32(hub->vm_l2_pro_fault_status);
-		WREG32_P(hub->vm_l2_pro_fault_cntl, 1, ~1);
-	}
-
 	if (printk_ratelimit()) {
 		dev_err(adev->dev,
 			"[%s] VMC page fault (src_id:%u ring:%u vmid:%u pas_id:%u)\n",
@@ -280,12 +287,14 @@ static int gmc_v9_0_process_interrupt(struct amdgpu_device *adev,
 static const struct amdgpu_irq_src_funcs gmc_v9_0_irq_funcs = {
 	.set = gmc_v9_0_vm_fault_interrupt_state,
 	.process = gmc_v9_0_process_interrupt,
+	.snapshot = gmc_v9_0_snapshot_interrupt,
 };
 
 static void gmc_v9_0_set_irq_funcs(struct amdgpu_device *adev)
 {
 	adev->mc.vm_fault.num_types = 1;
 	adev->mc.vm_fault.funcs = &gmc_v9_0_irq_funcs;
+	adev->mc.vm_fault.threaded = true;
 }
 
 static uint32_t gmc_v9_0_get_invalidate_req(unsigned int vmid)
@@ -389,10 +389,13 @@ static int vega10_ih_sw_init(void *handle)
 	adev->irq.ih.faults = kmalloc(sizeof(*adev->irq.ih.faults), GFP_KERNEL);
 	if (!adev->irq.ih.faults)
 		return -ENOMEM;
-	INIT_CHASH_TABLE(adev->irq.ih.faults->hash,
-			 AMDGPU_PAGEFAULT_HASH_BITS, 8, 0);
-	spin_lock_init(&adev->irq.ih.faults->lock);
-	adev->irq.ih.faults->count = 0;
+	r = chash_lf_set_init(adev->irq.ih.faults, AMDGPU_PAGEFAULT_HASH_BITS,
+			      AMDGPU_PAGEFAULT_HASH_MAX_BITS, GFP_KERNEL);
+	if (r) {
+		kfree(adev->irq.ih.faults);
+		adev->irq.ih.faults = NULL;
+		return r;
+	}
 
 	r = amdgpu_irq_init(adev);
 
@@ -406,8 +409,11 @@ static int vega10_ih_sw_fini(void *handle)
 	amdgpu_irq_fini(adev);
 	amdgpu_ih_ring_fini(adev);
 
-	kfree(adev->irq.ih.faults);
-	adev->irq.ih.faults = NULL;
+	if (adev->irq.ih.faults) {
+		chash_lf_set_fini(adev->irq.ih.faults);
+		kfree(adev->irq.ih.faults);
+		adev->irq.ih.faults = NULL;
+	}
 
 	return 0;
 }
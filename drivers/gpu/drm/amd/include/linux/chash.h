@@ -27,6 +27,8 @@
 #include <linux/types.h>
 #include <linux/hash.h>
 #include <linux/bug.h>
+#include <linux/atomic.h>
+#include <linux/rcupdate.h>
 #ifdef __linux__
 #include <asm/bitsperlong.h>
 #else
@@ -253,6 +255,29 @@ int __chash_table_copy_out(struct __chash_table *table, u64 key,
 #define chash_table_remove(tbl, key, value)			\
 	__chash_table_copy_out(&(*tbl).table, key, value, true)
 
+/**
+ * chash_table_lookup_batch - Look up several keys at once
+ * @tbl: Pointer to the table structure
+ * @keys: Array of @count keys to find
+ * @count: Number of keys
+ * @slots: Array of @count slot indices, may be NULL
+ * @values: Array of @count values, may be NULL
+ *
+ * Looks up all @keys, fetching the home slots of a group of keys
+ * before probing any of them. Unlike chash_table_copy_out this never
+ * modifies the table. If @slots is not NULL, it receives the slot
+ * index of each key or %-EINVAL if the key was not found. If @values
+ * is not NULL and the table has a non-0 value_size, the values of
+ * found keys are copied to the corresponding entries. Returns the
+ * number of keys found.
+ */
+#define chash_table_lookup_batch(tbl, keys, count, slots, values)	\
+	__chash_table_lookup_batch(&(*tbl).table, keys, count, slots, values)
+
+unsigned int __chash_table_lookup_batch(struct __chash_table *table,
+					const u64 *keys, unsigned int count,
+					int *slots, void *values);
+
 /*
  * Low level iterator API used internally by the above functions.
  */
@@ -367,4 +392,39 @@ static inline void *chash_iter_value(const struct chash_iter iter)
 		((unsigned long)iter.slot * iter.table->value_size);
 }
 
+/*
+ * Lock-free hash set of 64-bit keys
+ *
+ * Keys are added and removed with compare-and-swap, so interrupt
+ * handlers and threads on other CPUs can share the set without a
+ * lock. A slot taken by a key stays with that key, removing it only
+ * clears its active flag. Once too many slots are taken, the next add
+ * rebuilds the table with just the active keys, growing it up to
+ * 2^max_bits entries if needed.
+ *
+ * Keys must be non-zero and even, bit 0 is used as the active flag.
+ */
+struct chash_lf_table {
+	struct rcu_head rcu;
+	u8 bits;
+	bool frozen;		/* being rebuilt, don't modify */
+	atomic_t used;		/* slots taken by a key */
+	atomic_t active;	/* keys currently in the set */
+	atomic64_t slots[];
+};
+
+struct chash_lf_set {
+	struct chash_lf_table __rcu *table;
+	u8 min_bits, max_bits;
+	atomic_t rebuilding;
+	atomic_t rebuilds;
+};
+
+int chash_lf_set_init(struct chash_lf_set *set, u8 min_bits, u8 max_bits,
+		      gfp_t gfp_mask);
+void chash_lf_set_fini(struct chash_lf_set *set);
+int chash_lf_set_add(struct chash_lf_set *set, u64 key, gfp_t gfp_mask);
+int chash_lf_set_remove(struct chash_lf_set *set, u64 key);
+unsigned int chash_lf_set_count(struct chash_lf_set *set);
+
 #endif /* _LINUX_CHASH_H */
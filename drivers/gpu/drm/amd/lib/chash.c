@@ -27,6 +27,11 @@
 #include <linux/slab.h>
 #include <linux/module.h>
 #include <linux/sched/clock.h>
+#include <linux/irqflags.h>
+#include <linux/kthread.h>
+#include <linux/completion.h>
+#include <linux/cpumask.h>
+#include <linux/prefetch.h>
 #include <asm/div64.h>
 #include <linux/chash.h>
 
@@ -447,6 +452,376 @@ int __chash_table_copy_out(struct __chash_table *table, u64 key,
 }
 EXPORT_SYMBOL(__chash_table_copy_out);
 
+/* Number of keys whose home slots are fetched ahead of probing */
+#define CHASH_BATCH_SIZE 16
+
+static int chash_table_lookup(struct __chash_table *table, u64 key, u32 hash)
+{
+	struct chash_iter iter = CHASH_ITER_INIT(table, hash);
+	u32 n;
+
+	for (n = 0; n <= table->size_mask; n++) {
+		if (chash_iter_is_empty(iter))
+			break;
+		if (chash_iter_is_valid(iter) && chash_iter_key(iter) == key)
+			return iter.slot;
+		CHASH_ITER_INC(iter);
+	}
+
+	return -EINVAL;
+}
+
+unsigned int __chash_table_lookup_batch(struct __chash_table *table,
+					const u64 *keys, unsigned int count,
+					int *slots, void *values)
+{
+	u32 hashes[CHASH_BATCH_SIZE];
+	unsigned int i, j, n, found = 0;
+
+	for (i = 0; i < count; i += n) {
+		n = min_t(unsigned int, count - i, CHASH_BATCH_SIZE);
+
+		/* Start fetching all home slots of the batch, so the
+		 * cache misses overlap instead of adding up
+		 */
+		for (j = 0; j < n; j++) {
+			u32 hash = (table->key_size == 4) ?
+				hash_32(keys[i + j], table->bits) :
+				hash_64(keys[i + j], table->bits);
+
+			hashes[j] = hash;
+			prefetch(&table->occup_bitmap[hash >> _CHASH_LONG_SHIFT]);
+			prefetch(&table->valid_bitmap[hash >> _CHASH_LONG_SHIFT]);
+			if (table->key_size == 4)
+				prefetch(&table->keys32[hash]);
+			else
+				prefetch(&table->keys64[hash]);
+		}
+
+		for (j = 0; j < n; j++) {
+			int slot = chash_table_lookup(table, keys[i + j],
+						      hashes[j]);
+
+			if (slots)
+				slots[i + j] = slot;
+			if (slot < 0)
+				continue;
+
+			found++;
+			if (values && table->value_size)
+				memcpy((u8 *)values +
+				       (unsigned long)(i + j) * table->value_size,
+				       table->values +
+				       (unsigned long)slot * table->value_size,
+				       table->value_size);
+		}
+	}
+
+	return found;
+}
+EXPORT_SYMBOL(__chash_table_lookup_batch);
+
+#define CHASH_LF_ACTIVE 1ULL
+
+static struct chash_lf_table *chash_lf_table_alloc(u8 bits, gfp_t gfp_mask)
+{
+	struct chash_lf_table *t;
+
+	t = kzalloc(sizeof(*t) + (sizeof(atomic64_t) << bits), gfp_mask);
+	if (!t)
+		return NULL;
+
+	t->bits = bits;
+	return t;
+}
+
+/* Returns 0 if the key was added, 1 if it was already active and
+ * -ENOSPC if no slot is left for it.
+ */
+static int chash_lf_table_add(struct chash_lf_table *t, u64 key)
+{
+	u32 mask = (1U << t->bits) - 1;
+	u32 slot = hash_64(key, t->bits);
+	u32 n;
+
+	for (n = 0; n <= mask; n++, slot = (slot + 1) & mask) {
+		atomic64_t *s = &t->slots[slot];
+		u64 v = atomic64_read(s);
+
+		if (!v) {
+			v = atomic64_cmpxchg(s, 0, key | CHASH_LF_ACTIVE);
+			if (!v) {
+				atomic_inc(&t->used);
+				atomic_inc(&t->active);
+				return 0;
+			}
+		}
+
+		/* A slot never changes its key once taken, only the
+		 * active flag toggles
+		 */
+		while ((v & ~CHASH_LF_ACTIVE) == key) {
+			u64 old;
+
+			if (v & CHASH_LF_ACTIVE)
+				return 1;
+
+			old = atomic64_cmpxchg(s, v, v | CHASH_LF_ACTIVE);
+			if (old == v) {
+				atomic_inc(&t->active);
+				return 0;
+			}
+			v = old;
+		}
+	}
+
+	return -ENOSPC;
+}
+
+static int chash_lf_table_remove(struct chash_lf_table *t, u64 key)
+{
+	u32 mask = (1U << t->bits) - 1;
+	u32 slot = hash_64(key, t->bits);
+	u32 n;
+
+	for (n = 0; n <= mask; n++, slot = (slot + 1) & mask) {
+		atomic64_t *s = &t->slots[slot];
+		u64 v = atomic64_read(s);
+
+		if (!v)
+			break;
+		if ((v & ~CHASH_LF_ACTIVE) != key)
+			continue;
+
+		if (!(v & CHASH_LF_ACTIVE) ||
+		    atomic64_cmpxchg(s, v, key) != v)
+			break;
+
+		atomic_dec(&t->active);
+		return 0;
+	}
+
+	return -ENOENT;
+}
+
+/* Wait for a rebuild of @t to be published. The rebuild runs with
+ * interrupts disabled, so it can't be waiting for us on this CPU.
+ */
+static struct chash_lf_table *chash_lf_set_wait(struct chash_lf_set *set,
+						struct chash_lf_table *t)
+{
+	struct chash_lf_table *next;
+
+	while ((next = rcu_dereference(set->table)) == t)
+		cpu_relax();
+
+	return next;
+}
+
+static void chash_lf_set_rebuild(struct chash_lf_set *set,
+				 struct chash_lf_table *old, gfp_t gfp_mask)
+{
+	struct chash_lf_table *new;
+	unsigned long flags;
+	unsigned int active;
+	u8 bits;
+	u32 i;
+
+	/* Only the rebuilder frees tables, so once we own the rebuild
+	 * and @old is still current it can't go away under us
+	 */
+	if (atomic_xchg(&set->rebuilding, 1))
+		return;
+	if (rcu_access_pointer(set->table) != old)
+		goto out;
+
+	active = atomic_read(&old->active);
+	for (bits = set->min_bits;
+	     bits < set->max_bits && (1U << bits) < active * 4; bits++)
+		;
+
+	new = chash_lf_table_alloc(bits, gfp_mask);
+	if (!new)
+		goto out;
+
+	/* Concurrent add/remove check the frozen flag after modifying
+	 * a slot and redo the operation on the new table if it is set,
+	 * so nothing gets lost while copying.
+	 */
+	local_irq_save(flags);
+	WRITE_ONCE(old->frozen, true);
+	smp_mb();
+	for (i = 0; i < (1U << old->bits); i++) {
+		u64 v = atomic64_read(&old->slots[i]);
+
+		if (v & CHASH_LF_ACTIVE)
+			chash_lf_table_add(new, v & ~CHASH_LF_ACTIVE);
+	}
+	rcu_assign_pointer(set->table, new);
+	local_irq_restore(flags);
+
+	atomic_inc(&set->rebuilds);
+	kfree_rcu(old, rcu);
+out:
+	atomic_set(&set->rebuilding, 0);
+}
+
+/**
+ * chash_lf_set_init - Initialize a lock-free hash set
+ * @set: Pointer to the set
+ * @min_bits: Initial and minimum table size will be 2^min_bits entries
+ * @max_bits: Maximum table size will be 2^max_bits entries
+ * @gfp_mask: Flags for allocating the table
+ *
+ * Returns 0 on success, negative error code on failure.
+ */
+int chash_lf_set_init(struct chash_lf_set *set, u8 min_bits, u8 max_bits,
+		      gfp_t gfp_mask)
+{
+	struct chash_lf_table *t;
+
+	if (min_bits < 2 || min_bits > max_bits || max_bits > 24)
+		return -EINVAL;
+
+	t = chash_lf_table_alloc(min_bits, gfp_mask);
+	if (!t)
+		return -ENOMEM;
+
+	RCU_INIT_POINTER(set->table, t);
+	set->min_bits = min_bits;
+	set->max_bits = max_bits;
+	atomic_set(&set->rebuilding, 0);
+	atomic_set(&set->rebuilds, 0);
+
+	return 0;
+}
+EXPORT_SYMBOL(chash_lf_set_init);
+
+/**
+ * chash_lf_set_fini - Free a lock-free hash set
+ * @set: Pointer to the set
+ *
+ * The caller must make sure no one else accesses the set any more.
+ */
+void chash_lf_set_fini(struct chash_lf_set *set)
+{
+	kfree(rcu_dereference_protected(set->table, true));
+	RCU_INIT_POINTER(set->table, NULL);
+}
+EXPORT_SYMBOL(chash_lf_set_fini);
+
+/**
+ * chash_lf_set_add - Add a key to a lock-free hash set
+ * @set: Pointer to the set
+ * @key: Key to add, must be non-zero and even
+ * @gfp_mask: Flags for allocating a bigger table
+ *
+ * Safe to call from interrupt context with GFP_ATOMIC.
+ *
+ * Returns 0 if the key was added, 1 if it was already in the set,
+ * -ENOSPC if the set is full.
+ */
+int chash_lf_set_add(struct chash_lf_set *set, u64 key, gfp_t gfp_mask)
+{
+	struct chash_lf_table *t;
+	bool added = false;
+	bool full, rebuild;
+	int r;
+
+	if (WARN_ON(!key || (key & CHASH_LF_ACTIVE)))
+		return -EINVAL;
+
+	rcu_read_lock();
+	t = rcu_dereference(set->table);
+	full = atomic_read(&t->active) >= (1 << set->max_bits) / 2;
+	rebuild = atomic_read(&t->used) >= (3 << t->bits) / 4;
+	rcu_read_unlock();
+
+	if (full)
+		return -ENOSPC;
+
+	/* Outside the RCU read side, the allocation may sleep */
+	if (rebuild)
+		chash_lf_set_rebuild(set, t, gfp_mask);
+
+	rcu_read_lock();
+	t = rcu_dereference(set->table);
+	for (;;) {
+		if (READ_ONCE(t->frozen)) {
+			t = chash_lf_set_wait(set, t);
+			continue;
+		}
+
+		r = chash_lf_table_add(t, key);
+		if (!r)
+			added = true;
+
+		smp_mb();
+		if (!READ_ONCE(t->frozen))
+			break;
+		t = chash_lf_set_wait(set, t);
+	}
+	if (added)
+		r = 0;
+
+	rcu_read_unlock();
+	return r;
+}
+EXPORT_SYMBOL(chash_lf_set_add);
+
+/**
+ * chash_lf_set_remove - Remove a key from a lock-free hash set
+ * @set: Pointer to the set
+ * @key: Key to remove
+ *
+ * Returns 0 on success, -ENOENT if the key was not in the set.
+ */
+int chash_lf_set_remove(struct chash_lf_set *set, u64 key)
+{
+	struct chash_lf_table *t;
+	bool removed = false;
+
+	if (!key || (key & CHASH_LF_ACTIVE))
+		return -ENOENT;
+
+	rcu_read_lock();
+	t = rcu_dereference(set->table);
+
+	for (;;) {
+		if (READ_ONCE(t->frozen)) {
+			t = chash_lf_set_wait(set, t);
+			continue;
+		}
+
+		removed |= !chash_lf_table_remove(t, key);
+
+		smp_mb();
+		if (!READ_ONCE(t->frozen))
+			break;
+		t = chash_lf_set_wait(set, t);
+	}
+
+	rcu_read_unlock();
+	return removed ? 0 : -ENOENT;
+}
+EXPORT_SYMBOL(chash_lf_set_remove);
+
+/**
+ * chash_lf_set_count - Number of keys in a lock-free hash set
+ * @set: Pointer to the set
+ */
+unsigned int chash_lf_set_count(struct chash_lf_set *set)
+{
+	unsigned int count;
+
+	rcu_read_lock();
+	count = atomic_read(&rcu_dereference(set->table)->active);
+	rcu_read_unlock();
+
+	return count;
+}
+EXPORT_SYMBOL(chash_lf_set_count);
+
 #ifdef CONFIG_CHASH_SELFTEST
 /**
  * chash_self_test - Run a self-test of the hash table implementation
@@ -551,6 +926,252 @@ out:
 	return ret;
 }
 
+static u64 __init chash_lookup_rate(u64 lookups, u64 ts_ns)
+{
+	u64 rate = lookups * 1000;
+
+	do_div(ts_ns, 1000);
+	do_div(rate, ts_ns ? ts_ns : 1);
+	return rate * 1000;
+}
+
+/**
+ * chash_lookup_bench - Compare single and batched lookups
+ * @bits: Table size will be 2^bits entries
+ * @key_size: Size of hash keys in bytes, 4 or 8
+ * @lookups: Number of lookups per fill level
+ *
+ * Fills a table to 25%, 50%, 75% and 90% and measures lookups per
+ * second with chash_table_copy_out and chash_table_lookup_batch. Half
+ * of the lookups are misses.
+ */
+static int __init chash_lookup_bench(u8 bits, u8 key_size, u64 lookups)
+{
+	static const unsigned int fill_pct[] = { 25, 50, 75, 90 };
+	u64 keys[CHASH_BATCH_SIZE * 4], values[CHASH_BATCH_SIZE * 4];
+	struct chash_table table;
+	unsigned int f;
+	int ret = 0;
+
+	for (f = 0; f < ARRAY_SIZE(fill_pct); f++) {
+		u64 fill = ((1ULL << bits) * fill_pct[f]) / 100;
+		u64 i, found, hits = 0, ts_single, ts_batch;
+		u64 value;
+
+		ret = chash_table_alloc(&table, bits, key_size, sizeof(u64),
+					GFP_KERNEL);
+		if (ret) {
+			pr_err("chash_table_alloc failed: %d\n", ret);
+			return ret;
+		}
+
+		for (i = 0; i < fill; i++) {
+			value = ~i;
+			chash_table_copy_in(&table, i, &value);
+		}
+
+		ts_single = local_clock();
+		for (i = 0; i < lookups; i++) {
+			u64 key = i % (fill * 2);
+
+			if (chash_table_copy_out(&table, key, &value) >= 0)
+				hits++;
+		}
+		ts_single = local_clock() - ts_single;
+
+		found = 0;
+		ts_batch = local_clock();
+		for (i = 0; i < lookups; i += ARRAY_SIZE(keys)) {
+			unsigned int j, n = min_t(u64, lookups - i,
+						  ARRAY_SIZE(keys));
+
+			for (j = 0; j < n; j++)
+				keys[j] = (i + j) % (fill * 2);
+			found += chash_table_lookup_batch(&table, keys, n,
+							  NULL, values);
+		}
+		ts_batch = local_clock() - ts_batch;
+
+		chash_table_free(&table);
+
+		if (found != hits) {
+			pr_err("chash: batch lookup found %llu keys, expected %llu\n",
+			       found, hits);
+			return -EFAULT;
+		}
+
+		pr_info("chash: %u%% full, %llu lookups/s single, %llu lookups/s batched\n",
+			fill_pct[f], chash_lookup_rate(lookups, ts_single),
+			chash_lookup_rate(lookups, ts_batch));
+	}
+
+	return ret;
+}
+
+struct chash_lf_test {
+	struct chash_lf_set set;
+	struct completion start;
+	atomic_t failed;
+	unsigned int threads;
+	unsigned int min_fill, max_fill;
+	u64 iterations;
+};
+
+struct chash_lf_test_thread {
+	struct chash_lf_test *test;
+	struct completion done;
+	unsigned int id;
+	u64 count;
+};
+
+/* Every thread works on its own keys, so we know what to expect */
+static u64 chash_lf_test_key(struct chash_lf_test_thread *thread, u64 i)
+{
+	return ((i * thread->test->threads + thread->id) + 1) << 1;
+}
+
+static int chash_lf_test_func(void *data)
+{
+	struct chash_lf_test_thread *thread = data;
+	struct chash_lf_test *test = thread->test;
+	u64 add_count, rmv_count;
+	int ret;
+
+	wait_for_completion(&test->start);
+
+	for (add_count = 0, rmv_count = 0; add_count < test->iterations;
+	     add_count++) {
+		if (atomic_read(&test->failed))
+			break;
+
+		if (add_count - rmv_count == test->max_fill) {
+			for (; add_count - rmv_count > test->min_fill;
+			     rmv_count++) {
+				u64 key = chash_lf_test_key(thread, rmv_count);
+
+				ret = chash_lf_set_add(&test->set, key,
+						       GFP_KERNEL);
+				if (ret != 1) {
+					pr_err("chash: lf add second time returned %d, expected 1\n",
+					       ret);
+					goto fail;
+				}
+				ret = chash_lf_set_remove(&test->set, key);
+				if (ret) {
+					pr_err("chash: lf remove of 0x%llx failed: %d\n",
+					       key, ret);
+					goto fail;
+				}
+			}
+		}
+
+		ret = chash_lf_set_add(&test->set,
+				       chash_lf_test_key(thread, add_count),
+				       GFP_KERNEL);
+		if (ret) {
+			pr_err("chash: lf add first time returned %d, expected 0\n",
+			       ret);
+			goto fail;
+		}
+	}
+	thread->count = add_count - rmv_count;
+	goto out;
+
+fail:
+	atomic_inc(&test->failed);
+out:
+	complete(&thread->done);
+	return 0;
+}
+
+/**
+ * chash_lf_self_test - Stress test the lock-free hash set
+ * @bits: Initial table size will be 2^bits entries
+ * @threads: Number of concurrent threads
+ * @min_fill: Minimum fill level during the test
+ * @max_fill: Maximum fill level during the test
+ * @iterations: Number of test iterations
+ *
+ * Same as chash_self_test, but with the fill levels and iterations
+ * split between @threads threads adding and removing keys
+ * concurrently. The table may grow up to 4 times its initial size.
+ */
+static int __init chash_lf_self_test(u8 bits, unsigned int threads,
+				     int min_fill, int max_fill,
+				     u64 iterations)
+{
+	struct chash_lf_test_thread *thread;
+	struct chash_lf_test test;
+	struct task_struct *task;
+	unsigned int i, count;
+	u64 expected = 0;
+	int ret;
+
+	if (!threads || min_fill / threads >= max_fill / threads)
+		return -EINVAL;
+
+	thread = kcalloc(threads, sizeof(*thread), GFP_KERNEL);
+	if (!thread)
+		return -ENOMEM;
+
+	ret = chash_lf_set_init(&test.set, bits, bits + 2, GFP_KERNEL);
+	if (ret) {
+		pr_err("chash_lf_set_init failed: %d\n", ret);
+		goto out_free;
+	}
+
+	init_completion(&test.start);
+	atomic_set(&test.failed, 0);
+	test.threads = threads;
+	test.min_fill = min_fill / threads;
+	test.max_fill = max_fill / threads;
+	do_div(iterations, threads);
+	test.iterations = iterations;
+
+	for (i = 0; i < threads; i++) {
+		thread[i].test = &test;
+		thread[i].id = i;
+		init_completion(&thread[i].done);
+
+		task = kthread_run(chash_lf_test_func, &thread[i],
+				   "chash_lf/%u", i);
+		if (IS_ERR(task)) {
+			pr_err("chash: failed to start test thread: %ld\n",
+			       PTR_ERR(task));
+			atomic_inc(&test.failed);
+			complete(&thread[i].done);
+		}
+	}
+
+	complete_all(&test.start);
+	for (i = 0; i < threads; i++) {
+		wait_for_completion(&thread[i].done);
+		expected += thread[i].count;
+	}
+
+	if (atomic_read(&test.failed)) {
+		ret = -EFAULT;
+		goto out_fini;
+	}
+
+	count = chash_lf_set_count(&test.set);
+	if (count != expected) {
+		pr_err("chash: lf set has %u entries, expected %llu\n",
+		       count, expected);
+		ret = -EFAULT;
+		goto out_fini;
+	}
+
+	pr_info("chash: lf set rebuilt %d times\n",
+		atomic_read(&test.set.rebuilds));
+
+out_fini:
+	chash_lf_set_fini(&test.set);
+out_free:
+	kfree(thread);
+	return ret;
+}
+
 static unsigned int chash_test_bits = 10;
 MODULE_PARM_DESC(test_bits,
 		 "Selftest number of hash bits ([4..20], default=10)");
@@ -572,6 +1193,16 @@ static unsigned long chash_test_iters;
 MODULE_PARM_DESC(test_iters, "Selftest iterations (default=1000 x #entries)");
 module_param_named(test_iters, chash_test_iters, ulong, 0444);
 
+static unsigned long chash_test_lookups;
+MODULE_PARM_DESC(test_lookups,
+		 "Selftest lookups per fill level (default=100 x #entries)");
+module_param_named(test_lookups, chash_test_lookups, ulong, 0444);
+
+static unsigned int chash_test_threads;
+MODULE_PARM_DESC(test_threads,
+		 "Selftest threads for the lock-free set (default=#CPUs)");
+module_param_named(test_threads, chash_test_threads, uint, 0444);
+
 static int __init chash_init(void)
 {
 	int ret;
@@ -625,6 +1256,32 @@ static int __init chash_init(void)
 			ts_delta_us, iters_per_second);
 	} else {
 		pr_err("chash: self test failed: %d\n", ret);
+		return ret;
+	}
+
+	ret = chash_lookup_bench(chash_test_bits, chash_test_keysize,
+				 chash_test_lookups ? chash_test_lookups :
+				 (1 << chash_test_bits) * 100);
+	if (ret)
+		return ret;
+
+	if (!chash_test_threads)
+		chash_test_threads = num_online_cpus();
+
+	ts1_ns = local_clock();
+	ret = chash_lf_self_test(chash_test_bits, chash_test_threads,
+				 chash_test_minfill, chash_test_maxfill,
+				 chash_test_iters);
+	if (!ret) {
+		u64 ts_delta_us = local_clock() - ts1_ns;
+		u64 iters_per_second = (u64)chash_test_iters * 1000000;
+
+		do_div(ts_delta_us, 1000);
+		do_div(iters_per_second, ts_delta_us);
+		pr_info("chash: lf test with %u threads took %llu us, %llu iterations/s\n",
+			chash_test_threads, ts_delta_us, iters_per_second);
+	} else {
+		pr_err("chash: lf test failed: %d\n", ret);
 	}
 
 	return ret;
@@ -30,6 +30,7 @@
 #include <drm/drm_atomic.h>
 #include <drm/drm_mode.h>
 #include <drm/drm_print.h>
+#include <linux/debugfs.h>
 #include <linux/sync_file.h>
 
 #include "drm_crtc_internal.h"
@@ -101,6 +102,78 @@ fail:
 }
 EXPORT_SYMBOL(drm_atomic_state_init);
 
+/*
+ * States of drivers which don't subclass &drm_atomic_state are only ever
+ * allocated and freed by the core, so instead of freeing them their cleared
+ * shells, including the per-object arrays, are kept for the next commit.
+ */
+static bool drm_atomic_state_cacheable(struct drm_mode_config *config)
+{
+	return !config->funcs->atomic_state_alloc &&
+	       !config->funcs->atomic_state_free;
+}
+
+static struct drm_atomic_state *
+drm_atomic_state_cache_get(struct drm_mode_config *config)
+{
+	struct drm_atomic_state_cache *cache = &config->atomic_state_cache;
+	struct drm_atomic_state *state = NULL;
+
+	spin_lock(&cache->lock);
+	if (cache->count)
+		state = cache->states[--cache->count];
+	spin_unlock(&cache->lock);
+
+	if (!state)
+		return NULL;
+
+	kref_init(&state->ref);
+	state->allow_modeset = true;
+	state->legacy_cursor_update = false;
+	state->async_update = false;
+	state->acquire_ctx = NULL;
+	atomic_long_inc(&cache->reuses);
+
+	DRM_DEBUG_ATOMIC("Reusing atomic state %p\n", state);
+
+	return state;
+}
+
+static bool drm_atomic_state_cache_put(struct drm_atomic_state *state)
+{
+	struct drm_atomic_state_cache *cache =
+		&state->dev->mode_config.atomic_state_cache;
+	bool cached = false;
+
+	spin_lock(&cache->lock);
+	if (cache->count < ARRAY_SIZE(cache->states)) {
+		cache->states[cache->count++] = state;
+		cached = true;
+	}
+	spin_unlock(&cache->lock);
+
+	return cached;
+}
+
+/**
+ * drm_atomic_state_cache_fini - free all cached atomic states
+ * @dev: DRM device
+ *
+ * Called from drm_mode_config_cleanup().
+ */
+void drm_atomic_state_cache_fini(struct drm_device *dev)
+{
+	struct drm_atomic_state_cache *cache =
+		&dev->mode_config.atomic_state_cache;
+
+	while (cache->count) {
+		struct drm_atomic_state *state = cache->states[--cache->count];
+
+		drm_atomic_state_default_release(state);
+		kfree(state);
+	}
+}
+
 /**
  * drm_atomic_state_alloc - allocate atomic state
  * @dev: DRM device
@@ -115,6 +188,13 @@ drm_atomic_state_alloc(struct drm_device *dev)
 	if (!config->funcs->atomic_state_alloc) {
 		struct drm_atomic_state *state;
 
+		if (drm_atomic_state_cacheable(config)) {
+			state = drm_atomic_state_cache_get(config);
+			if (state)
+				return state;
+			atomic_long_inc(&config->atomic_state_cache.allocs);
+		}
+
 		state = kzalloc(sizeof(*state), GFP_KERNEL);
 		if (!state)
 			return NULL;
@@ -248,6 +328,10 @@ void __drm_atomic_state_free(struct kref *ref)
 
 	drm_atomic_state_clear(state);
 
+	if (drm_atomic_state_cacheable(config) &&
+	    drm_atomic_state_cache_put(state))
+		return;
+
 	DRM_DEBUG_ATOMIC("Freeing atomic state %p\n", state);
 
 	if (config->funcs->atomic_state_free) {
@@ -443,6 +527,133 @@ drm_atomic_replace_property_blob_from_id(struct drm_device *dev,
 	return 0;
 }
 
+struct drm_atomic_core_property {
+	size_t offset;
+	unsigned int kind;
+};
+
+#define CORE_PROP(member, k) \
+	{ offsetof(struct drm_mode_config, member), DRM_ATOMIC_PROP_##k }
+
+static const struct drm_atomic_core_property crtc_core_props[] = {
+	CORE_PROP(prop_active, ACTIVE),
+	CORE_PROP(prop_mode_id, MODE_ID),
+	CORE_PROP(degamma_lut_property, DEGAMMA_LUT),
+	CORE_PROP(ctm_property, CTM),
+	CORE_PROP(gamma_lut_property, GAMMA_LUT),
+	CORE_PROP(prop_out_fence_ptr, OUT_FENCE_PTR),
+};
+
+static const struct drm_atomic_core_property plane_core_props[] = {
+	CORE_PROP(prop_fb_id, FB_ID),
+	CORE_PROP(prop_in_fence_fd, IN_FENCE_FD),
+	CORE_PROP(prop_crtc_id, CRTC_ID),
+	CORE_PROP(prop_crtc_x, CRTC_X),
+	CORE_PROP(prop_crtc_y, CRTC_Y),
+	CORE_PROP(prop_crtc_w, CRTC_W),
+	CORE_PROP(prop_crtc_h, CRTC_H),
+	CORE_PROP(prop_src_x, SRC_X),
+	CORE_PROP(prop_src_y, SRC_Y),
+	CORE_PROP(prop_src_w, SRC_W),
+	CORE_PROP(prop_src_h, SRC_H),
+};
+
+static const struct drm_atomic_core_property connector_core_props[] = {
+	CORE_PROP(prop_crtc_id, CRTC_ID),
+	CORE_PROP(dpms_property, DPMS),
+	CORE_PROP(tv_select_subconnector_property, TV_SELECT_SUBCONNECTOR),
+	CORE_PROP(tv_left_margin_property, TV_LEFT_MARGIN),
+	CORE_PROP(tv_right_margin_property, TV_RIGHT_MARGIN),
+	CORE_PROP(tv_top_margin_property, TV_TOP_MARGIN),
+	CORE_PROP(tv_bottom_margin_property, TV_BOTTOM_MARGIN),
+	CORE_PROP(tv_mode_property, TV_MODE),
+	CORE_PROP(tv_brightness_property, TV_BRIGHTNESS),
+	CORE_PROP(tv_contrast_property, TV_CONTRAST),
+	CORE_PROP(tv_flicker_reduction_property, TV_FLICKER_REDUCTION),
+	CORE_PROP(tv_overscan_property, TV_OVERSCAN),
+	CORE_PROP(tv_saturation_property, TV_SATURATION),
+	CORE_PROP(tv_hue_property, TV_HUE),
+	CORE_PROP(link_status_property, LINK_STATUS),
+	CORE_PROP(aspect_ratio_property, ASPECT_RATIO),
+};
+
+#undef CORE_PROP
+
+static unsigned int
+drm_atomic_match_core_property(struct drm_mode_config *config,
+			       const struct drm_atomic_core_property *props,
+			       unsigned int count,
+			       struct drm_property *property)
+{
+	unsigned int i;
+
+	for (i = 0; i < count; i++) {
+		struct drm_property **prop =
+			(void *)config + props[i].offset;
+
+		if (*prop == property)
+			return props[i].kind;
+	}
+
+	return DRM_ATOMIC_PROP_DRIVER;
+}
+
+/**
+ * drm_atomic_classify_property - find the core state member of a property
+ * @obj: the object the property is attached to
+ * @property: the property
+ *
+ * Called by drm_object_attach_property() to fill out
+ * &drm_object_properties.kinds, so that the atomic property code only has to
+ * compare against all the core properties once per attached property instead
+ * of on every get and set.
+ *
+ * RETURNS:
+ * The &enum drm_atomic_property_kind of @property on @obj, or
+ * DRM_ATOMIC_PROP_DRIVER if the driver's hooks have to handle it.
+ */
+unsigned int drm_atomic_classify_property(struct drm_mode_object *obj,
+					  struct drm_property *property)
+{
+	struct drm_mode_config *config = &property->dev->mode_config;
+	unsigned int kind = DRM_ATOMIC_PROP_DRIVER;
+
+	switch (obj->type) {
+	case DRM_MODE_OBJECT_CRTC:
+		kind = drm_atomic_match_core_property(config, crtc_core_props,
+						      ARRAY_SIZE(crtc_core_props),
+						      property);
+		break;
+	case DRM_MODE_OBJECT_PLANE: {
+		struct drm_plane *plane = obj_to_plane(obj);
+
+		kind = drm_atomic_match_core_property(config, plane_core_props,
+						      ARRAY_SIZE(plane_core_props),
+						      property);
+		if (kind == DRM_ATOMIC_PROP_DRIVER &&
+		    property == plane->rotation_property)
+			kind = DRM_ATOMIC_PROP_ROTATION;
+		else if (kind == DRM_ATOMIC_PROP_DRIVER &&
+			 property == plane->zpos_property)
+			kind = DRM_ATOMIC_PROP_ZPOS;
+		break;
+	}
+	case DRM_MODE_OBJECT_CONNECTOR: {
+		struct drm_connector *connector = obj_to_connector(obj);
+
+		kind = drm_atomic_match_core_property(config, connector_core_props,
+						      ARRAY_SIZE(connector_core_props),
+						      property);
+		if (kind == DRM_ATOMIC_PROP_DRIVER &&
+		    property == connector->scaling_mode_property)
+			kind = DRM_ATOMIC_PROP_SCALING_MODE;
+		break;
+	}
+	}
+
+	return kind;
+}
+
 /**
  * drm_atomic_crtc_set_property - set property on CRTC
  * @crtc: the drm CRTC to set a property on
@@ -463,19 +674,21 @@ int drm_atomic_crtc_set_property(struct drm_crtc *crtc,
 		uint64_t val)
 {
 	struct drm_device *dev = crtc->dev;
-	struct drm_mode_config *config = &dev->mode_config;
 	bool replaced = false;
 	int ret;
 
-	if (property == config->prop_active)
+	switch (drm_mode_object_property_kind(&crtc->base, property)) {
+	case DRM_ATOMIC_PROP_ACTIVE:
 		state->active = val;
-	else if (property == config->prop_mode_id) {
+		break;
+	case DRM_ATOMIC_PROP_MODE_ID: {
 		struct drm_property_blob *mode =
 			drm_property_lookup_blob(dev, val);
 		ret = drm_atomic_set_mode_prop_for_crtc(state, mode);
 		drm_property_blob_put(mode);
 		return ret;
-	} else if (property == config->degamma_lut_property) {
+	}
+	case DRM_ATOMIC_PROP_DEGAMMA_LUT:
 		ret = drm_atomic_replace_property_blob_from_id(dev,
 					&state->degamma_lut,
 					val,
@@ -483,7 +696,7 @@ int drm_atomic_crtc_set_property(struct drm_crtc *crtc,
 					&replaced);
 		state->color_mgmt_changed |= replaced;
 		return ret;
-	} else if (property == config->ctm_property) {
+	case DRM_ATOMIC_PROP_CTM:
 		ret = drm_atomic_replace_property_blob_from_id(dev,
 					&state->ctm,
 					val,
@@ -491,7 +704,7 @@ int drm_atomic_crtc_set_property(struct drm_crtc *crtc,
 					&replaced);
 		state->color_mgmt_changed |= replaced;
 		return ret;
-	} else if (property == config->gamma_lut_property) {
+	case DRM_ATOMIC_PROP_GAMMA_LUT:
 		ret = drm_atomic_replace_property_blob_from_id(dev,
 					&state->gamma_lut,
 					val,
@@ -499,7 +712,7 @@ int drm_atomic_crtc_set_property(struct drm_crtc *crtc,
 					&replaced);
 		state->color_mgmt_changed |= replaced;
 		return ret;
-	} else if (property == config->prop_out_fence_ptr) {
+	case DRM_ATOMIC_PROP_OUT_FENCE_PTR: {
 		s32 __user *fence_ptr = u64_to_user_ptr(val);
 
 		if (!fence_ptr)
@@ -509,10 +722,14 @@ int drm_atomic_crtc_set_property(struct drm_crtc *crtc,
 			return -EFAULT;
 
 		set_out_fence_for_crtc(state->state, crtc, fence_ptr);
-	} else if (crtc->funcs->atomic_set_property)
-		return crtc->funcs->atomic_set_property(crtc, state, property, val);
-	else
+		break;
+	}
+	default:
+		if (crtc->funcs->atomic_set_property)
+			return crtc->funcs->atomic_set_property(crtc, state,
+								property, val);
 		return -EINVAL;
+	}
 
 	return 0;
 }
@@ -538,25 +755,31 @@ drm_atomic_crtc_get_property(struct drm_crtc *crtc,
 		const struct drm_crtc_state *state,
 		struct drm_property *property, uint64_t *val)
 {
-	struct drm_device *dev = crtc->dev;
-	struct drm_mode_config *config = &dev->mode_config;
-
-	if (property == config->prop_active)
+	switch (drm_mode_object_property_kind(&crtc->base, property)) {
+	case DRM_ATOMIC_PROP_ACTIVE:
 		*val = state->active;
-	else if (property == config->prop_mode_id)
+		break;
+	case DRM_ATOMIC_PROP_MODE_ID:
 		*val = (state->mode_blob) ? state->mode_blob->base.id : 0;
-	else if (property == config->degamma_lut_property)
+		break;
+	case DRM_ATOMIC_PROP_DEGAMMA_LUT:
 		*val = (state->degamma_lut) ? state->degamma_lut->base.id : 0;
-	else if (property == config->ctm_property)
+		break;
+	case DRM_ATOMIC_PROP_CTM:
 		*val = (state->ctm) ? state->ctm->base.id : 0;
-	else if (property == config->gamma_lut_property)
+		break;
+	case DRM_ATOMIC_PROP_GAMMA_LUT:
 		*val = (state->gamma_lut) ? state->gamma_lut->base.id : 0;
-	else if (property == config->prop_out_fence_ptr)
+		break;
+	case DRM_ATOMIC_PROP_OUT_FENCE_PTR:
 		*val = 0;
-	else if (crtc->funcs->atomic_get_property)
-		return crtc->funcs->atomic_get_property(crtc, state, property, val);
-	else
+		break;
+	default:
+		if (crtc->funcs->atomic_get_property)
+			return crtc->funcs->atomic_get_property(crtc, state,
+								property, val);
 		return -EINVAL;
+	}
 
 	return 0;
 }
@@ -724,14 +947,16 @@ static int drm_atomic_plane_set_property(struct drm_plane *plane,
 		uint64_t val)
 {
 	struct drm_device *dev = plane->dev;
-	struct drm_mode_config *config = &dev->mode_config;
 
-	if (property == config->prop_fb_id) {
+	switch (drm_mode_object_property_kind(&plane->base, property)) {
+	case DRM_ATOMIC_PROP_FB_ID: {
 		struct drm_framebuffer *fb = drm_framebuffer_lookup(dev, NULL, val);
 		drm_atomic_set_fb_for_plane(state, fb);
 		if (fb)
 			drm_framebuffer_put(fb);
-	} else if (property == config->prop_in_fence_fd) {
+		break;
+	}
+	case DRM_ATOMIC_PROP_IN_FENCE_FD:
 		if (state->fence)
 			return -EINVAL;
 
@@ -741,36 +966,47 @@ static int drm_atomic_plane_set_property(struct drm_plane *plane,
 		state->fence = sync_file_get_fence(val);
 		if (!state->fence)
 			return -EINVAL;
-
-	} else if (property == config->prop_crtc_id) {
+		break;
+	case DRM_ATOMIC_PROP_CRTC_ID: {
 		struct drm_crtc *crtc = drm_crtc_find(dev, NULL, val);
 		return drm_atomic_set_crtc_for_plane(state, crtc);
-	} else if (property == config->prop_crtc_x) {
+	}
+	case DRM_ATOMIC_PROP_CRTC_X:
 		state->crtc_x = U642I64(val);
-	} else if (property == config->prop_crtc_y) {
+		break;
+	case DRM_ATOMIC_PROP_CRTC_Y:
 		state->crtc_y = U642I64(val);
-	} else if (property == config->prop_crtc_w) {
+		break;
+	case DRM_ATOMIC_PROP_CRTC_W:
 		state->crtc_w = val;
-	} else if (property == config->prop_crtc_h) {
+		break;
+	case DRM_ATOMIC_PROP_CRTC_H:
 		state->crtc_h = val;
-	} else if (property == config->prop_src_x) {
+		break;
+	case DRM_ATOMIC_PROP_SRC_X:
 		state->src_x = val;
-	} else if (property == config->prop_src_y) {
+		break;
+	case DRM_ATOMIC_PROP_SRC_Y:
 		state->src_y = val;
-	} else if (property == config->prop_src_w) {
+		break;
+	case DRM_ATOMIC_PROP_SRC_W:
 		state->src_w = val;
-	} else if (property == config->prop_src_h) {
+		break;
+	case DRM_ATOMIC_PROP_SRC_H:
 		state->src_h = val;
-	} else if (property == plane->rotation_property) {
+		break;
+	case DRM_ATOMIC_PROP_ROTATION:
 		if (!is_power_of_2(val & DRM_MODE_ROTATE_MASK))
 			return -EINVAL;
 		state->rotation = val;
-	} else if (property == plane->zpos_property) {
+		break;
+	case DRM_ATOMIC_PROP_ZPOS:
 		state->zpos = val;
-	} else if (plane->funcs->atomic_set_property) {
-		return plane->funcs->atomic_set_property(plane, state,
-				property, val);
-	} else {
+		break;
+	default:
+		if (plane->funcs->atomic_set_property)
+			return plane->funcs->atomic_set_property(plane, state,
+					property, val);
 		return -EINVAL;
 	}
 
@@ -797,38 +1033,50 @@ drm_atomic_plane_get_property(struct drm_plane *plane,
 		const struct drm_plane_state *state,
 		struct drm_property *property, uint64_t *val)
 {
-	struct drm_device *dev = plane->dev;
-	struct drm_mode_config *config = &dev->mode_config;
-
-	if (property == config->prop_fb_id) {
+	switch (drm_mode_object_property_kind(&plane->base, property)) {
+	case DRM_ATOMIC_PROP_FB_ID:
 		*val = (state->fb) ? state->fb->base.id : 0;
-	} else if (property == config->prop_in_fence_fd) {
+		break;
+	case DRM_ATOMIC_PROP_IN_FENCE_FD:
 		*val = -1;
-	} else if (property == config->prop_crtc_id) {
+		break;
+	case DRM_ATOMIC_PROP_CRTC_ID:
 		*val = (state->crtc) ? state->crtc->base.id : 0;
-	} else if (property == config->prop_crtc_x) {
+		break;
+	case DRM_ATOMIC_PROP_CRTC_X:
 		*val = I642U64(state->crtc_x);
-	} else if (property == config->prop_crtc_y) {
+		break;
+	case DRM_ATOMIC_PROP_CRTC_Y:
 		*val = I642U64(state->crtc_y);
-	} else if (property == config->prop_crtc_w) {
+		break;
+	case DRM_ATOMIC_PROP_CRTC_W:
 		*val = state->crtc_w;
-	} else if (property == config->prop_crtc_h) {
+		break;
+	case DRM_ATOMIC_PROP_CRTC_H:
 		*val = state->crtc_h;
-	} else if (property == config->prop_src_x) {
+		break;
+	case DRM_ATOMIC_PROP_SRC_X:
 		*val = state->src_x;
-	} else if (property == config->prop_src_y) {
+		break;
+	case DRM_ATOMIC_PROP_SRC_Y:
 		*val = state->src_y;
-	} else if (property == config->prop_src_w) {
+		break;
+	case DRM_ATOMIC_PROP_SRC_W:
 		*val = state->src_w;
-	} else if (property == config->prop_src_h) {
+		break;
+	case DRM_ATOMIC_PROP_SRC_H:
 		*val = state->src_h;
-	} else if (property == plane->rotation_property) {
+		break;
+	case DRM_ATOMIC_PROP_ROTATION:
 		*val = state->rotation;
-	} else if (property == plane->zpos_property) {
+		break;
+	case DRM_ATOMIC_PROP_ZPOS:
 		*val = state->zpos;
-	} else if (plane->funcs->atomic_get_property) {
-		return plane->funcs->atomic_get_property(plane, state, property, val);
-	} else {
+		break;
+	default:
+		if (plane->funcs->atomic_get_property)
+			return plane->funcs->atomic_get_property(plane, state,
+								 property, val);
 		return -EINVAL;
 	}
 
@@ -1179,42 +1427,55 @@ static int drm_atomic_connector_set_property(struct drm_connector *connector,
 		uint64_t val)
 {
 	struct drm_device *dev = connector->dev;
-	struct drm_mode_config *config = &dev->mode_config;
 
-	if (property == config->prop_crtc_id) {
+	switch (drm_mode_object_property_kind(&connector->base, property)) {
+	case DRM_ATOMIC_PROP_CRTC_ID: {
 		struct drm_crtc *crtc = drm_crtc_find(dev, NULL, val);
 		return drm_atomic_set_crtc_for_connector(state, crtc);
-	} else if (property == config->dpms_property) {
+	}
+	case DRM_ATOMIC_PROP_DPMS:
 		/* setting DPMS property requires special handling, which
 		 * is done in legacy setprop path for us.  Disallow (for
 		 * now?) atomic writes to DPMS property:
 		 */
 		return -EINVAL;
-	} else if (property == config->tv_select_subconnector_property) {
+	case DRM_ATOMIC_PROP_TV_SELECT_SUBCONNECTOR:
 		state->tv.subconnector = val;
-	} else if (property == config->tv_left_margin_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_LEFT_MARGIN:
 		state->tv.margins.left = val;
-	} else if (property == config->tv_right_margin_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_RIGHT_MARGIN:
 		state->tv.margins.right = val;
-	} else if (property == config->tv_top_margin_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_TOP_MARGIN:
 		state->tv.margins.top = val;
-	} else if (property == config->tv_bottom_margin_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_BOTTOM_MARGIN:
 		state->tv.margins.bottom = val;
-	} else if (property == config->tv_mode_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_MODE:
 		state->tv.mode = val;
-	} else if (property == config->tv_brightness_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_BRIGHTNESS:
 		state->tv.brightness = val;
-	} else if (property == config->tv_contrast_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_CONTRAST:
 		state->tv.contrast = val;
-	} else if (property == config->tv_flicker_reduction_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_FLICKER_REDUCTION:
 		state->tv.flicker_reduction = val;
-	} else if (property == config->tv_overscan_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_OVERSCAN:
 		state->tv.overscan = val;
-	} else if (property == config->tv_saturation_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_SATURATION:
 		state->tv.saturation = val;
-	} else if (property == config->tv_hue_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_HUE:
 		state->tv.hue = val;
-	} else if (property == config->link_status_property) {
+		break;
+	case DRM_ATOMIC_PROP_LINK_STATUS:
 		/* Never downgrade from GOOD to BAD on userspace's request here,
 		 * only hw issues can do that.
 		 *
@@ -1228,14 +1489,17 @@ static int drm_atomic_connector_set_property(struct drm_connector *connector,
 		 */
 		if (state->link_status != DRM_LINK_STATUS_GOOD)
 			state->link_status = val;
-	} else if (property == config->aspect_ratio_property) {
+		break;
+	case DRM_ATOMIC_PROP_ASPECT_RATIO:
 		state->picture_aspect_ratio = val;
-	} else if (property == connector->scaling_mode_property) {
+		break;
+	case DRM_ATOMIC_PROP_SCALING_MODE:
 		state->scaling_mode = val;
-	} else if (connector->funcs->atomic_set_property) {
-		return connector->funcs->atomic_set_property(connector,
-				state, property, val);
-	} else {
+		break;
+	default:
+		if (connector->funcs->atomic_set_property)
+			return connector->funcs->atomic_set_property(connector,
+					state, property, val);
 		return -EINVAL;
 	}
 
@@ -1274,47 +1538,62 @@ drm_atomic_connector_get_property(struct drm_connector *connector,
 		const struct drm_connector_state *state,
 		struct drm_property *property, uint64_t *val)
 {
-	struct drm_device *dev = connector->dev;
-	struct drm_mode_config *config = &dev->mode_config;
-
-	if (property == config->prop_crtc_id) {
+	switch (drm_mode_object_property_kind(&connector->base, property)) {
+	case DRM_ATOMIC_PROP_CRTC_ID:
 		*val = (state->crtc) ? state->crtc->base.id : 0;
-	} else if (property == config->dpms_property) {
+		break;
+	case DRM_ATOMIC_PROP_DPMS:
 		*val = connector->dpms;
-	} else if (property == config->tv_select_subconnector_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_SELECT_SUBCONNECTOR:
 		*val = state->tv.subconnector;
-	} else if (property == config->tv_left_margin_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_LEFT_MARGIN:
 		*val = state->tv.margins.left;
-	} else if (property == config->tv_right_margin_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_RIGHT_MARGIN:
 		*val = state->tv.margins.right;
-	} else if (property == config->tv_top_margin_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_TOP_MARGIN:
 		*val = state->tv.margins.top;
-	} else if (property == config->tv_bottom_margin_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_BOTTOM_MARGIN:
 		*val = state->tv.margins.bottom;
-	} else if (property == config->tv_mode_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_MODE:
 		*val = state->tv.mode;
-	} else if (property == config->tv_brightness_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_BRIGHTNESS:
 		*val = state->tv.brightness;
-	} else if (property == config->tv_contrast_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_CONTRAST:
 		*val = state->tv.contrast;
-	} else if (property == config->tv_flicker_reduction_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_FLICKER_REDUCTION:
 		*val = state->tv.flicker_reduction;
-	} else if (property == config->tv_overscan_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_OVERSCAN:
 		*val = state->tv.overscan;
-	} else if (property == config->tv_saturation_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_SATURATION:
 		*val = state->tv.saturation;
-	} else if (property == config->tv_hue_property) {
+		break;
+	case DRM_ATOMIC_PROP_TV_HUE:
 		*val = state->tv.hue;
-	} else if (property == config->link_status_property) {
+		break;
+	case DRM_ATOMIC_PROP_LINK_STATUS:
 		*val = state->link_status;
-	} else if (property == config->aspect_ratio_property) {
+		break;
+	case DRM_ATOMIC_PROP_ASPECT_RATIO:
 		*val = state->picture_aspect_ratio;
-	} else if (property == connector->scaling_mode_property) {
+		break;
+	case DRM_ATOMIC_PROP_SCALING_MODE:
 		*val = state->scaling_mode;
-	} else if (connector->funcs->atomic_get_property) {
-		return connector->funcs->atomic_get_property(connector,
-				state, property, val);
-	} else {
+		break;
+	default:
+		if (connector->funcs->atomic_get_property)
+			return connector->funcs->atomic_get_property(connector,
+					state, property, val);
 		return -EINVAL;
 	}
 
@@ -1830,16 +2109,47 @@ static int drm_state_info(struct seq_file *m, void *data)
 	return 0;
 }
 
+static int drm_state_cache_info(struct seq_file *m, void *data)
+{
+	struct drm_info_node *node = (struct drm_info_node *) m->private;
+	struct drm_device *dev = node->minor->dev;
+	struct drm_atomic_state_cache *cache =
+		&dev->mode_config.atomic_state_cache;
+
+	seq_printf(m, "cached states: %u\n", READ_ONCE(cache->count));
+	seq_printf(m, "state allocs: %ld reuses: %ld\n",
+		   atomic_long_read(&cache->allocs),
+		   atomic_long_read(&cache->reuses));
+	seq_printf(m, "object state allocs: %ld reuses: %ld\n",
+		   atomic_long_read(&cache->obj_allocs),
+		   atomic_long_read(&cache->obj_reuses));
+
+	return 0;
+}
+
 /* any use in debugfs files to dump individual planes/crtc/etc? */
 static const struct drm_info_list drm_atomic_debugfs_list[] = {
 	{"state", drm_state_info, 0},
+	{"state_cache", drm_state_cache_info, 0},
 };
 
 int drm_atomic_debugfs_init(struct drm_minor *minor)
 {
-	return drm_debugfs_create_files(drm_atomic_debugfs_list,
+	struct dentry *ent;
+	int ret;
+
+	ret = drm_debugfs_create_files(drm_atomic_debugfs_list,
 			ARRAY_SIZE(drm_atomic_debugfs_list),
 			minor->debugfs_root, minor);
+	if (ret)
+		return ret;
+
+	ent = debugfs_create_file("atomic_replay", S_IWUSR, minor->debugfs_root,
+				  minor, &drm_atomic_replay_fops);
+	if (!ent)
+		return -ENOMEM;
+
+	return 0;
 }
 #endif
 
@@ -3336,6 +3336,28 @@ EXPORT_SYMBOL(drm_atomic_helper_best_encoder);
  * for these functions.
  */
 
+/*
+ * The default state helpers below keep the last released state of each object
+ * around and hand it out again on the next duplication, so that steady state
+ * updates like cursor moves don't allocate. The destroy hooks can run after
+ * the object was cleaned up, which clears &drm_crtc.dev and friends, in which
+ * case the state is simply freed.
+ */
+static void *drm_atomic_helper_reuse_state(struct drm_device *dev,
+					   void *spare, size_t size)
+{
+	struct drm_atomic_state_cache *cache =
+		&dev->mode_config.atomic_state_cache;
+
+	if (spare) {
+		atomic_long_inc(&cache->obj_reuses);
+		return spare;
+	}
+
+	atomic_long_inc(&cache->obj_allocs);
+	return kmalloc(size, GFP_KERNEL);
+}
+
 /**
  * drm_atomic_helper_crtc_reset - default &drm_crtc_funcs.reset hook for CRTCs
  * @crtc: drm CRTC
@@ -3404,7 +3426,9 @@ drm_atomic_helper_crtc_duplicate_state(struct drm_crtc *crtc)
 	if (WARN_ON(!crtc->state))
 		return NULL;
 
-	state = kmalloc(sizeof(*state), GFP_KERNEL);
+	state = drm_atomic_helper_reuse_state(crtc->dev,
+					      xchg(&crtc->spare_state, NULL),
+					      sizeof(*state));
 	if (state)
 		__drm_atomic_helper_crtc_duplicate_state(crtc, state);
 
@@ -3460,6 +3484,8 @@ void drm_atomic_helper_crtc_destroy_state(struct drm_crtc *crtc,
 					  struct drm_crtc_state *state)
 {
 	__drm_atomic_helper_crtc_destroy_state(state);
+	if (crtc->dev)
+		state = xchg(&crtc->spare_state, state);
 	kfree(state);
 }
 EXPORT_SYMBOL(drm_atomic_helper_crtc_destroy_state);
@@ -3522,7 +3548,9 @@ drm_atomic_helper_plane_duplicate_state(struct drm_plane *plane)
 	if (WARN_ON(!plane->state))
 		return NULL;
 
-	state = kmalloc(sizeof(*state), GFP_KERNEL);
+	state = drm_atomic_helper_reuse_state(plane->dev,
+					      xchg(&plane->spare_state, NULL),
+					      sizeof(*state));
 	if (state)
 		__drm_atomic_helper_plane_duplicate_state(plane, state);
 
@@ -3563,6 +3591,8 @@ void drm_atomic_helper_plane_destroy_state(struct drm_plane *plane,
 					   struct drm_plane_state *state)
 {
 	__drm_atomic_helper_plane_destroy_state(state);
+	if (plane->dev)
+		state = xchg(&plane->spare_state, state);
 	kfree(state);
 }
 EXPORT_SYMBOL(drm_atomic_helper_plane_destroy_state);
@@ -3645,7 +3675,9 @@ drm_atomic_helper_connector_duplicate_state(struct drm_connector *connector)
 	if (WARN_ON(!connector->state))
 		return NULL;
 
-	state = kmalloc(sizeof(*state), GFP_KERNEL);
+	state = drm_atomic_helper_reuse_state(connector->dev,
+					      xchg(&connector->spare_state, NULL),
+					      sizeof(*state));
 	if (state)
 		__drm_atomic_helper_connector_duplicate_state(connector, state);
 
@@ -3771,6 +3803,8 @@ void drm_atomic_helper_connector_destroy_state(struct drm_connector *connector,
 					  struct drm_connector_state *state)
 {
 	__drm_atomic_helper_connector_destroy_state(state);
+	if (connector->dev)
+		state = xchg(&connector->spare_state, state);
 	kfree(state);
 }
 EXPORT_SYMBOL(drm_atomic_helper_connector_destroy_state);
@@ -0,0 +1,852 @@
+/*
+ * Copyright © 2018 The FreeBSD Foundation
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a
+ * copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom the
+ * Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+ * THE COPYRIGHT HOLDER(S) OR AUTHOR(S) BE LIABLE FOR ANY CLAIM, DAMAGES OR
+ * OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE,
+ * ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR
+ * OTHER DEALINGS IN THE SOFTWARE.
+ */
+
+#include <drm/drmP.h>
+#include <drm/drm_atomic.h>
+#include <drm/drm_print.h>
+#include <linux/ctype.h>
+#include <linux/debugfs.h>
+#include <linux/kthread.h>
+#include <linux/sizes.h>
+#include <linux/sort.h>
+
+#include "drm_crtc_internal.h"
+#include "drm_internal.h"
+
+#if defined(CONFIG_DEBUG_FS)
+
+/**
+ * DOC: atomic replay
+ *
+ * Writing a trace to the atomic_replay debugfs file of an atomic driver
+ * replays it through the same core paths as the atomic ioctl, and reports
+ * check and commit latency percentiles, modeset lock statistics and atomic
+ * state allocations per commit to the kernel log. Test-only commits measure
+ * the atomic core and the driver's check code without touching the display.
+ *
+ * The trace is line based, with ``#`` starting a comment::
+ *
+ *	fb <width> <height>
+ *		Create an XRGB8888 dumb framebuffer. Framebuffers are
+ *		referred to as fb0, fb1, ... in the order they are created.
+ *	loops <count>
+ *		Replay all commits this many times, 1 by default.
+ *	threads <count>
+ *		Replay from this many threads at once, 1 by default.
+ *	commit [modeset] [test] <object>.<PROPERTY>=<value> ...
+ *		One atomic commit, optionally allowing modesets or only
+ *		checking the state. Objects are crtcN, planeN and
+ *		connectorN, numbered like &drm_crtc.index and friends.
+ *		Values are numbers, fbN, crtcN, or modeN for the preferred
+ *		mode of connectorN.
+ *	run
+ *		Replay everything written before this line. The write()
+ *		containing it blocks until the replay has finished and
+ *		fails with its error code, if any. The buffered trace is
+ *		discarded afterwards, so another trace can be written to the
+ *		same file.
+ *
+ * Closing the file without a ``run`` line discards the trace.
+ *
+ * Since objects and properties are named instead of being given by id, the
+ * same trace can be replayed from userspace through libdrm.
+ */
+
+#define REPLAY_MAX_TRACE_SIZE	SZ_1M
+#define REPLAY_MAX_THREADS	64
+
+struct replay_assign {
+	struct drm_mode_object *obj;
+	struct drm_property *prop;
+	uint64_t value;
+};
+
+struct replay_commit {
+	bool allow_modeset;
+	bool test_only;
+	unsigned int num_assigns;
+	struct replay_assign *assigns;
+};
+
+struct drm_atomic_replay {
+	struct drm_device *dev;
+	struct drm_file *file;
+
+	unsigned int loops;
+	unsigned int threads;
+
+	unsigned int num_commits;
+	struct replay_commit *commits;
+
+	unsigned int num_fbs;
+	u32 *fb_ids;
+
+	unsigned int num_connectors;
+	struct drm_connector **connectors;
+	struct drm_property_blob **modes;
+};
+
+struct replay_thread {
+	struct drm_atomic_replay *replay;
+	struct task_struct *tsk;
+
+	unsigned int num_checks, num_commits;
+	u64 *check_ns;
+	u64 *commit_ns;
+	unsigned long failed;
+	struct drm_modeset_lock_stats stats;
+};
+
+struct replay_buffer {
+	struct drm_minor *minor;
+	char *data;
+	size_t len;
+	size_t scanned;
+};
+
+static struct drm_file *replay_file_open(struct drm_minor *minor)
+{
+	struct drm_file *file;
+
+	file = drm_file_alloc(minor);
+	if (IS_ERR(file))
+		return file;
+
+	file->authenticated = true;
+	file->universal_planes = true;
+	file->atomic = true;
+
+	return file;
+}
+
+static char *replay_next_token(char **s)
+{
+	char *tok;
+
+	do {
+		tok = strsep(s, " \t\r");
+	} while (tok && !*tok);
+
+	return tok;
+}
+
+static int replay_parse_index(const char *name, const char *prefix,
+			      unsigned int *index)
+{
+	size_t len = strlen(prefix);
+
+	if (strncmp(name, prefix, len))
+		return -ENOENT;
+
+	return kstrtouint(name + len, 10, index);
+}
+
+static struct drm_connector *
+replay_connector(struct drm_atomic_replay *replay, unsigned int index)
+{
+	struct drm_connector_list_iter conn_iter;
+	struct drm_connector *connector;
+
+	if (index >= replay->num_connectors)
+		return NULL;
+
+	if (replay->connectors[index])
+		return replay->connectors[index];
+
+	drm_connector_list_iter_begin(replay->dev, &conn_iter);
+	drm_for_each_connector_iter(connector, &conn_iter) {
+		if (connector->index == index) {
+			drm_connector_get(connector);
+			replay->connectors[index] = connector;
+			break;
+		}
+	}
+	drm_connector_list_iter_end(&conn_iter);
+
+	return replay->connectors[index];
+}
+
+static struct drm_property_blob *
+replay_mode(struct drm_atomic_replay *replay, unsigned int index)
+{
+	struct drm_device *dev = replay->dev;
+	struct drm_display_mode *mode, *found = NULL;
+	struct drm_connector *connector;
+	struct drm_mode_modeinfo umode;
+	struct drm_property_blob *blob;
+
+	connector = replay_connector(replay, index);
+	if (!connector)
+		return NULL;
+
+	if (replay->modes[index])
+		return replay->modes[index];
+
+	mutex_lock(&dev->mode_config.mutex);
+	connector->funcs->fill_modes(connector,
+				     dev->mode_config.max_width,
+				     dev->mode_config.max_height);
+	list_for_each_entry(mode, &connector->modes, head) {
+		if (!found || mode->type & DRM_MODE_TYPE_PREFERRED)
+			found = mode;
+		if (mode->type & DRM_MODE_TYPE_PREFERRED)
+			break;
+	}
+	if (found)
+		drm_mode_convert_to_umode(&umode, found);
+	mutex_unlock(&dev->mode_config.mutex);
+
+	if (!found)
+		return NULL;
+
+	blob = drm_property_create_blob(dev, sizeof(umode), &umode);
+	if (IS_ERR(blob))
+		return NULL;
+
+	replay->modes[index] = blob;
+	return blob;
+}
+
+static struct drm_mode_object *
+replay_lookup_object(struct drm_atomic_replay *replay, const char *name)
+{
+	struct drm_connector *connector;
+	struct drm_plane *plane;
+	struct drm_crtc *crtc;
+	unsigned int index;
+
+	if (!replay_parse_index(name, "crtc", &index)) {
+		crtc = drm_crtc_from_index(replay->dev, index);
+		return crtc ? &crtc->base : NULL;
+	}
+
+	if (!replay_parse_index(name, "plane", &index)) {
+		plane = drm_plane_from_index(replay->dev, index);
+		return plane ? &plane->base : NULL;
+	}
+
+	if (!replay_parse_index(name, "connector", &index)) {
+		connector = replay_connector(replay, index);
+		return connector ? &connector->base : NULL;
+	}
+
+	return NULL;
+}
+
+static struct drm_property *
+replay_lookup_property(struct drm_mode_object *obj, const char *name)
+{
+	int i;
+
+	for (i = 0; i < obj->properties->count; i++)
+		if (!strcmp(obj->properties->properties[i]->name, name))
+			return obj->properties->properties[i];
+
+	return NULL;
+}
+
+static int replay_parse_value(struct drm_atomic_replay *replay,
+			      const char *s, uint64_t *value)
+{
+	struct drm_property_blob *blob;
+	struct drm_crtc *crtc;
+	unsigned int index;
+	s64 svalue;
+	int ret;
+
+	if (!replay_parse_index(s, "fb", &index)) {
+		if (index >= replay->num_fbs)
+			return -ENOENT;
+		*value = replay->fb_ids[index];
+		return 0;
+	}
+
+	if (!replay_parse_index(s, "crtc", &index)) {
+		crtc = drm_crtc_from_index(replay->dev, index);
+		if (!crtc)
+			return -ENOENT;
+		*value = crtc->base.id;
+		return 0;
+	}
+
+	if (!replay_parse_index(s, "mode", &index)) {
+		blob = replay_mode(replay, index);
+		if (!blob)
+			return -ENOENT;
+		*value = blob->base.id;
+		return 0;
+	}
+
+	if (*s != '-')
+		return kstrtoull(s, 0, value);
+
+	ret = kstrtoll(s, 0, &svalue);
+	if (ret)
+		return ret;
+
+	*value = I642U64(svalue);
+	return 0;
+}
+
+static int replay_add_fb(struct drm_atomic_replay *replay, char *args)
+{
+	struct drm_device *dev = replay->dev;
+	struct drm_mode_create_dumb dumb = {};
+	struct drm_mode_fb_cmd2 cmd = {};
+	struct drm_framebuffer *fb;
+	unsigned int width, height;
+	u32 *fb_ids;
+	int ret;
+
+	if (sscanf(args, "%u %u", &width, &height) != 2)
+		return -EINVAL;
+
+	if (!dev->driver->dumb_create)
+		return -ENOSYS;
+
+	fb_ids = krealloc(replay->fb_ids,
+			  (replay->num_fbs + 1) * sizeof(*fb_ids), GFP_KERNEL);
+	if (!fb_ids)
+		return -ENOMEM;
+	replay->fb_ids = fb_ids;
+
+	dumb.width = width;
+	dumb.height = height;
+	dumb.bpp = 32;
+	ret = dev->driver->dumb_create(replay->file, dev, &dumb);
+	if (ret)
+		return ret;
+
+	cmd.width = width;
+	cmd.height = height;
+	cmd.pixel_format = DRM_FORMAT_XRGB8888;
+	cmd.handles[0] = dumb.handle;
+	cmd.pitches[0] = dumb.pitch;
+
+	fb = drm_internal_framebuffer_create(dev, &cmd, replay->file);
+	if (IS_ERR(fb))
+		return PTR_ERR(fb);
+
+	mutex_lock(&replay->file->fbs_lock);
+	list_add(&fb->filp_head, &replay->file->fbs);
+	mutex_unlock(&replay->file->fbs_lock);
+
+	replay->fb_ids[replay->num_fbs++] = fb->base.id;
+
+	return 0;
+}
+
+static int replay_add_commit(struct drm_atomic_replay *replay, char *args)
+{
+	struct replay_commit *commit, *commits;
+	struct replay_assign *assign;
+	char *tok, *s, *name, *prop;
+	unsigned int count = 0;
+	int ret;
+
+	/* Count the assignments first so they fit one allocation */
+	for (s = args; *s; s++)
+		count += *s == '=';
+
+	commits = krealloc(replay->commits,
+			   (replay->num_commits + 1) * sizeof(*commits),
+			   GFP_KERNEL);
+	if (!commits)
+		return -ENOMEM;
+	replay->commits = commits;
+
+	commit = &replay->commits[replay->num_commits];
+	memset(commit, 0, sizeof(*commit));
+	commit->assigns = kcalloc(count, sizeof(*commit->assigns), GFP_KERNEL);
+	if (count && !commit->assigns)
+		return -ENOMEM;
+	/* Account it right away so that it is freed on errors */
+	replay->num_commits++;
+
+	while ((tok = replay_next_token(&args))) {
+		if (!strcmp(tok, "modeset")) {
+			commit->allow_modeset = true;
+			continue;
+		}
+
+		if (!strcmp(tok, "test")) {
+			commit->test_only = true;
+			continue;
+		}
+
+		name = strsep(&tok, ".");
+		prop = strsep(&tok, "=");
+		if (!prop || !tok)
+			return -EINVAL;
+
+		assign = &commit->assigns[commit->num_assigns];
+
+		assign->obj = replay_lookup_object(replay, name);
+		if (!assign->obj) {
+			DRM_DEBUG_ATOMIC("atomic replay: no object %s\n", name);
+			return -ENOENT;
+		}
+
+		assign->prop = replay_lookup_property(assign->obj, prop);
+		if (!assign->prop) {
+			DRM_DEBUG_ATOMIC("atomic replay: %s has no property %s\n",
+					 name, prop);
+			return -ENOENT;
+		}
+
+		ret = replay_parse_value(replay, tok, &assign->value);
+		if (ret) {
+			DRM_DEBUG_ATOMIC("atomic replay: bad value %s\n", tok);
+			return ret;
+		}
+
+		commit->num_assigns++;
+	}
+
+	return 0;
+}
+
+static int replay_parse(struct drm_atomic_replay *replay, char *trace)
+{
+	unsigned int lineno = 0;
+	char *line, *cmd;
+	int ret;
+
+	while ((line = strsep(&trace, "\n"))) {
+		lineno++;
+
+		cmd = replay_next_token(&line);
+		if (!cmd || *cmd == '#')
+			continue;
+
+		if (!strcmp(cmd, "fb"))
+			ret = replay_add_fb(replay, line ?: "");
+		else if (!strcmp(cmd, "commit"))
+			ret = replay_add_commit(replay, line ?: "");
+		else if (!strcmp(cmd, "loops"))
+			ret = kstrtouint(replay_next_token(&line) ?: "",
+					 0, &replay->loops);
+		else if (!strcmp(cmd, "threads"))
+			ret = kstrtouint(replay_next_token(&line) ?: "",
+					 0, &replay->threads);
+		else
+			ret = -EINVAL;
+
+		if (ret) {
+			DRM_ERROR("atomic replay: error %d on line %u\n",
+				  ret, lineno);
+			return ret;
+		}
+	}
+
+	if (!replay->loops || !replay->threads ||
+	    replay->threads > REPLAY_MAX_THREADS)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int replay_commit(struct replay_thread *thread,
+			 const struct replay_commit *commit)
+{
+	struct drm_device *dev = thread->replay->dev;
+	struct drm_modeset_acquire_ctx ctx;
+	struct drm_atomic_state *state;
+	struct drm_plane *plane;
+	unsigned int plane_mask;
+	ktime_t start;
+	u64 check_ns = 0;
+	unsigned int i;
+	int ret;
+
+	drm_modeset_acquire_init(&ctx, 0);
+	ctx.stats = &thread->stats;
+
+	state = drm_atomic_state_alloc(dev);
+	if (!state) {
+		ret = -ENOMEM;
+		goto out_ctx;
+	}
+
+	state->acquire_ctx = &ctx;
+	state->allow_modeset = commit->allow_modeset;
+
+retry:
+	plane_mask = 0;
+
+	/* Same sequence as drm_mode_atomic_ioctl() */
+	for (i = 0; i < commit->num_assigns; i++) {
+		const struct replay_assign *assign = &commit->assigns[i];
+
+		ret = drm_atomic_set_property(state, assign->obj,
+					      assign->prop, assign->value);
+		if (ret)
+			goto out;
+
+		if (assign->obj->type == DRM_MODE_OBJECT_PLANE &&
+		    !commit->test_only) {
+			plane = obj_to_plane(assign->obj);
+			if (!(plane_mask & BIT(drm_plane_index(plane)))) {
+				plane_mask |= BIT(drm_plane_index(plane));
+				plane->old_fb = plane->fb;
+			}
+		}
+	}
+
+	start = ktime_get();
+	ret = drm_atomic_check_only(state);
+	check_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	if (ret || commit->test_only)
+		goto out;
+
+	/* drm_atomic_commit() minus the check we already did */
+	start = ktime_get();
+	ret = dev->mode_config.funcs->atomic_commit(dev, state, false);
+	if (!ret)
+		thread->commit_ns[thread->num_commits++] =
+			ktime_to_ns(ktime_sub(ktime_get(), start));
+
+out:
+	drm_atomic_clean_old_fb(dev, plane_mask, ret);
+
+	if (ret == -EDEADLK) {
+		drm_atomic_state_clear(state);
+		drm_modeset_backoff(&ctx);
+		goto retry;
+	}
+
+	if (!ret)
+		thread->check_ns[thread->num_checks++] = check_ns;
+
+	drm_atomic_state_put(state);
+	drm_modeset_drop_locks(&ctx);
+out_ctx:
+	drm_modeset_acquire_fini(&ctx);
+
+	return ret;
+}
+
+static void replay_run_thread(struct replay_thread *thread)
+{
+	struct drm_atomic_replay *replay = thread->replay;
+	unsigned int loop, i;
+
+	for (loop = 0; loop < replay->loops; loop++) {
+		for (i = 0; i < replay->num_commits; i++) {
+			if (replay_commit(thread, &replay->commits[i]))
+				thread->failed++;
+			cond_resched();
+		}
+	}
+}
+
+static int replay_thread_fn(void *arg)
+{
+	replay_run_thread(arg);
+
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(1);
+
+	return 0;
+}
+
+static int replay_cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void replay_print_latency(struct drm_printer *p, const char *name,
+				 u64 *samples, unsigned int count)
+{
+	if (!count) {
+		drm_printf(p, "%s: no samples\n", name);
+		return;
+	}
+
+	sort(samples, count, sizeof(*samples), replay_cmp_u64, NULL);
+
+	drm_printf(p, "%s: p50 %llu p90 %llu p99 %llu max %llu ns\n", name,
+		   samples[(count - 1) * 50 / 100],
+		   samples[(count - 1) * 90 / 100],
+		   samples[(count - 1) * 99 / 100],
+		   samples[count - 1]);
+}
+
+static void replay_report(struct drm_atomic_replay *replay,
+			  struct replay_thread *threads, long allocs,
+			  struct drm_printer *p)
+{
+	unsigned int per_thread = replay->loops * replay->num_commits;
+	unsigned int total = per_thread * replay->threads;
+	struct drm_modeset_lock_stats stats = {};
+	unsigned int checks = 0, commits = 0;
+	unsigned long failed = 0;
+	u64 *check_ns, *commit_ns;
+	unsigned int i;
+
+	/* Pack the samples of all threads at the start of the first buffer */
+	check_ns = threads[0].check_ns;
+	commit_ns = threads[0].commit_ns;
+	for (i = 0; i < replay->threads; i++) {
+		memmove(check_ns + checks, threads[i].check_ns,
+			threads[i].num_checks * sizeof(*check_ns));
+		memmove(commit_ns + commits, threads[i].commit_ns,
+			threads[i].num_commits * sizeof(*commit_ns));
+		checks += threads[i].num_checks;
+		commits += threads[i].num_commits;
+		failed += threads[i].failed;
+
+		stats.locks += threads[i].stats.locks;
+		stats.deadlocks += threads[i].stats.deadlocks;
+		stats.backoffs += threads[i].stats.backoffs;
+		stats.wait_ns += threads[i].stats.wait_ns;
+	}
+
+	drm_printf(p, "atomic replay: %u commits x %u loops x %u threads, %lu failed\n",
+		   replay->num_commits, replay->loops, replay->threads, failed);
+	replay_print_latency(p, "check", check_ns, checks);
+	replay_print_latency(p, "commit", commit_ns, commits);
+	drm_printf(p, "locks: %lu taken, %lu deadlocks, %lu backoffs, %llu ns waiting per commit\n",
+		   stats.locks, stats.deadlocks, stats.backoffs,
+		   div_u64(stats.wait_ns, total));
+	drm_printf(p, "state allocations: %ld, %ld.%02ld per commit\n",
+		   allocs, allocs / total, (allocs * 100 / total) % 100);
+}
+
+static long replay_allocs(struct drm_device *dev)
+{
+	struct drm_atomic_state_cache *cache =
+		&dev->mode_config.atomic_state_cache;
+
+	return atomic_long_read(&cache->allocs) +
+	       atomic_long_read(&cache->obj_allocs);
+}
+
+static int replay_run(struct drm_atomic_replay *replay)
+{
+	unsigned int per_thread = replay->loops * replay->num_commits;
+	struct drm_printer p = drm_info_printer(replay->dev->dev);
+	struct replay_thread *threads;
+	unsigned int i;
+	long allocs;
+	int ret = 0;
+
+	if (!per_thread)
+		return 0;
+
+	threads = kcalloc(replay->threads, sizeof(*threads), GFP_KERNEL);
+	if (!threads)
+		return -ENOMEM;
+
+	for (i = 0; i < replay->threads; i++) {
+		threads[i].replay = replay;
+		threads[i].check_ns = kvmalloc_array(per_thread,
+						     sizeof(u64), GFP_KERNEL);
+		threads[i].commit_ns = kvmalloc_array(per_thread,
+						      sizeof(u64), GFP_KERNEL);
+		if (!threads[i].check_ns || !threads[i].commit_ns) {
+			ret = -ENOMEM;
+			goto out;
+		}
+	}
+
+	allocs = replay_allocs(replay->dev);
+
+	if (replay->threads == 1) {
+		replay_run_thread(&threads[0]);
+	} else {
+		for (i = 0; i < replay->threads; i++) {
+			threads[i].tsk = kthread_run(replay_thread_fn,
+						     &threads[i],
+						     "drm_replay/%u", i);
+			if (IS_ERR(threads[i].tsk)) {
+				ret = PTR_ERR(threads[i].tsk);
+				threads[i].tsk = NULL;
+				break;
+			}
+		}
+
+		for (i = 0; i < replay->threads; i++)
+			if (threads[i].tsk)
+				kthread_stop(threads[i].tsk);
+		if (ret)
+			goto out;
+	}
+
+	replay_report(replay, threads, replay_allocs(replay->dev) - allocs, &p);
+
+out:
+	for (i = 0; i < replay->threads; i++) {
+		kvfree(threads[i].check_ns);
+		kvfree(threads[i].commit_ns);
+	}
+	kfree(threads);
+	return ret;
+}
+
+static void replay_fini(struct drm_atomic_replay *replay)
+{
+	unsigned int i;
+
+	for (i = 0; i < replay->num_commits; i++)
+		kfree(replay->commits[i].assigns);
+	kfree(replay->commits);
+	kfree(replay->fb_ids);
+
+	for (i = 0; i < replay->num_connectors; i++) {
+		drm_property_blob_put(replay->modes[i]);
+		if (replay->connectors[i])
+			drm_connector_put(replay->connectors[i]);
+	}
+	kfree(replay->modes);
+	kfree(replay->connectors);
+
+	drm_file_free(replay->file);
+}
+
+static int drm_atomic_replay(struct drm_minor *minor, char *trace)
+{
+	struct drm_atomic_replay replay = {
+		.dev = minor->dev,
+		.loops = 1,
+		.threads = 1,
+	};
+	int ret;
+
+	replay.num_connectors = minor->dev->mode_config.num_connector;
+	replay.connectors = kcalloc(replay.num_connectors,
+				    sizeof(*replay.connectors), GFP_KERNEL);
+	replay.modes = kcalloc(replay.num_connectors,
+			       sizeof(*replay.modes), GFP_KERNEL);
+	if (replay.num_connectors && (!replay.connectors || !replay.modes)) {
+		ret = -ENOMEM;
+		goto out;
+	}
+
+	replay.file = replay_file_open(minor);
+	if (IS_ERR(replay.file)) {
+		ret = PTR_ERR(replay.file);
+		replay.file = NULL;
+		goto out;
+	}
+
+	ret = replay_parse(&replay, trace);
+	if (ret)
+		goto out;
+
+	ret = replay_run(&replay);
+out:
+	replay_fini(&replay);
+	return ret;
+}
+
+static int drm_atomic_replay_open(struct inode *inode, struct file *file)
+{
+	struct replay_buffer *buf;
+
+	buf = kzalloc(sizeof(*buf), GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
+
+	buf->minor = inode->i_private;
+	file->private_data = buf;
+
+	return nonseekable_open(inode, file);
+}
+
+static bool replay_is_run(const char *line, size_t len)
+{
+	while (len && isspace(line[len - 1]))
+		len--;
+	while (len && isspace(*line)) {
+		line++;
+		len--;
+	}
+
+	return len == 3 && !strncmp(line, "run", 3);
+}
+
+static ssize_t drm_atomic_replay_write(struct file *file,
+				       const char __user *ubuf,
+				       size_t len, loff_t *offp)
+{
+	struct replay_buffer *buf = file->private_data;
+	char *data, *eol;
+	int ret = 0;
+
+	if (buf->len + len >= REPLAY_MAX_TRACE_SIZE)
+		return -EFBIG;
+
+	data = krealloc(buf->data, buf->len + len + 1, GFP_KERNEL);
+	if (!data)
+		return -ENOMEM;
+	buf->data = data;
+
+	if (copy_from_user(buf->data + buf->len, ubuf, len))
+		return -EFAULT;
+
+	buf->len += len;
+	buf->data[buf->len] = '\0';
+
+	/* Only look at complete lines, "run" may be split across writes. */
+	while ((eol = strchr(buf->data + buf->scanned, '\n'))) {
+		char *line = buf->data + buf->scanned;
+
+		buf->scanned = eol - buf->data + 1;
+		if (!replay_is_run(line, eol - line))
+			continue;
+
+		*line = '\0';
+		ret = drm_atomic_replay(buf->minor, buf->data);
+
+		/* Keep whatever follows "run" as the start of the next trace. */
+		buf->len -= buf->scanned;
+		memmove(buf->data, buf->data + buf->scanned, buf->len + 1);
+		buf->scanned = 0;
+		if (ret)
+			break;
+	}
+
+	return ret ?: len;
+}
+
+static int drm_atomic_replay_release(struct inode *inode, struct file *file)
+{
+	struct replay_buffer *buf = file->private_data;
+
+	kfree(buf->data);
+	kfree(buf);
+
+	return 0;
+}
+
+const struct file_operations drm_atomic_replay_fops = {
+	.owner = THIS_MODULE,
+	.open = drm_atomic_replay_open,
+	.write = drm_atomic_replay_write,
+	.release = drm_atomic_replay_release,
+	.llseek = no_llseek,
+};
+
+#endif /* CONFIG_DEBUG_FS */
@@ -161,13 +161,12 @@ int drm_plane_create_rotation_property(struct drm_plane *plane,
 	if (!prop)
 		return -ENOMEM;
 
+	plane->rotation_property = prop;
 	drm_object_attach_property(&plane->base, prop, rotation);
 
 	if (plane->state)
 		plane->state->rotation = rotation;
 
-	plane->rotation_property = prop;
-
 	return 0;
 }
 EXPORT_SYMBOL(drm_plane_create_rotation_property);
@@ -244,9 +243,8 @@ int drm_plane_create_zpos_property(struct drm_plane *plane,
 	if (!prop)
 		return -ENOMEM;
 
-	drm_object_attach_property(&plane->base, prop, zpos);
-
 	plane->zpos_property = prop;
+	drm_object_attach_property(&plane->base, prop, zpos);
 
 	if (plane->state) {
 		plane->state->zpos = zpos;
@@ -283,9 +281,8 @@ int drm_plane_create_zpos_immutable_property(struct drm_plane *plane,
 	if (!prop)
 		return -ENOMEM;
 
-	drm_object_attach_property(&plane->base, prop, zpos);
-
 	plane->zpos_property = prop;
+	drm_object_attach_property(&plane->base, prop, zpos);
 
 	if (plane->state) {
 		plane->state->zpos = zpos;
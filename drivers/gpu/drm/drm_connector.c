@@ -230,6 +230,8 @@ int drm_connector_init(struct drm_device *dev,
 	INIT_LIST_HEAD(&connector->probed_modes);
 	INIT_LIST_HEAD(&connector->modes);
 	mutex_init(&connector->mutex);
+	mutex_init(&connector->detect_mutex);
+	drm_edid_cache_init(connector);
 	connector->edid_blob_ptr = NULL;
 	connector->status = connector_status_unknown;
 	connector->display_info.panel_orientation =
@@ -362,6 +364,7 @@ void drm_connector_cleanup(struct drm_connector *connector)
 			  connector->index);
 
 	kfree(connector->display_info.bus_formats);
+	drm_edid_cache_fini(connector);
 	drm_mode_object_unregister(dev, &connector->base);
 	kfree(connector->name);
 	connector->name = NULL;
@@ -374,7 +377,9 @@ void drm_connector_cleanup(struct drm_connector *connector)
 	if (connector->state && connector->funcs->atomic_destroy_state)
 		connector->funcs->atomic_destroy_state(connector,
 						       connector->state);
+	kfree(xchg(&connector->spare_state, NULL));
 
+	mutex_destroy(&connector->detect_mutex);
 	mutex_destroy(&connector->mutex);
 
 	memset(connector, 0, sizeof(*connector));
@@ -1116,11 +1121,10 @@ int drm_connector_attach_scaling_mode_property(struct drm_connector *connector,
 		}
 	}
 
+	connector->scaling_mode_property = scaling_mode_property;
 	drm_object_attach_property(&connector->base,
 				   scaling_mode_property, 0);
 
-	connector->scaling_mode_property = scaling_mode_property;
-
 	return 0;
 }
 EXPORT_SYMBOL(drm_connector_attach_scaling_mode_property);
@@ -69,6 +69,9 @@ static inline void drm_dp_aux_unregister_devnode(struct drm_dp_aux *aux)
 #endif
 
 /* drm_probe_helper.c */
+extern struct workqueue_struct *drm_kms_helper_detect_wq;
+int drm_kms_helper_poll_init_wq(void);
+void drm_kms_helper_poll_fini_wq(void);
 enum drm_mode_status drm_crtc_mode_valid(struct drm_crtc *crtc,
 					 const struct drm_display_mode *mode);
 enum drm_mode_status drm_encoder_mode_valid(struct drm_encoder *encoder,
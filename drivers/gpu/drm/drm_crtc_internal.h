@@ -116,6 +116,8 @@ int drm_mode_object_get_properties(struct drm_mode_object *obj, bool atomic,
 				   uint32_t *arg_count_props);
 struct drm_property *drm_mode_obj_find_prop_id(struct drm_mode_object *obj,
 					       uint32_t prop_id);
+unsigned int drm_mode_object_property_kind(struct drm_mode_object *obj,
+					   struct drm_property *property);
 
 /* IOCTL */
 
@@ -178,8 +180,59 @@ int drm_mode_dirtyfb_ioctl(struct drm_device *dev,
 #ifdef CONFIG_DEBUG_FS
 struct drm_minor;
 int drm_atomic_debugfs_init(struct drm_minor *minor);
+
+/* drm_atomic_replay.c */
+extern const struct file_operations drm_atomic_replay_fops;
 #endif
 
+/* Core state members a property decodes to, see &drm_object_properties.kinds */
+enum drm_atomic_property_kind {
+	DRM_ATOMIC_PROP_DRIVER = 0,
+	/* crtc */
+	DRM_ATOMIC_PROP_ACTIVE,
+	DRM_ATOMIC_PROP_MODE_ID,
+	DRM_ATOMIC_PROP_DEGAMMA_LUT,
+	DRM_ATOMIC_PROP_CTM,
+	DRM_ATOMIC_PROP_GAMMA_LUT,
+	DRM_ATOMIC_PROP_OUT_FENCE_PTR,
+	/* plane */
+	DRM_ATOMIC_PROP_FB_ID,
+	DRM_ATOMIC_PROP_IN_FENCE_FD,
+	DRM_ATOMIC_PROP_CRTC_X,
+	DRM_ATOMIC_PROP_CRTC_Y,
+	DRM_ATOMIC_PROP_CRTC_W,
+	DRM_ATOMIC_PROP_CRTC_H,
+	DRM_ATOMIC_PROP_SRC_X,
+	DRM_ATOMIC_PROP_SRC_Y,
+	DRM_ATOMIC_PROP_SRC_W,
+	DRM_ATOMIC_PROP_SRC_H,
+	DRM_ATOMIC_PROP_ROTATION,
+	DRM_ATOMIC_PROP_ZPOS,
+	/* plane and connector */
+	DRM_ATOMIC_PROP_CRTC_ID,
+	/* connector */
+	DRM_ATOMIC_PROP_DPMS,
+	DRM_ATOMIC_PROP_TV_SELECT_SUBCONNECTOR,
+	DRM_ATOMIC_PROP_TV_LEFT_MARGIN,
+	DRM_ATOMIC_PROP_TV_RIGHT_MARGIN,
+	DRM_ATOMIC_PROP_TV_TOP_MARGIN,
+	DRM_ATOMIC_PROP_TV_BOTTOM_MARGIN,
+	DRM_ATOMIC_PROP_TV_MODE,
+	DRM_ATOMIC_PROP_TV_BRIGHTNESS,
+	DRM_ATOMIC_PROP_TV_CONTRAST,
+	DRM_ATOMIC_PROP_TV_FLICKER_REDUCTION,
+	DRM_ATOMIC_PROP_TV_OVERSCAN,
+	DRM_ATOMIC_PROP_TV_SATURATION,
+	DRM_ATOMIC_PROP_TV_HUE,
+	DRM_ATOMIC_PROP_LINK_STATUS,
+	DRM_ATOMIC_PROP_ASPECT_RATIO,
+	DRM_ATOMIC_PROP_SCALING_MODE,
+};
+
+unsigned int drm_atomic_classify_property(struct drm_mode_object *obj,
+					  struct drm_property *property);
+
+void drm_atomic_state_cache_fini(struct drm_device *dev);
 int drm_atomic_connector_commit_dpms(struct drm_atomic_state *state,
 				     struct drm_connector *connector,
 				     int mode);
@@ -218,3 +271,6 @@ int drm_mode_page_flip_ioctl(struct drm_device *dev,
 
 /* drm_edid.c */
 void drm_mode_fixup_1366x768(struct drm_display_mode *mode);
+void drm_edid_cache_init(struct drm_connector *connector);
+void drm_edid_cache_fini(struct drm_connector *connector);
+void drm_edid_vic_index_init(void);
@@ -286,6 +286,31 @@ static ssize_t connector_write(struct file *file, const char __user *ubuf,
 	return len;
 }
 
+static int detect_latency_show(struct seq_file *m, void *data)
+{
+	struct drm_connector *connector = m->private;
+
+	seq_printf(m, "last: %llu ns\n", READ_ONCE(connector->detect_ns));
+	seq_printf(m, "max: %llu ns\n", READ_ONCE(connector->detect_max_ns));
+
+	return 0;
+}
+
+static int detect_latency_open(struct inode *inode, struct file *file)
+{
+	struct drm_connector *dev = inode->i_private;
+
+	return single_open(file, detect_latency_show, dev);
+}
+
+static const struct file_operations drm_detect_latency_fops = {
+	.owner = THIS_MODULE,
+	.open = detect_latency_open,
+	.read = seq_read,
+	.llseek = seq_lseek,
+	.release = single_release,
+};
+
 static int edid_show(struct seq_file *m, void *data)
 {
 	struct drm_connector *connector = m->private;
@@ -382,6 +407,12 @@ int drm_debugfs_connector_add(struct drm_connector *connector)
 	if (!ent)
 		goto error;
 
+	/* detect latency */
+	ent = debugfs_create_file("detect_latency", S_IRUGO, root, connector,
+				  &drm_detect_latency_fops);
+	if (!ent)
+		goto error;
+
 	return 0;
 
 error:
@@ -24,6 +24,7 @@
 #include <linux/delay.h>
 #include <linux/init.h>
 #include <linux/errno.h>
+#include <linux/moduleparam.h>
 #include <linux/sched.h>
 #include <linux/seq_file.h>
 #include <linux/i2c.h>
@@ -41,6 +42,12 @@
  * protocol. The helpers contain a topology manager and bandwidth manager.
  * The helpers encapsulate the sending and received of sideband msgs.
  */
+
+static bool drm_dp_mst_pipeline __read_mostly;
+module_param_named(dp_mst_pipeline, drm_dp_mst_pipeline, bool, 0644);
+MODULE_PARM_DESC(dp_mst_pipeline,
+		 "Keep several sideband requests in flight, up to two per branch device (default: false)");
+
 static bool dump_dp_payload_table(struct drm_dp_mst_topology_mgr *mgr,
 				  char *buf);
 static int test_calc_pbn_mode(void);
@@ -55,11 +62,20 @@ static int drm_dp_send_dpcd_write(struct drm_dp_mst_topology_mgr *mgr,
 				  struct drm_dp_mst_port *port,
 				  int offset, int size, u8 *bytes);
 
-static void drm_dp_send_link_address(struct drm_dp_mst_topology_mgr *mgr,
-				     struct drm_dp_mst_branch *mstb);
-static int drm_dp_send_enum_path_resources(struct drm_dp_mst_topology_mgr *mgr,
-					   struct drm_dp_mst_branch *mstb,
-					   struct drm_dp_mst_port *port);
+static struct drm_dp_sideband_msg_tx *
+drm_dp_queue_link_address(struct drm_dp_mst_topology_mgr *mgr,
+			  struct drm_dp_mst_branch *mstb);
+static void drm_dp_complete_link_address(struct drm_dp_mst_topology_mgr *mgr,
+					 struct drm_dp_mst_branch *mstb,
+					 struct drm_dp_sideband_msg_tx *txmsg);
+static struct drm_dp_sideband_msg_tx *
+drm_dp_queue_enum_path_resources(struct drm_dp_mst_topology_mgr *mgr,
+				 struct drm_dp_mst_branch *mstb,
+				 struct drm_dp_mst_port *port);
+static void drm_dp_complete_enum_path_resources(struct drm_dp_mst_topology_mgr *mgr,
+						struct drm_dp_mst_branch *mstb,
+						struct drm_dp_mst_port *port,
+						struct drm_dp_sideband_msg_tx *txmsg);
 static bool drm_dp_validate_guid(struct drm_dp_mst_topology_mgr *mgr,
 				 u8 *guid);
 
@@ -825,10 +841,21 @@ static int drm_dp_mst_wait_tx_reply(struct drm_dp_mst_branch *mstb,
 			list_del(&txmsg->next);
 		}
 
-		if (txmsg->state == DRM_DP_SIDEBAND_TX_START_SEND ||
-		    txmsg->state == DRM_DP_SIDEBAND_TX_SENT) {
+		if ((txmsg->state == DRM_DP_SIDEBAND_TX_START_SEND ||
+		     txmsg->state == DRM_DP_SIDEBAND_TX_SENT) &&
+		    txmsg->seqno != -1) {
 			mstb->tx_slots[txmsg->seqno] = NULL;
 		}
+
+		if (txmsg->state == DRM_DP_SIDEBAND_TX_SENT)
+			mgr->tx_down_inflight--;
+
+		/*
+		 * No short pulse is coming for this one, don't let the
+		 * requests queued behind it wait for one.
+		 */
+		mgr->tx_down_busy = false;
+		drm_dp_mst_kick_tx(mgr);
 	}
 out:
 	mutex_unlock(&mgr->qlock);
@@ -892,11 +919,15 @@ static void drm_dp_destroy_mst_branch_device(struct kref *kref)
 	/* drop any tx slots msg */
 	mutex_lock(&mstb->mgr->qlock);
 	if (mstb->tx_slots[0]) {
+		if (mstb->tx_slots[0]->state == DRM_DP_SIDEBAND_TX_SENT)
+			mstb->mgr->tx_down_inflight--;
 		mstb->tx_slots[0]->state = DRM_DP_SIDEBAND_TX_TIMEOUT;
 		mstb->tx_slots[0] = NULL;
 		wake_tx = true;
 	}
 	if (mstb->tx_slots[1]) {
+		if (mstb->tx_slots[1]->state == DRM_DP_SIDEBAND_TX_SENT)
+			mstb->mgr->tx_down_inflight--;
 		mstb->tx_slots[1]->state = DRM_DP_SIDEBAND_TX_TIMEOUT;
 		mstb->tx_slots[1] = NULL;
 		wake_tx = true;
@@ -1139,7 +1170,6 @@ static void drm_dp_add_port(struct drm_dp_mst_branch *mstb,
 			    struct drm_dp_link_addr_reply_port *port_msg)
 {
 	struct drm_dp_mst_port *port;
-	bool ret;
 	bool created = false;
 	int old_pdt = 0;
 	int old_ddps = 0;
@@ -1178,21 +1208,17 @@ static void drm_dp_add_port(struct drm_dp_mst_branch *mstb,
 		mutex_unlock(&mstb->mgr->lock);
 	}
 
-	if (old_ddps != port->ddps) {
-		if (port->ddps) {
-			if (!port->input)
-				drm_dp_send_enum_path_resources(mstb->mgr, mstb, port);
-		} else {
-			port->available_pbn = 0;
-			}
-	}
+	/*
+	 * The path resources of the port and the link address of a new branch
+	 * behind it are requested by drm_dp_check_and_send_link_address(),
+	 * together with those of the other ports.
+	 */
+	if (old_ddps != port->ddps && !port->ddps)
+		port->available_pbn = 0;
 
 	if (old_pdt != port->pdt && !port->input) {
 		drm_dp_port_teardown_pdt(port, old_pdt);
-
-		ret = drm_dp_port_setup_pdt(port);
-		if (ret == true)
-			drm_dp_send_link_address(mstb->mgr, port->mstb);
+		drm_dp_port_setup_pdt(port);
 	}
 
 	if (created && !port->input) {
@@ -1336,31 +1362,122 @@ static struct drm_dp_mst_branch *drm_dp_get_mst_branch_device_by_guid(
 	return mstb;
 }
 
+/*
+ * A sideband request sent while probing the topology, along with the branch
+ * device and port it is for.
+ */
+struct drm_dp_mst_probe_req {
+	struct list_head next;
+	struct drm_dp_mst_branch *mstb;
+	struct drm_dp_mst_port *port;
+	struct drm_dp_sideband_msg_tx *txmsg;
+};
+
+static struct drm_dp_mst_probe_req *
+drm_dp_mst_probe_req_add(struct list_head *reqs,
+			 struct drm_dp_mst_branch *mstb,
+			 struct drm_dp_mst_port *port)
+{
+	struct drm_dp_mst_probe_req *req;
+
+	req = kzalloc(sizeof(*req), GFP_KERNEL);
+	if (!req)
+		return NULL;
+
+	req->mstb = mstb;
+	req->port = port;
+	list_add_tail(&req->next, reqs);
+
+	return req;
+}
+
+/*
+ * Probe the topology below @mstb breadth first. All requests for one level
+ * of the topology - the link addresses of its branch devices and the path
+ * resources of their ports - are sent before waiting for any reply, so that
+ * they are processed by the branch devices in parallel.
+ */
 static void drm_dp_check_and_send_link_address(struct drm_dp_mst_topology_mgr *mgr,
 					       struct drm_dp_mst_branch *mstb)
 {
-	struct drm_dp_mst_port *port;
+	struct drm_dp_mst_probe_req *req, *child, *tmp;
 	struct drm_dp_mst_branch *mstb_child;
+	struct drm_dp_mst_port *port;
+	LIST_HEAD(branches);
+	LIST_HEAD(children);
+	LIST_HEAD(resources);
+
+	req = drm_dp_mst_probe_req_add(&branches, mstb, NULL);
+	if (!req)
+		return;
+
+	kref_get(&mstb->kref);
 	if (!mstb->link_address_sent)
-		drm_dp_send_link_address(mgr, mstb);
+		req->txmsg = drm_dp_queue_link_address(mgr, mstb);
+
+	while (!list_empty(&branches)) {
+		list_for_each_entry(req, &branches, next) {
+			if (req->txmsg)
+				drm_dp_complete_link_address(mgr, req->mstb,
+							     req->txmsg);
+			req->txmsg = NULL;
+		}
 
-	list_for_each_entry(port, &mstb->ports, next) {
-		if (port->input)
-			continue;
+		list_for_each_entry(req, &branches, next) {
+			list_for_each_entry(port, &req->mstb->ports, next) {
+				if (port->input)
+					continue;
+
+				if (!port->ddps)
+					continue;
+
+				if (!port->available_pbn) {
+					child = drm_dp_mst_probe_req_add(&resources,
+									 req->mstb,
+									 port);
+					if (child) {
+						kref_get(&port->kref);
+						child->txmsg = drm_dp_queue_enum_path_resources(mgr, req->mstb, port);
+					}
+				}
 
-		if (!port->ddps)
-			continue;
+				if (!port->mstb)
+					continue;
 
-		if (!port->available_pbn)
-			drm_dp_send_enum_path_resources(mgr, mstb, port);
+				mstb_child = drm_dp_get_validated_mstb_ref(mgr, port->mstb);
+				if (!mstb_child)
+					continue;
 
-		if (port->mstb) {
-			mstb_child = drm_dp_get_validated_mstb_ref(mgr, port->mstb);
-			if (mstb_child) {
-				drm_dp_check_and_send_link_address(mgr, mstb_child);
-				drm_dp_put_mst_branch_device(mstb_child);
+				child = drm_dp_mst_probe_req_add(&children,
+								 mstb_child,
+								 NULL);
+				if (!child) {
+					drm_dp_put_mst_branch_device(mstb_child);
+					continue;
+				}
+
+				if (!mstb_child->link_address_sent)
+					child->txmsg = drm_dp_queue_link_address(mgr, mstb_child);
 			}
 		}
+
+		list_for_each_entry_safe(req, tmp, &resources, next) {
+			if (req->txmsg)
+				drm_dp_complete_enum_path_resources(mgr, req->mstb,
+								    req->port,
+								    req->txmsg);
+			drm_dp_put_port(req->port);
+			list_del(&req->next);
+			kfree(req);
+		}
+
+		list_for_each_entry_safe(req, tmp, &branches, next) {
+			drm_dp_put_mst_branch_device(req->mstb);
+			list_del(&req->next);
+			kfree(req);
+		}
+
+		list_splice_init(&children, &branches);
 	}
 }
 
@@ -1539,29 +1656,62 @@ static int process_single_tx_qlock(struct drm_dp_mst_topology_mgr *mgr,
 	return 0;
 }
 
-static void process_single_down_tx_qlock(struct drm_dp_mst_topology_mgr *mgr)
+static void drm_dp_fail_down_tx_qlock(struct drm_dp_mst_topology_mgr *mgr,
+				      struct drm_dp_sideband_msg_tx *txmsg,
+				      int ret)
+{
+	DRM_DEBUG_KMS("failed to send msg in q %d\n", ret);
+	list_del(&txmsg->next);
+	if (txmsg->seqno != -1)
+		txmsg->dst->tx_slots[txmsg->seqno] = NULL;
+	txmsg->state = DRM_DP_SIDEBAND_TX_TIMEOUT;
+	wake_up_all(&mgr->tx_waitq);
+}
+
+/*
+ * Send the next chunk of the down request queue.
+ *
+ * The sink has a single down request buffer, so nothing is written to it
+ * until a short pulse signalled that the sink has consumed the previous
+ * chunk, see drm_dp_tx_work(). The remaining chunks of a partially sent
+ * request go out first. Otherwise the first queued request whose branch
+ * device has a free sideband slot is started; requests to a branch device
+ * with both slots busy don't hold up the ones behind them.
+ *
+ * Unless dp_mst_pipeline is set, only one request is in flight at a time:
+ * the next one starts after the reply to the previous one arrived.
+ */
+static void process_down_tx_qlock(struct drm_dp_mst_topology_mgr *mgr)
 {
 	struct drm_dp_sideband_msg_tx *txmsg;
-	int ret;
+	int ret = -EAGAIN;
 
 	WARN_ON(!mutex_is_locked(&mgr->qlock));
 
-	/* construct a chunk from the first msg in the tx_msg queue */
-	if (list_empty(&mgr->tx_msg_downq))
+	if (mgr->tx_down_busy)
 		return;
 
-	txmsg = list_first_entry(&mgr->tx_msg_downq, struct drm_dp_sideband_msg_tx, next);
-	ret = process_single_tx_qlock(mgr, txmsg, false);
+	list_for_each_entry(txmsg, &mgr->tx_msg_downq, next) {
+		if (!drm_dp_mst_pipeline && txmsg->cur_offset == 0 &&
+		    mgr->tx_down_inflight)
+			return;
+
+		ret = process_single_tx_qlock(mgr, txmsg, false);
+		if (ret != -EAGAIN)
+			break;
+	}
+
 	if (ret == 1) {
 		/* txmsg is sent it should be in the slots now */
 		list_del(&txmsg->next);
-	} else if (ret) {
-		DRM_DEBUG_KMS("failed to send msg in q %d\n", ret);
-		list_del(&txmsg->next);
-		if (txmsg->seqno != -1)
-			txmsg->dst->tx_slots[txmsg->seqno] = NULL;
-		txmsg->state = DRM_DP_SIDEBAND_TX_TIMEOUT;
-		wake_up_all(&mgr->tx_waitq);
+		mgr->tx_down_inflight++;
+		mgr->tx_down_busy = true;
+	} else if (ret == 0) {
+		/* finish this one before starting any other */
+		list_move(&txmsg->next, &mgr->tx_msg_downq);
+		mgr->tx_down_busy = true;
+	} else if (ret != -EAGAIN) {
+		drm_dp_fail_down_tx_qlock(mgr, txmsg, ret);
 	}
 }
 
@@ -1585,28 +1735,35 @@ static void drm_dp_queue_down_tx(struct drm_dp_mst_topology_mgr *mgr,
 {
 	mutex_lock(&mgr->qlock);
 	list_add_tail(&txmsg->next, &mgr->tx_msg_downq);
-	if (list_is_singular(&mgr->tx_msg_downq))
-		process_single_down_tx_qlock(mgr);
+	process_down_tx_qlock(mgr);
 	mutex_unlock(&mgr->qlock);
 }
 
-static void drm_dp_send_link_address(struct drm_dp_mst_topology_mgr *mgr,
-				     struct drm_dp_mst_branch *mstb)
+static struct drm_dp_sideband_msg_tx *
+drm_dp_queue_link_address(struct drm_dp_mst_topology_mgr *mgr,
+			  struct drm_dp_mst_branch *mstb)
 {
-	int len;
 	struct drm_dp_sideband_msg_tx *txmsg;
-	int ret;
 
 	txmsg = kzalloc(sizeof(*txmsg), GFP_KERNEL);
 	if (!txmsg)
-		return;
+		return NULL;
 
 	txmsg->dst = mstb;
-	len = build_link_address(txmsg);
+	build_link_address(txmsg);
 
 	mstb->link_address_sent = true;
 	drm_dp_queue_down_tx(mgr, txmsg);
 
+	return txmsg;
+}
+
+static void drm_dp_complete_link_address(struct drm_dp_mst_topology_mgr *mgr,
+					 struct drm_dp_mst_branch *mstb,
+					 struct drm_dp_sideband_msg_tx *txmsg)
+{
+	int ret;
+
 	ret = drm_dp_mst_wait_tx_reply(mstb, txmsg);
 	if (ret > 0) {
 		int i;
@@ -1643,23 +1800,32 @@ static void drm_dp_send_link_address(struct drm_dp_mst_topology_mgr *mgr,
 	kfree(txmsg);
 }
 
-static int drm_dp_send_enum_path_resources(struct drm_dp_mst_topology_mgr *mgr,
-					   struct drm_dp_mst_branch *mstb,
-					   struct drm_dp_mst_port *port)
+static struct drm_dp_sideband_msg_tx *
+drm_dp_queue_enum_path_resources(struct drm_dp_mst_topology_mgr *mgr,
+				 struct drm_dp_mst_branch *mstb,
+				 struct drm_dp_mst_port *port)
 {
-	int len;
 	struct drm_dp_sideband_msg_tx *txmsg;
-	int ret;
 
 	txmsg = kzalloc(sizeof(*txmsg), GFP_KERNEL);
 	if (!txmsg)
-		return -ENOMEM;
+		return NULL;
 
 	txmsg->dst = mstb;
-	len = build_enum_path_resources(txmsg, port->port_num);
+	build_enum_path_resources(txmsg, port->port_num);
 
 	drm_dp_queue_down_tx(mgr, txmsg);
 
+	return txmsg;
+}
+
+static void drm_dp_complete_enum_path_resources(struct drm_dp_mst_topology_mgr *mgr,
+						struct drm_dp_mst_branch *mstb,
+						struct drm_dp_mst_port *port,
+						struct drm_dp_sideband_msg_tx *txmsg)
+{
+	int ret;
+
 	ret = drm_dp_mst_wait_tx_reply(mstb, txmsg);
 	if (ret > 0) {
 		if (txmsg->reply.reply_type == 1)
@@ -1674,7 +1840,6 @@ static int drm_dp_send_enum_path_resources(struct drm_dp_mst_topology_mgr *mgr,
 	}
 
 	kfree(txmsg);
-	return 0;
 }
 
 static struct drm_dp_mst_port *drm_dp_get_last_connected_port_to_mstb(struct drm_dp_mst_branch *mstb)
@@ -2127,6 +2292,12 @@ int drm_dp_mst_topology_mgr_set_mst(struct drm_dp_mst_topology_mgr *mgr, bool ms
 			goto out_unlock;
 		}
 
+		/* nothing is in flight towards the new sink */
+		mutex_lock(&mgr->qlock);
+		mgr->tx_down_busy = false;
+		mgr->tx_down_inflight = 0;
+		mutex_unlock(&mgr->qlock);
+
 		/* add initial branch device at LCT 1 */
 		mstb = drm_dp_add_mst_branch_device(1, NULL);
 		if (mstb == NULL) {
@@ -2352,6 +2523,7 @@ static int drm_dp_mst_handle_down_rep(struct drm_dp_mst_topology_mgr *mgr)
 		mutex_lock(&mgr->qlock);
 		txmsg->state = DRM_DP_SIDEBAND_TX_RX;
 		mstb->tx_slots[slot] = NULL;
+		mgr->tx_down_inflight--;
 		mutex_unlock(&mgr->qlock);
 
 		wake_up_all(&mgr->tx_waitq);
@@ -3042,8 +3214,10 @@ static void drm_dp_tx_work(struct work_struct *work)
 	struct drm_dp_mst_topology_mgr *mgr = container_of(work, struct drm_dp_mst_topology_mgr, tx_work);
 
 	mutex_lock(&mgr->qlock);
+	/* kicked from a short pulse, the sink is done with the last chunk */
+	mgr->tx_down_busy = false;
 	if (!list_empty(&mgr->tx_msg_downq))
-		process_single_down_tx_qlock(mgr);
+		process_down_tx_qlock(mgr);
 	mutex_unlock(&mgr->qlock);
 }
 
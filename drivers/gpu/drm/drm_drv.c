@@ -476,7 +476,6 @@ int drm_dev_init(struct drm_device *dev,
 	INIT_LIST_HEAD(&dev->ctxlist);
 	INIT_LIST_HEAD(&dev->vmalist);
 	INIT_LIST_HEAD(&dev->maplist);
-	INIT_LIST_HEAD(&dev->vblank_event_list);
 
 	spin_lock_init(&dev->buf_lock);
 	spin_lock_init(&dev->event_lock);
@@ -968,6 +967,7 @@ static int __init drm_core_init(void)
 
 	drm_global_init();
 	drm_connector_ida_init();
+	drm_edid_vic_index_init();
 	idr_init(&drm_minors_idr);
 
 	ret = drm_sysfs_init();
@@ -29,6 +29,7 @@
  */
 #include <linux/kernel.h>
 #include <linux/slab.h>
+#include <linux/hash.h>
 #include <linux/hdmi.h>
 #include <linux/i2c.h>
 #include <linux/module.h>
@@ -1312,6 +1313,11 @@ module_param_named(edid_fixup, edid_fixup, int, 0400);
 MODULE_PARM_DESC(edid_fixup,
 		 "Minimum number of valid EDID header bytes (0-8, default 6)");
 
+static bool edid_cache __read_mostly = true;
+module_param_named(edid_cache, edid_cache, bool, 0600);
+MODULE_PARM_DESC(edid_cache,
+		 "Reuse the modes of a connector when its EDID is unchanged (default true)");
+
 static void drm_get_displayid(struct drm_connector *connector,
 			      struct edid *edid);
 
@@ -1545,6 +1551,63 @@ static void connector_bad_edid(struct drm_connector *connector,
 	}
 }
 
+void drm_edid_cache_init(struct drm_connector *connector)
+{
+	struct drm_edid_cache *cache = &connector->edid_cache;
+
+	mutex_init(&cache->lock);
+	INIT_LIST_HEAD(&cache->modes);
+}
+
+void drm_edid_cache_fini(struct drm_connector *connector)
+{
+	drm_edid_cache_invalidate(connector);
+	mutex_destroy(&connector->edid_cache.lock);
+}
+
+static void drm_edid_cache_clear_modes(struct drm_connector *connector)
+{
+	struct drm_edid_cache *cache = &connector->edid_cache;
+	struct drm_display_mode *mode, *t;
+
+	lockdep_assert_held(&cache->lock);
+
+	list_for_each_entry_safe(mode, t, &cache->modes, head) {
+		list_del(&mode->head);
+		drm_mode_destroy(connector->dev, mode);
+	}
+
+	kfree(cache->parsed);
+	cache->parsed = NULL;
+}
+
+/**
+ * drm_edid_cache_invalidate - forget the cached modes of a connector
+ * @connector: connector whose sink changed
+ *
+ * drm_add_edid_modes() reuses the modes parsed from the last EDID when it is
+ * given an identical one. Drivers which override EDID parsing results through
+ * other means can call this to make the next probe parse the EDID again.
+ */
+void drm_edid_cache_invalidate(struct drm_connector *connector)
+{
+	struct drm_edid_cache *cache = &connector->edid_cache;
+
+	mutex_lock(&cache->lock);
+	drm_edid_cache_clear_modes(connector);
+	mutex_unlock(&cache->lock);
+}
+EXPORT_SYMBOL(drm_edid_cache_invalidate);
+
+/* Compare the cheap fingerprint first and only then all of the EDID */
+static bool drm_edid_cache_match(const struct edid *cached, const u8 *raw,
+				 size_t len)
+{
+	return cached && cached->checksum == raw[EDID_LENGTH - 1] &&
+	       cached->extensions == raw[0x7e] &&
+	       !memcmp(cached, raw, len);
+}
+
 /**
  * drm_do_get_edid - get EDID data using a custom EDID block read function
  * @connector: connector we're probing
@@ -2927,6 +2990,58 @@ cea_mode_alternate_timings(u8 vic, struct drm_display_mode *mode)
 	return false;
 }
 
+/*
+ * Both VIC tables are indexed by a hash of the mode size and htotal, which
+ * the alternate clocks and timings of a VIC keep unchanged, so that matching
+ * a mode only needs to look at the few VICs of the same size instead of
+ * scanning all of them. Chains are in ascending VIC order, so the first match
+ * is the same the linear scan found.
+ */
+#define DRM_VIC_HASH_BITS 6
+
+struct drm_vic_index {
+	u8 buckets[1 << DRM_VIC_HASH_BITS];
+	u8 next[128];
+};
+
+static struct drm_vic_index cea_vic_index __read_mostly;
+static struct drm_vic_index hdmi_vic_index __read_mostly;
+
+static u32 drm_vic_hash(const struct drm_display_mode *mode)
+{
+	return hash_32((mode->hdisplay << 16 | mode->vdisplay) ^ mode->htotal,
+		       DRM_VIC_HASH_BITS);
+}
+
+static void drm_vic_index_init(struct drm_vic_index *index,
+			       const struct drm_display_mode *modes,
+			       unsigned int count)
+{
+	unsigned int vic;
+
+	for (vic = count - 1; vic > 0; vic--) {
+		u32 hash = drm_vic_hash(&modes[vic]);
+
+		index->next[vic] = index->buckets[hash];
+		index->buckets[hash] = vic;
+	}
+}
+
+void drm_edid_vic_index_init(void)
+{
+	BUILD_BUG_ON(ARRAY_SIZE(edid_cea_modes) > ARRAY_SIZE(cea_vic_index.next));
+	BUILD_BUG_ON(ARRAY_SIZE(edid_4k_modes) > ARRAY_SIZE(hdmi_vic_index.next));
+
+	drm_vic_index_init(&cea_vic_index, edid_cea_modes,
+			   ARRAY_SIZE(edid_cea_modes));
+	drm_vic_index_init(&hdmi_vic_index, edid_4k_modes,
+			   ARRAY_SIZE(edid_4k_modes));
+}
+
+#define for_each_vic_candidate(vic, index, mode) \
+	for ((vic) = (index)->buckets[drm_vic_hash(mode)]; (vic); \
+	     (vic) = (index)->next[vic])
+
 static u8 drm_match_cea_mode_clock_tolerance(const struct drm_display_mode *to_match,
 					     unsigned int clock_tolerance)
 {
@@ -2935,7 +3050,7 @@ static u8 drm_match_cea_mode_clock_tolerance(const struct drm_display_mode *to_m
 	if (!to_match->clock)
 		return 0;
 
-	for (vic = 1; vic < ARRAY_SIZE(edid_cea_modes); vic++) {
+	for_each_vic_candidate(vic, &cea_vic_index, to_match) {
 		struct drm_display_mode cea_mode = edid_cea_modes[vic];
 		unsigned int clock1, clock2;
 
@@ -2970,7 +3085,7 @@ u8 drm_match_cea_mode(const struct drm_display_mode *to_match)
 	if (!to_match->clock)
 		return 0;
 
-	for (vic = 1; vic < ARRAY_SIZE(edid_cea_modes); vic++) {
+	for_each_vic_candidate(vic, &cea_vic_index, to_match) {
 		struct drm_display_mode cea_mode = edid_cea_modes[vic];
 		unsigned int clock1, clock2;
 
@@ -3035,7 +3150,7 @@ static u8 drm_match_hdmi_mode_clock_tolerance(const struct drm_display_mode *to_
 	if (!to_match->clock)
 		return 0;
 
-	for (vic = 1; vic < ARRAY_SIZE(edid_4k_modes); vic++) {
+	for_each_vic_candidate(vic, &hdmi_vic_index, to_match) {
 		const struct drm_display_mode *hdmi_mode = &edid_4k_modes[vic];
 		unsigned int clock1, clock2;
 
@@ -3069,7 +3184,7 @@ static u8 drm_match_hdmi_mode(const struct drm_display_mode *to_match)
 	if (!to_match->clock)
 		return 0;
 
-	for (vic = 1; vic < ARRAY_SIZE(edid_4k_modes); vic++) {
+	for_each_vic_candidate(vic, &hdmi_vic_index, to_match) {
 		const struct drm_display_mode *hdmi_mode = &edid_4k_modes[vic];
 		unsigned int clock1, clock2;
 
@@ -4662,6 +4777,110 @@ static int add_displayid_detailed_modes(struct drm_connector *connector,
 	return num_modes;
 }
 
+/*
+ * Reuse the modes of the last EDID parsed for @connector if @edid is the
+ * same. Parsing modes also updates parts of &drm_display_info, which are
+ * restored from the cache as well.
+ */
+static int drm_edid_cache_add_modes(struct drm_connector *connector,
+				    const struct edid *edid)
+{
+	struct drm_edid_cache *cache = &connector->edid_cache;
+	struct drm_display_mode *mode, *newmode;
+	int num_modes = -ENOENT;
+
+	if (!edid_cache)
+		return -ENOENT;
+
+	mutex_lock(&cache->lock);
+	if (!drm_edid_cache_match(cache->parsed, (const u8 *)edid,
+				  (edid->extensions + 1) * EDID_LENGTH))
+		goto out;
+
+	list_for_each_entry(mode, &cache->modes, head) {
+		newmode = drm_mode_duplicate(connector->dev, mode);
+		if (newmode)
+			drm_mode_probed_add(connector, newmode);
+	}
+
+	connector->display_info.hdmi = cache->hdmi;
+	connector->display_info.color_formats = cache->color_formats;
+
+	num_modes = cache->num_modes;
+	cache->parse_hits++;
+out:
+	mutex_unlock(&cache->lock);
+
+	return num_modes;
+}
+
+static void drm_edid_cache_store_modes(struct drm_connector *connector,
+				       const struct edid *edid, int num_modes)
+{
+	struct drm_edid_cache *cache = &connector->edid_cache;
+	struct drm_display_mode *mode, *newmode;
+
+	if (!edid_cache)
+		return;
+
+	mutex_lock(&cache->lock);
+	drm_edid_cache_clear_modes(connector);
+
+	cache->parsed = drm_edid_duplicate(edid);
+	if (!cache->parsed)
+		goto out;
+
+	list_for_each_entry(mode, &connector->probed_modes, head) {
+		newmode = drm_mode_duplicate(connector->dev, mode);
+		if (!newmode) {
+			drm_edid_cache_clear_modes(connector);
+			goto out;
+		}
+		list_add_tail(&newmode->head, &cache->modes);
+	}
+
+	cache->num_modes = num_modes;
+	cache->hdmi = connector->display_info.hdmi;
+	cache->color_formats = connector->display_info.color_formats;
+out:
+	mutex_unlock(&cache->lock);
+}
+
+static int drm_edid_add_modes(struct drm_connector *connector,
+			      struct edid *edid, u32 quirks)
+{
+	int num_modes = 0;
+
+	/*
+	 * EDID spec says modes should be preferred in this order:
+	 * - preferred detailed mode
+	 * - other detailed modes from base block
+	 * - detailed modes from extension blocks
+	 * - CVT 3-byte code modes
+	 * - standard timing codes
+	 * - established timing codes
+	 * - modes inferred from GTF or CVT range information
+	 *
+	 * We get this pretty much right.
+	 *
+	 * XXX order for additional mode types in extension blocks?
+	 */
+	num_modes += add_detailed_modes(connector, edid, quirks);
+	num_modes += add_cvt_modes(connector, edid);
+	num_modes += add_standard_modes(connector, edid);
+	num_modes += add_established_modes(connector, edid);
+	num_modes += add_cea_modes(connector, edid);
+	num_modes += add_alternate_cea_modes(connector, edid);
+	num_modes += add_displayid_detailed_modes(connector, edid);
+	if (edid->features & DRM_EDID_FEATURE_DEFAULT_GTF)
+		num_modes += add_inferred_modes(connector, edid);
+
+	if (quirks & (EDID_QUIRK_PREFER_LARGE_60 | EDID_QUIRK_PREFER_LARGE_75))
+		edid_fixup_preferred(connector, quirks);
+
+	return num_modes;
+}
+
 /**
  * drm_add_edid_modes - add modes from EDID data, if available
  * @connector: connector we're probing
@@ -4675,7 +4894,8 @@ static int add_displayid_detailed_modes(struct drm_connector *connector,
  */
 int drm_add_edid_modes(struct drm_connector *connector, struct edid *edid)
 {
-	int num_modes = 0;
+	bool cacheable;
+	int num_modes;
 	u32 quirks;
 
 	if (edid == NULL) {
@@ -4699,31 +4919,17 @@ int drm_add_edid_modes(struct drm_connector *connector, struct edid *edid)
 	quirks = drm_add_display_info(connector, edid);
 
 	/*
-	 * EDID spec says modes should be preferred in this order:
-	 * - preferred detailed mode
-	 * - other detailed modes from base block
-	 * - detailed modes from extension blocks
-	 * - CVT 3-byte code modes
-	 * - standard timing codes
-	 * - established timing codes
-	 * - modes inferred from GTF or CVT range information
-	 *
-	 * We get this pretty much right.
-	 *
-	 * XXX order for additional mode types in extension blocks?
+	 * Only cache the result when nothing else was probed yet, since
+	 * edid_fixup_preferred() looks at all probed modes.
 	 */
-	num_modes += add_detailed_modes(connector, edid, quirks);
-	num_modes += add_cvt_modes(connector, edid);
-	num_modes += add_standard_modes(connector, edid);
-	num_modes += add_established_modes(connector, edid);
-	num_modes += add_cea_modes(connector, edid);
-	num_modes += add_alternate_cea_modes(connector, edid);
-	num_modes += add_displayid_detailed_modes(connector, edid);
-	if (edid->features & DRM_EDID_FEATURE_DEFAULT_GTF)
-		num_modes += add_inferred_modes(connector, edid);
-
-	if (quirks & (EDID_QUIRK_PREFER_LARGE_60 | EDID_QUIRK_PREFER_LARGE_75))
-		edid_fixup_preferred(connector, quirks);
+	cacheable = list_empty(&connector->probed_modes);
+	num_modes = cacheable ? drm_edid_cache_add_modes(connector, edid) :
+				-ENOENT;
+	if (num_modes < 0) {
+		num_modes = drm_edid_add_modes(connector, edid, quirks);
+		if (cacheable)
+			drm_edid_cache_store_modes(connector, edid, num_modes);
+	}
 
 	if (quirks & EDID_QUIRK_FORCE_6BPC)
 		connector->display_info.bpc = 6;
@@ -26,6 +26,8 @@
 
 /* drm_file.c */
 extern struct mutex drm_global_mutex;
+struct drm_file *drm_file_alloc(struct drm_minor *minor);
+void drm_file_free(struct drm_file *file);
 void drm_lastclose(struct drm_device *dev);
 
 /* drm_pci.c */
@@ -58,6 +60,53 @@ int drm_gem_name_info(struct seq_file *m, void *data);
 void drm_vblank_disable_and_save(struct drm_device *dev, unsigned int pipe);
 void drm_vblank_cleanup(struct drm_device *dev);
 
+static inline bool drm_vblank_passed(u64 seq, u64 ref)
+{
+	return (seq - ref) <= (1 << 23);
+}
+
+/*
+ * Pending vblank events are kept sorted by target sequence on
+ * &drm_vblank_crtc.event_list, with events for the same sequence in the order
+ * they were queued. New events almost always target one of the next few
+ * vblanks, so the insertion point is searched from the tail.
+ *
+ * Targets can be arbitrarily far ahead, well outside the window
+ * drm_vblank_passed() handles, so they are ordered by their distance from the
+ * current vblank count @seq instead. Events that are already due but haven't
+ * been delivered yet sort first.
+ */
+static inline u64 drm_vblank_event_distance(u64 target, u64 seq)
+{
+	return drm_vblank_passed(seq, target) ? 0 : target - seq;
+}
+
+static inline void
+drm_vblank_event_insert(struct list_head *queue,
+			struct drm_pending_vblank_event *e, u64 seq)
+{
+	struct drm_pending_vblank_event *pos;
+	u64 distance = drm_vblank_event_distance(e->sequence, seq);
+
+	list_for_each_entry_reverse(pos, queue, base.link)
+		if (drm_vblank_event_distance(pos->sequence, seq) <= distance)
+			break;
+
+	list_add(&e->base.link, &pos->base.link);
+}
+
+static inline struct drm_pending_vblank_event *
+drm_vblank_event_next_due(struct list_head *queue, u64 seq)
+{
+	struct drm_pending_vblank_event *e;
+
+	e = list_first_entry_or_null(queue, typeof(*e), base.link);
+	if (e && !drm_vblank_passed(seq, e->sequence))
+		return NULL;
+
+	return e;
+}
+
 /* IOCTLS */
 int drm_wait_vblank_ioctl(struct drm_device *dev, void *data,
 			  struct drm_file *filp);
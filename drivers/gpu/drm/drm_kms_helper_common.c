@@ -76,6 +76,10 @@ static int __init drm_kms_helper_init(void)
 	if (ret < 0)
 		goto out;
 
+	ret = drm_kms_helper_poll_init_wq();
+	if (ret < 0)
+		drm_dp_aux_dev_exit();
+
 out:
 	return ret;
 }
@@ -83,6 +87,7 @@ out:
 static void __exit drm_kms_helper_exit(void)
 {
 	/* Call exit functions from specific kms helpers here */
+	drm_kms_helper_poll_fini_wq();
 	drm_dp_aux_dev_exit();
 }
 
@@ -21,12 +21,52 @@
  */
 
 #include <linux/export.h>
+#include <linux/hash.h>
+#include <linux/rcupdate.h>
 #include <drm/drmP.h>
 #include <drm/drm_mode_object.h>
 #include <drm/drm_atomic.h>
 
 #include "drm_crtc_internal.h"
 
+/*
+ * Lookups run under RCU without &drm_mode_config.idr_mutex for objects whose
+ * memory is either only freed after a grace period (property blobs) or not
+ * before the device goes away (CRTCs, planes, encoders and properties).
+ * Everything else is freed by drivers right after it's unregistered, so its
+ * idr entry is tagged and the lookup falls back to the mutex, which the free
+ * path also takes.
+ */
+#define DRM_MODE_OBJECT_IDR_LOCKED	1UL
+
+static bool drm_mode_object_rcu_safe(uint32_t type)
+{
+	switch (type) {
+	case DRM_MODE_OBJECT_CRTC:
+	case DRM_MODE_OBJECT_PLANE:
+	case DRM_MODE_OBJECT_ENCODER:
+	case DRM_MODE_OBJECT_PROPERTY:
+	case DRM_MODE_OBJECT_BLOB:
+		return true;
+	default:
+		return false;
+	}
+}
+
+static void *drm_mode_object_idr_ptr(struct drm_mode_object *obj,
+				     uint32_t type)
+{
+	if (drm_mode_object_rcu_safe(type))
+		return obj;
+
+	return (void *)((unsigned long)obj | DRM_MODE_OBJECT_IDR_LOCKED);
+}
+
+static struct drm_mode_object *drm_mode_object_from_idr(void *ptr)
+{
+	return (void *)((unsigned long)ptr & ~DRM_MODE_OBJECT_IDR_LOCKED);
+}
+
 /*
  * Internal function to assign a slot in the object idr and optionally
  * register the object into the idr.
@@ -38,7 +78,9 @@ int __drm_mode_object_add(struct drm_device *dev, struct drm_mode_object *obj,
 	int ret;
 
 	mutex_lock(&dev->mode_config.idr_mutex);
-	ret = idr_alloc(&dev->mode_config.crtc_idr, register_obj ? obj : NULL, 1, 0, GFP_KERNEL);
+	ret = idr_alloc(&dev->mode_config.crtc_idr,
+			register_obj ? drm_mode_object_idr_ptr(obj, obj_type) : NULL,
+			1, 0, GFP_KERNEL);
 	if (ret >= 0) {
 		/*
 		 * Set up the object linking under the protection of the idr
@@ -78,7 +120,8 @@ void drm_mode_object_register(struct drm_device *dev,
 			      struct drm_mode_object *obj)
 {
 	mutex_lock(&dev->mode_config.idr_mutex);
-	idr_replace(&dev->mode_config.crtc_idr, obj, obj->id);
+	idr_replace(&dev->mode_config.crtc_idr,
+		    drm_mode_object_idr_ptr(obj, obj->type), obj->id);
 	mutex_unlock(&dev->mode_config.idr_mutex);
 }
 
@@ -123,14 +166,63 @@ bool drm_mode_object_lease_required(uint32_t type)
 	}
 }
 
+static bool drm_mode_object_lease_check_locked(struct drm_file *file_priv)
+{
+	return file_priv && file_priv->master && file_priv->master->lessor;
+}
+
+static struct drm_mode_object *
+drm_mode_object_find_rcu(struct drm_device *dev, struct drm_file *file_priv,
+			 uint32_t id, uint32_t type, bool *retry)
+{
+	struct drm_mode_object *obj;
+	void *ptr;
+
+	rcu_read_lock();
+	ptr = idr_find(&dev->mode_config.crtc_idr, id);
+	if ((unsigned long)ptr & DRM_MODE_OBJECT_IDR_LOCKED) {
+		*retry = true;
+		obj = NULL;
+		goto out;
+	}
+
+	obj = ptr;
+	if (obj && type != DRM_MODE_OBJECT_ANY && READ_ONCE(obj->type) != type)
+		obj = NULL;
+	if (obj && READ_ONCE(obj->id) != id)
+		obj = NULL;
+
+	/* Lessees need the lease tables, which are protected by the mutex */
+	if (obj && drm_mode_object_lease_required(obj->type) &&
+	    drm_mode_object_lease_check_locked(file_priv)) {
+		*retry = true;
+		obj = NULL;
+		goto out;
+	}
+
+	if (obj && obj->free_cb) {
+		if (!kref_get_unless_zero(&obj->refcount))
+			obj = NULL;
+	}
+out:
+	rcu_read_unlock();
+
+	return obj;
+}
+
 struct drm_mode_object *__drm_mode_object_find(struct drm_device *dev,
 					       struct drm_file *file_priv,
 					       uint32_t id, uint32_t type)
 {
 	struct drm_mode_object *obj = NULL;
+	bool retry = false;
+
+	obj = drm_mode_object_find_rcu(dev, file_priv, id, type, &retry);
+	if (!retry)
+		return obj;
 
 	mutex_lock(&dev->mode_config.idr_mutex);
-	obj = idr_find(&dev->mode_config.crtc_idr, id);
+	obj = drm_mode_object_from_idr(idr_find(&dev->mode_config.crtc_idr, id));
 	if (obj && type != DRM_MODE_OBJECT_ANY && obj->type != type)
 		obj = NULL;
 	if (obj && obj->id != id)
@@ -205,6 +297,67 @@ void drm_mode_object_get(struct drm_mode_object *obj)
 }
 EXPORT_SYMBOL(drm_mode_object_get);
 
+#define DRM_OBJECT_PROPERTY_INDEX_MASK \
+	((1 << DRM_OBJECT_PROPERTY_INDEX_BITS) - 1)
+
+static int drm_object_property_slot(const struct drm_object_properties *props,
+				    uint32_t prop_id)
+{
+	unsigned int bucket = hash_32(prop_id, DRM_OBJECT_PROPERTY_INDEX_BITS);
+	unsigned int i;
+	u8 slot;
+
+	for (i = 0; i <= DRM_OBJECT_PROPERTY_INDEX_MASK; i++) {
+		slot = props->index[(bucket + i) & DRM_OBJECT_PROPERTY_INDEX_MASK];
+		if (!slot)
+			break;
+		if (props->properties[slot - 1]->base.id == prop_id)
+			return slot - 1;
+	}
+
+	return -1;
+}
+
+static void drm_object_property_index(struct drm_object_properties *props,
+				      uint32_t prop_id, int slot)
+{
+	unsigned int bucket = hash_32(prop_id, DRM_OBJECT_PROPERTY_INDEX_BITS);
+
+	/* There are more buckets than slots, so this always terminates */
+	while (props->index[bucket])
+		bucket = (bucket + 1) & DRM_OBJECT_PROPERTY_INDEX_MASK;
+	props->index[bucket] = slot + 1;
+}
+
+static int drm_object_property_find(struct drm_mode_object *obj,
+				    struct drm_property *property)
+{
+	int slot = drm_object_property_slot(obj->properties, property->base.id);
+
+	if (slot < 0 || obj->properties->properties[slot] != property)
+		return -1;
+
+	return slot;
+}
+
+/*
+ * Returns the &enum drm_atomic_property_kind of @property on @obj. Properties
+ * which were never attached, like the ones the legacy helpers set directly,
+ * get classified on the spot.
+ */
+unsigned int drm_mode_object_property_kind(struct drm_mode_object *obj,
+					   struct drm_property *property)
+{
+	int slot = -1;
+
+	if (obj->properties)
+		slot = drm_object_property_find(obj, property);
+	if (slot < 0)
+		return drm_atomic_classify_property(obj, property);
+
+	return obj->properties->kinds[slot];
+}
+
 /**
  * drm_object_attach_property - attach a property to a modeset object
  * @obj: drm modeset object
@@ -231,6 +384,9 @@ void drm_object_attach_property(struct drm_mode_object *obj,
 
 	obj->properties->properties[count] = property;
 	obj->properties->values[count] = init_val;
+	obj->properties->kinds[count] =
+		drm_atomic_classify_property(obj, property);
+	drm_object_property_index(obj->properties, property->base.id, count);
 	obj->properties->count++;
 }
 EXPORT_SYMBOL(drm_object_attach_property);
@@ -257,19 +413,17 @@ EXPORT_SYMBOL(drm_object_attach_property);
 int drm_object_property_set_value(struct drm_mode_object *obj,
 				  struct drm_property *property, uint64_t val)
 {
-	int i;
+	int slot;
 
 	WARN_ON(drm_drv_uses_atomic_modeset(property->dev) &&
 		!(property->flags & DRM_MODE_PROP_IMMUTABLE));
 
-	for (i = 0; i < obj->properties->count; i++) {
-		if (obj->properties->properties[i] == property) {
-			obj->properties->values[i] = val;
-			return 0;
-		}
-	}
+	slot = drm_object_property_find(obj, property);
+	if (slot < 0)
+		return -EINVAL;
 
-	return -EINVAL;
+	obj->properties->values[slot] = val;
+	return 0;
 }
 EXPORT_SYMBOL(drm_object_property_set_value);
 
@@ -277,7 +431,7 @@ static int __drm_object_property_get_value(struct drm_mode_object *obj,
 					   struct drm_property *property,
 					   uint64_t *val)
 {
-	int i;
+	int slot;
 
 	/* read-only properties bypass atomic mechanism and still store
 	 * their value in obj->properties->values[].. mostly to avoid
@@ -287,15 +441,12 @@ static int __drm_object_property_get_value(struct drm_mode_object *obj,
 			!(property->flags & DRM_MODE_PROP_IMMUTABLE))
 		return drm_atomic_get_property(obj, property, val);
 
-	for (i = 0; i < obj->properties->count; i++) {
-		if (obj->properties->properties[i] == property) {
-			*val = obj->properties->values[i];
-			return 0;
-		}
-
-	}
+	slot = drm_object_property_find(obj, property);
+	if (slot < 0)
+		return -EINVAL;
 
-	return -EINVAL;
+	*val = obj->properties->values[slot];
+	return 0;
 }
 
 /**
@@ -410,13 +561,12 @@ out:
 struct drm_property *drm_mode_obj_find_prop_id(struct drm_mode_object *obj,
 					       uint32_t prop_id)
 {
-	int i;
+	int slot = drm_object_property_slot(obj->properties, prop_id);
 
-	for (i = 0; i < obj->properties->count; i++)
-		if (obj->properties->properties[i]->base.id == prop_id)
-			return obj->properties->properties[i];
+	if (slot < 0)
+		return NULL;
 
-	return NULL;
+	return obj->properties->properties[slot];
 }
 
 static int set_property_legacy(struct drm_mode_object *obj,
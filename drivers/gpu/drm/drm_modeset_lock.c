@@ -262,6 +262,7 @@ static inline int modeset_lock(struct drm_modeset_lock *lock,
 		struct drm_modeset_acquire_ctx *ctx,
 		bool interruptible, bool slow)
 {
+	ktime_t start = 0;
 	int ret;
 
 #ifndef __linux__
@@ -280,7 +281,12 @@ static inline int modeset_lock(struct drm_modeset_lock *lock,
 			return -EBUSY;
 		else
 			return 0;
-	} else if (interruptible && slow) {
+	}
+
+	if (unlikely(ctx->stats))
+		start = ktime_get();
+
+	if (interruptible && slow) {
 		ret = ww_mutex_lock_slow_interruptible(&lock->mutex, &ctx->ww_ctx);
 	} else if (interruptible) {
 		ret = ww_mutex_lock_interruptible(&lock->mutex, &ctx->ww_ctx);
@@ -290,6 +296,12 @@ static inline int modeset_lock(struct drm_modeset_lock *lock,
 	} else {
 		ret = ww_mutex_lock(&lock->mutex, &ctx->ww_ctx);
 	}
+	if (unlikely(ctx->stats)) {
+		ctx->stats->locks++;
+		ctx->stats->wait_ns += ktime_to_ns(ktime_sub(ktime_get(), start));
+		if (ret == -EDEADLK)
+			ctx->stats->deadlocks++;
+	}
 	if (!ret) {
 		WARN_ON(!list_empty(&lock->head));
 		list_add(&lock->head, &ctx->locked);
@@ -333,6 +345,9 @@ int drm_modeset_backoff(struct drm_modeset_acquire_ctx *ctx)
 	if (WARN_ON(!contended))
 		return 0;
 
+	if (unlikely(ctx->stats))
+		ctx->stats->backoffs++;
+
 	drm_modeset_drop_locks(ctx);
 
 	return modeset_lock(contended, ctx, ctx->interruptible, true);
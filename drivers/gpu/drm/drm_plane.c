@@ -355,6 +355,7 @@ void drm_plane_cleanup(struct drm_plane *plane)
 	WARN_ON(plane->state && !plane->funcs->atomic_destroy_state);
 	if (plane->state && plane->funcs->atomic_destroy_state)
 		plane->funcs->atomic_destroy_state(plane, plane->state);
+	kfree(xchg(&plane->spare_state, NULL));
 
 	kfree(plane->name);
 
@@ -31,6 +31,8 @@
 
 #include <linux/export.h>
 #include <linux/moduleparam.h>
+#include <linux/slab.h>
+#include <linux/workqueue.h>
 
 #include <drm/drmP.h>
 #include <drm/drm_crtc.h>
@@ -264,25 +266,52 @@ void drm_kms_helper_poll_enable(struct drm_device *dev)
 }
 EXPORT_SYMBOL(drm_kms_helper_poll_enable);
 
+/*
+ * Calls the detect callbacks and records how long they took. Callers
+ * serialize detection of connectors which the poll worker probes
+ * concurrently with their detect_mutex.
+ */
+static int
+drm_helper_connector_detect(struct drm_connector *connector,
+			    struct drm_modeset_acquire_ctx *ctx, bool force)
+{
+	const struct drm_connector_helper_funcs *funcs = connector->helper_private;
+	ktime_t start;
+	u64 elapsed;
+	int ret;
+
+	start = ktime_get();
+	if (funcs->detect_ctx)
+		ret = funcs->detect_ctx(connector, ctx, force);
+	else if (connector->funcs->detect)
+		ret = connector->funcs->detect(connector, force);
+	else
+		ret = connector_status_connected;
+	elapsed = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	WRITE_ONCE(connector->detect_ns, elapsed);
+	if (elapsed > READ_ONCE(connector->detect_max_ns))
+		WRITE_ONCE(connector->detect_max_ns, elapsed);
+
+	return ret;
+}
+
 static enum drm_connector_status
 drm_helper_probe_detect_ctx(struct drm_connector *connector, bool force)
 {
-	const struct drm_connector_helper_funcs *funcs = connector->helper_private;
+	bool parallel = connector->polled & DRM_CONNECTOR_POLL_PARALLEL;
 	struct drm_modeset_acquire_ctx ctx;
 	int ret;
 
+	if (parallel)
+		mutex_lock(&connector->detect_mutex);
+
 	drm_modeset_acquire_init(&ctx, 0);
 
 retry:
 	ret = drm_modeset_lock(&connector->dev->mode_config.connection_mutex, &ctx);
-	if (!ret) {
-		if (funcs->detect_ctx)
-			ret = funcs->detect_ctx(connector, &ctx, force);
-		else if (connector->funcs->detect)
-			ret = connector->funcs->detect(connector, force);
-		else
-			ret = connector_status_connected;
-	}
+	if (!ret)
+		ret = drm_helper_connector_detect(connector, &ctx, force);
 
 	if (ret == -EDEADLK) {
 		drm_modeset_backoff(&ctx);
@@ -295,6 +324,9 @@ retry:
 	drm_modeset_drop_locks(&ctx);
 	drm_modeset_acquire_fini(&ctx);
 
+	if (parallel)
+		mutex_unlock(&connector->detect_mutex);
+
 	return ret;
 }
 
@@ -307,13 +339,15 @@ retry:
  * This function calls the detect callbacks of the connector.
  * This function returns &drm_connector_status, or
  * if @ctx is set, it might also return -EDEADLK.
+ *
+ * Callers passing @ctx for a %DRM_CONNECTOR_POLL_PARALLEL connector must hold
+ * &drm_connector.detect_mutex, without @ctx this function takes it.
  */
 int
 drm_helper_probe_detect(struct drm_connector *connector,
 			struct drm_modeset_acquire_ctx *ctx,
 			bool force)
 {
-	const struct drm_connector_helper_funcs *funcs = connector->helper_private;
 	struct drm_device *dev = connector->dev;
 	int ret;
 
@@ -324,12 +358,7 @@ drm_helper_probe_detect(struct drm_connector *connector,
 	if (ret)
 		return ret;
 
-	if (funcs->detect_ctx)
-		return funcs->detect_ctx(connector, ctx, force);
-	else if (connector->funcs->detect)
-		return connector->funcs->detect(connector, force);
-	else
-		return connector_status_connected;
+	return drm_helper_connector_detect(connector, ctx, force);
 }
 EXPORT_SYMBOL(drm_helper_probe_detect);
 
@@ -403,9 +432,17 @@ int drm_helper_probe_single_connector_modes(struct drm_connector *connector,
 	bool verbose_prune = true;
 	enum drm_connector_status old_status;
 	struct drm_modeset_acquire_ctx ctx;
+	bool parallel = connector->polled & DRM_CONNECTOR_POLL_PARALLEL;
 
 	WARN_ON(!mutex_is_locked(&dev->mode_config.mutex));
 
+	/*
+	 * Keep the output poll worker from detecting this connector until
+	 * get_modes is done with whatever detect left behind, e.g. an EDID.
+	 */
+	if (parallel)
+		mutex_lock(&connector->detect_mutex);
+
 	drm_modeset_acquire_init(&ctx, 0);
 
 	DRM_DEBUG_KMS("[CONNECTOR:%d:%s]\n", connector->base.id,
@@ -526,6 +563,9 @@ prune:
 	drm_modeset_drop_locks(&ctx);
 	drm_modeset_acquire_fini(&ctx);
 
+	if (parallel)
+		mutex_unlock(&connector->detect_mutex);
+
 	if (list_empty(&connector->modes))
 		return 0;
 
@@ -570,13 +610,123 @@ void drm_kms_helper_hotplug_event(struct drm_device *dev)
 }
 EXPORT_SYMBOL(drm_kms_helper_hotplug_event);
 
+/*
+ * Bounded so that a large number of slow connectors doesn't hog the system;
+ * the remaining detect work simply queues up behind the first ones.
+ */
+#define DRM_DETECT_MAX_ACTIVE 4
+
+struct workqueue_struct *drm_kms_helper_detect_wq;
+
+int drm_kms_helper_poll_init_wq(void)
+{
+	drm_kms_helper_detect_wq = alloc_workqueue("drm_detect", WQ_UNBOUND,
+						   DRM_DETECT_MAX_ACTIVE);
+	if (!drm_kms_helper_detect_wq)
+		return -ENOMEM;
+
+	return 0;
+}
+
+void drm_kms_helper_poll_fini_wq(void)
+{
+	destroy_workqueue(drm_kms_helper_detect_wq);
+}
+
+static bool drm_helper_poll_connector(struct drm_connector *connector)
+{
+	/* Ignore forced connectors. */
+	if (connector->force)
+		return false;
+
+	/* Ignore HPD capable connectors and connectors where we don't
+	 * want any hotplug detection at all for polling. */
+	if (!(connector->polled &
+	      (DRM_CONNECTOR_POLL_CONNECT | DRM_CONNECTOR_POLL_DISCONNECT)))
+		return false;
+
+	/* if we are connected and don't want to poll for disconnect
+	   skip it */
+	if (connector->status == connector_status_connected &&
+	    !(connector->polled & DRM_CONNECTOR_POLL_DISCONNECT))
+		return false;
+
+	return true;
+}
+
+static bool drm_helper_poll_parallel(struct drm_connector *connector)
+{
+	const struct drm_connector_helper_funcs *funcs = connector->helper_private;
+
+	return connector->polled & DRM_CONNECTOR_POLL_PARALLEL &&
+	       !WARN_ON_ONCE(funcs->detect_ctx);
+}
+
+/* Returns true if the status of @connector changed. */
+static bool drm_helper_poll_update_status(struct drm_connector *connector,
+					  int status)
+{
+	enum drm_connector_status old_status = connector->status;
+	const char *old, *new;
+
+	if (old_status == status)
+		return false;
+
+	/*
+	 * The poll work sets force=false when calling detect so
+	 * that drivers can avoid to do disruptive tests (e.g.
+	 * when load detect cycles could cause flickering on
+	 * other, running displays). This bears the risk that we
+	 * flip-flop between unknown here in the poll work and
+	 * the real state when userspace forces a full detect
+	 * call after receiving a hotplug event due to this
+	 * change.
+	 *
+	 * Hence clamp an unknown detect status to the old
+	 * value.
+	 */
+	if (status == connector_status_unknown)
+		return false;
+
+	connector->status = status;
+
+	old = drm_get_connector_status_name(old_status);
+	new = drm_get_connector_status_name(connector->status);
+
+	DRM_DEBUG_KMS("[CONNECTOR:%d:%s] "
+		      "status updated from %s to %s\n",
+		      connector->base.id,
+		      connector->name,
+		      old, new);
+
+	return true;
+}
+
+static void output_poll_detect_work(struct work_struct *work)
+{
+	struct drm_connector *connector =
+		container_of(work, struct drm_connector, detect_work);
+
+	mutex_lock(&connector->detect_mutex);
+	connector->detect_status =
+		drm_helper_connector_detect(connector, NULL, false);
+	mutex_unlock(&connector->detect_mutex);
+}
+
+struct drm_helper_poll_detect {
+	struct drm_connector *connector;
+	/* status when the detect work was queued */
+	enum drm_connector_status old_status;
+};
+
 static void output_poll_execute(struct work_struct *work)
 {
 	struct delayed_work *delayed_work = to_delayed_work(work);
 	struct drm_device *dev = container_of(delayed_work, struct drm_device, mode_config.output_poll_work);
+	struct drm_helper_poll_detect *parallel = NULL;
 	struct drm_connector *connector;
 	struct drm_connector_list_iter conn_iter;
-	enum drm_connector_status old_status;
+	unsigned int num_parallel = 0, max_parallel, i;
 	bool repoll = false, changed;
 
 	/* Pick up any changes detected by the probe functions. */
@@ -591,63 +741,82 @@ static void output_poll_execute(struct work_struct *work)
 		goto out;
 	}
 
+	max_parallel = READ_ONCE(dev->mode_config.num_connector);
+	parallel = kcalloc(max_parallel, sizeof(*parallel), GFP_KERNEL);
+	if (!parallel)
+		max_parallel = 0;
+
+	/*
+	 * Kick off detection of connectors which can be detected
+	 * concurrently first, so that they run in parallel with each other
+	 * and with the remaining connectors below.
+	 */
 	drm_connector_list_iter_begin(dev, &conn_iter);
 	drm_for_each_connector_iter(connector, &conn_iter) {
-		/* Ignore forced connectors. */
-		if (connector->force)
+		if (!drm_helper_poll_connector(connector))
 			continue;
 
-		/* Ignore HPD capable connectors and connectors where we don't
-		 * want any hotplug detection at all for polling. */
-		if (!connector->polled || connector->polled == DRM_CONNECTOR_POLL_HPD)
+		repoll = true;
+
+		if (!drm_helper_poll_parallel(connector) ||
+		    num_parallel == max_parallel)
 			continue;
 
-		old_status = connector->status;
-		/* if we are connected and don't want to poll for disconnect
-		   skip it */
-		if (old_status == connector_status_connected &&
-		    !(connector->polled & DRM_CONNECTOR_POLL_DISCONNECT))
+		drm_connector_get(connector);
+		INIT_WORK(&connector->detect_work, output_poll_detect_work);
+		queue_work(drm_kms_helper_detect_wq, &connector->detect_work);
+		parallel[num_parallel].connector = connector;
+		parallel[num_parallel].old_status = connector->status;
+		num_parallel++;
+	}
+	drm_connector_list_iter_end(&conn_iter);
+
+	drm_connector_list_iter_begin(dev, &conn_iter);
+	drm_for_each_connector_iter(connector, &conn_iter) {
+		if (!drm_helper_poll_connector(connector))
 			continue;
 
-		repoll = true;
+		for (i = 0; i < num_parallel; i++)
+			if (parallel[i].connector == connector)
+				break;
+		if (i < num_parallel)
+			continue;
 
-		connector->status = drm_helper_probe_detect(connector, NULL, false);
-		if (old_status != connector->status) {
-			const char *old, *new;
+		if (drm_helper_poll_update_status(connector,
+				drm_helper_probe_detect(connector, NULL, false)))
+			changed = true;
+	}
+	drm_connector_list_iter_end(&conn_iter);
+
+	mutex_unlock(&dev->mode_config.mutex);
+
+	/* Wait for the parallel detection without holding the mutex. */
+	for (i = 0; i < num_parallel; i++)
+		flush_work(&parallel[i].connector->detect_work);
+
+	if (num_parallel) {
+		mutex_lock(&dev->mode_config.mutex);
+		for (i = 0; i < num_parallel; i++) {
+			connector = parallel[i].connector;
 
 			/*
-			 * The poll work sets force=false when calling detect so
-			 * that drivers can avoid to do disruptive tests (e.g.
-			 * when load detect cycles could cause flickering on
-			 * other, running displays). This bears the risk that we
-			 * flip-flop between unknown here in the poll work and
-			 * the real state when userspace forces a full detect
-			 * call after receiving a hotplug event due to this
-			 * change.
-			 *
-			 * Hence clamp an unknown detect status to the old
-			 * value.
+			 * Someone else, e.g. a forced probe from userspace,
+			 * updated the status meanwhile. Their result is at
+			 * least as recent as ours.
 			 */
-			if (connector->status == connector_status_unknown) {
-				connector->status = old_status;
+			if (connector->status != parallel[i].old_status)
 				continue;
-			}
-
-			old = drm_get_connector_status_name(old_status);
-			new = drm_get_connector_status_name(connector->status);
-
-			DRM_DEBUG_KMS("[CONNECTOR:%d:%s] "
-				      "status updated from %s to %s\n",
-				      connector->base.id,
-				      connector->name,
-				      old, new);
 
-			changed = true;
+			if (drm_helper_poll_update_status(connector,
+						connector->detect_status))
+				changed = true;
 		}
+		mutex_unlock(&dev->mode_config.mutex);
 	}
-	drm_connector_list_iter_end(&conn_iter);
 
-	mutex_unlock(&dev->mode_config.mutex);
+	for (i = 0; i < num_parallel; i++)
+		drm_connector_put(parallel[i].connector);
+	kfree(parallel);
 
 out:
 	if (changed)
@@ -667,13 +836,15 @@ out:
  * the autosuspend worker wherein the latter waits for polling to finish
  * upon calling drm_kms_helper_poll_disable(), while the former waits for
  * runtime suspend to finish upon calling pm_runtime_get_sync() in a
- * connector ->detect hook.
+ * connector ->detect hook. The workers detecting %DRM_CONNECTOR_POLL_PARALLEL
+ * connectors count as output poll workers too, since it waits for them.
  */
 bool drm_kms_helper_is_poll_worker(void)
 {
 	struct work_struct *work = current_work();
 
-	return work && work->func == output_poll_execute;
+	return work && (work->func == output_poll_execute ||
+			work->func == output_poll_detect_work);
 }
 EXPORT_SYMBOL(drm_kms_helper_is_poll_worker);
 
@@ -45,6 +45,7 @@ SYSCTL_DECL(_hw_drm);
 
 extern int drm_vblank_offdelay;
 extern unsigned int drm_timestamp_precision;
+extern int drm_vblank_predict;
 
 static int	   drm_name_info DRM_SYSCTL_HANDLER_ARGS;
 static int	   drm_vm_info DRM_SYSCTL_HANDLER_ARGS;
@@ -145,6 +146,10 @@ drm_sysctl_init(struct drm_device *dev)
 	    "timestamp_precision", CTLFLAG_RW, &drm_timestamp_precision,
 	    sizeof(drm_timestamp_precision),
 	    "");
+	SYSCTL_ADD_INT(&info->ctx, SYSCTL_CHILDREN(drioid), OID_AUTO,
+	    "vblank_predict", CTLFLAG_RW, &drm_vblank_predict,
+	    sizeof(drm_vblank_predict),
+	    "");
 
 	return (0);
 }
@@ -64,6 +64,13 @@
  * &drm_driver.max_vblank_count. In that case the vblank core only disables the
  * vblanks after a timer has expired, which can be configured through the
  * ``vblankoffdelay`` module parameter.
+ *
+ * Userspace which only queries the current vblank count and timestamp would
+ * still enable the vblank interrupt every time. For drivers with precise
+ * vblank timestamps the ``vblankpredict`` module parameter allows such queries
+ * to be answered by extrapolating from the last vblank timestamp and the frame
+ * duration computed by drm_calc_timestamping_constants() instead, leaving the
+ * interrupt off until an event actually needs to be delivered.
  */
 
 /* Retry timestamp calculation up to 3 times to satisfy
@@ -82,16 +89,20 @@ drm_get_last_vbltimestamp(struct drm_device *dev, unsigned int pipe,
 #ifdef __linux__
 static unsigned int drm_timestamp_precision = 20;  /* Default to 20 usecs. */
 static int drm_vblank_offdelay = 5000;    /* Default to 5000 msecs. */
+static int drm_vblank_predict = 0;    /* Default to never predict. */
 #else
 /* These are used by drm_sysctl_freebsd.c */
 unsigned int drm_timestamp_precision = 20;  /* Default to 20 usecs. */
 int drm_vblank_offdelay = 5000;    /* Default to 5000 msecs. */
+int drm_vblank_predict = 0;    /* Default to never predict. */
 #endif
 
 module_param_named(vblankoffdelay, drm_vblank_offdelay, int, 0600);
 module_param_named(timestamp_precision_usec, drm_timestamp_precision, int, 0600);
+module_param_named(vblankpredict, drm_vblank_predict, int, 0600);
 MODULE_PARM_DESC(vblankoffdelay, "Delay until vblank irq auto-disable [msecs] (0: never disable, <0: disable immediately)");
 MODULE_PARM_DESC(timestamp_precision_usec, "Max. error on timestamps [usecs]");
+MODULE_PARM_DESC(vblankpredict, "Answer vblank queries without enabling the irq up to this long after the last vblank timestamp [msecs] (0: never)");
 
 static void store_vblank(struct drm_device *dev, unsigned int pipe,
 			 u32 vblank_count_inc,
@@ -444,6 +455,7 @@ int drm_vblank_init(struct drm_device *dev, unsigned int num_crtcs)
 		vblank->dev = dev;
 		vblank->pipe = i;
 		init_waitqueue_head(&vblank->queue);
+		INIT_LIST_HEAD(&vblank->event_list);
 		timer_setup(&vblank->disable_timer, vblank_disable_fn, 0);
 		seqlock_init(&vblank->seqlock);
 	}
@@ -881,12 +893,15 @@ void drm_crtc_arm_vblank_event(struct drm_crtc *crtc,
 {
 	struct drm_device *dev = crtc->dev;
 	unsigned int pipe = drm_crtc_index(crtc);
+	u64 seq;
 
 	assert_spin_locked(&dev->event_lock);
 
+	seq = drm_crtc_accurate_vblank_count(crtc);
+
 	e->pipe = pipe;
-	e->sequence = drm_crtc_accurate_vblank_count(crtc) + 1;
-	list_add_tail(&e->base.link, &dev->vblank_event_list);
+	e->sequence = seq + 1;
+	drm_vblank_event_insert(&dev->vblank[pipe].event_list, e, seq);
 }
 EXPORT_SYMBOL(drm_crtc_arm_vblank_event);
 
@@ -1149,9 +1164,7 @@ void drm_crtc_vblank_off(struct drm_crtc *crtc)
 	/* Send any queued vblank events, lest the natives grow disquiet */
 	seq = drm_vblank_count_and_time(dev, pipe, &now);
 
-	list_for_each_entry_safe(e, t, &dev->vblank_event_list, base.link) {
-		if (e->pipe != pipe)
-			continue;
+	list_for_each_entry_safe(e, t, &vblank->event_list, base.link) {
 		DRM_DEBUG("Sending premature vblank event on disable: "
 			  "wanted %llu, current %llu\n",
 			  e->sequence, seq);
@@ -1197,7 +1210,7 @@ void drm_crtc_vblank_reset(struct drm_crtc *crtc)
 	}
 	spin_unlock_irqrestore(&dev->vbl_lock, irqflags);
 
-	WARN_ON(!list_empty(&dev->vblank_event_list));
+	WARN_ON(!list_empty(&vblank->event_list));
 }
 EXPORT_SYMBOL(drm_crtc_vblank_reset);
 
@@ -1326,11 +1339,6 @@ int drm_legacy_modeset_ctl_ioctl(struct drm_device *dev, void *data,
 	return 0;
 }
 
-static inline bool vblank_passed(u64 seq, u64 ref)
-{
-	return (seq - ref) <= (1 << 23);
-}
-
 static int drm_queue_vblank_event(struct drm_device *dev, unsigned int pipe,
 				  u64 req_seq,
 				  union drm_wait_vblank *vblwait,
@@ -1387,13 +1395,13 @@ static int drm_queue_vblank_event(struct drm_device *dev, unsigned int pipe,
 	trace_drm_vblank_event_queued(file_priv, pipe, req_seq);
 
 	e->sequence = req_seq;
-	if (vblank_passed(seq, req_seq)) {
+	if (drm_vblank_passed(seq, req_seq)) {
 		drm_vblank_put(dev, pipe);
 		send_vblank_event(dev, e, seq, now);
 		vblwait->reply.sequence = seq;
 	} else {
 		/* drm_handle_vblank_events will call drm_vblank_put */
-		list_add_tail(&e->base.link, &dev->vblank_event_list);
+		drm_vblank_event_insert(&vblank->event_list, e, seq);
 		vblwait->reply.sequence = req_seq;
 	}
 
@@ -1409,6 +1417,58 @@ err_put:
 	return ret;
 }
 
+/*
+ * Extrapolate the current vblank count and the timestamp of the last vblank
+ * from the last recorded vblank and the frame duration, for queries that
+ * would otherwise need to enable the vblank interrupt just to sample them.
+ *
+ * Only done for pipes which are on and whose last timestamp came from a
+ * precise &drm_driver.get_vblank_timestamp, and for at most
+ * ``vblankpredict`` msecs since that timestamp to bound the error from the
+ * nominal frame duration drifting against the real one. Rounding down means a
+ * prediction near the end of a frame errs towards the earlier vblank, which
+ * the next real update of the counter can only move forward from.
+ */
+static bool drm_vblank_predict_count_and_time(struct drm_device *dev,
+					      unsigned int pipe,
+					      u64 *seq, ktime_t *vblanktime)
+{
+	struct drm_vblank_crtc *vblank = &dev->vblank[pipe];
+	int framedur_ns = READ_ONCE(vblank->framedur_ns);
+	int max_age_ms = READ_ONCE(drm_vblank_predict);
+	unsigned int cur_seq;
+	ktime_t last, now;
+	u64 count, frames;
+	s64 age_ns;
+
+	if (max_age_ms <= 0 || framedur_ns <= 0 ||
+	    !dev->driver->get_vblank_timestamp ||
+	    READ_ONCE(vblank->inmodeset))
+		return false;
+
+	do {
+		cur_seq = read_seqbegin(&vblank->seqlock);
+		count = vblank->count;
+		last = vblank->time;
+	} while (read_seqretry(&vblank->seqlock, cur_seq));
+
+	/* A zero timestamp means the last one was not accurate */
+	if (!last)
+		return false;
+
+	now = ktime_get();
+	age_ns = ktime_to_ns(ktime_sub(now, last));
+	if (age_ns < 0 || age_ns > (s64)max_age_ms * NSEC_PER_MSEC)
+		return false;
+
+	frames = div_u64(age_ns, framedur_ns);
+
+	*seq = count + frames;
+	*vblanktime = ktime_add_ns(last, frames * framedur_ns);
+
+	return true;
+}
+
 static bool drm_wait_vblank_is_query(union drm_wait_vblank *vblwait)
 {
 	if (vblwait->request.sequence)
@@ -1436,10 +1496,9 @@ static u64 widen_32_to_64(u32 narrow, u64 near)
 	return near + (s32) (narrow - near);
 }
 
-static void drm_wait_vblank_reply(struct drm_device *dev, unsigned int pipe,
-				  struct drm_wait_vblank_reply *reply)
+static void drm_wait_vblank_time_reply(u64 seq, ktime_t now,
+				       struct drm_wait_vblank_reply *reply)
 {
-	ktime_t now;
 	struct timespec64 ts;
 
 	/*
@@ -1447,12 +1506,22 @@ static void drm_wait_vblank_reply(struct drm_device *dev, unsigned int pipe,
 	 * to store the seconds. This is safe as we always use monotonic
 	 * timestamps since linux-4.15.
 	 */
-	reply->sequence = drm_vblank_count_and_time(dev, pipe, &now);
+	reply->sequence = seq;
 	ts = ktime_to_timespec64(now);
 	reply->tval_sec = (u32)ts.tv_sec;
 	reply->tval_usec = ts.tv_nsec / 1000;
 }
 
+static void drm_wait_vblank_reply(struct drm_device *dev, unsigned int pipe,
+				  struct drm_wait_vblank_reply *reply)
+{
+	ktime_t now;
+	u64 seq;
+
+	seq = drm_vblank_count_and_time(dev, pipe, &now);
+	drm_wait_vblank_time_reply(seq, now, reply);
+}
+
 int drm_wait_vblank_ioctl(struct drm_device *dev, void *data,
 			  struct drm_file *file_priv)
 {
@@ -1517,6 +1586,16 @@ int drm_wait_vblank_ioctl(struct drm_device *dev, void *data,
 		return 0;
 	}
 
+	/* Otherwise see if the answer can be predicted with the irq off. */
+	if (drm_wait_vblank_is_query(vblwait) && !READ_ONCE(vblank->enabled)) {
+		ktime_t now;
+
+		if (drm_vblank_predict_count_and_time(dev, pipe, &seq, &now)) {
+			drm_wait_vblank_time_reply(seq, now, &vblwait->reply);
+			return 0;
+		}
+	}
+
 	ret = drm_vblank_get(dev, pipe);
 	if (ret) {
 		DRM_DEBUG("crtc %d failed to acquire vblank counter, %d\n", pipe, ret);
@@ -1539,7 +1618,7 @@ int drm_wait_vblank_ioctl(struct drm_device *dev, void *data,
 	}
 
 	if ((flags & _DRM_VBLANK_NEXTONMISS) &&
-	    vblank_passed(seq, req_seq)) {
+	    drm_vblank_passed(seq, req_seq)) {
 		req_seq = seq + 1;
 		vblwait->request.type &= ~_DRM_VBLANK_NEXTONMISS;
 		vblwait->request.sequence = req_seq;
@@ -1556,8 +1635,8 @@ int drm_wait_vblank_ioctl(struct drm_device *dev, void *data,
 		DRM_DEBUG("waiting on vblank count %llu, crtc %u\n",
 			  req_seq, pipe);
 		DRM_WAIT_ON(ret, vblank->queue, 3 * HZ,
-			    vblank_passed(drm_vblank_count(dev, pipe),
-					  req_seq) ||
+			    drm_vblank_passed(drm_vblank_count(dev, pipe),
+					      req_seq) ||
 			    !READ_ONCE(vblank->enabled));
 	}
 
@@ -1577,7 +1656,8 @@ done:
 
 static void drm_handle_vblank_events(struct drm_device *dev, unsigned int pipe)
 {
-	struct drm_pending_vblank_event *e, *t;
+	struct drm_vblank_crtc *vblank = &dev->vblank[pipe];
+	struct drm_pending_vblank_event *e;
 	ktime_t now;
 	u64 seq;
 
@@ -1585,12 +1665,8 @@ static void drm_handle_vblank_events(struct drm_device *dev, unsigned int pipe)
 
 	seq = drm_vblank_count_and_time(dev, pipe, &now);
 
-	list_for_each_entry_safe(e, t, &dev->vblank_event_list, base.link) {
-		if (e->pipe != pipe)
-			continue;
-		if (!vblank_passed(seq, e->sequence))
-			continue;
-
+	/* The queue is sorted, so this only ever looks at due events */
+	while ((e = drm_vblank_event_next_due(&vblank->event_list, seq))) {
 		DRM_DEBUG("vblank event on %llu, current %llu\n",
 			  e->sequence, seq);
 
@@ -1699,7 +1775,8 @@ int drm_crtc_get_sequence_ioctl(struct drm_device *dev, void *data,
 	int pipe;
 	struct drm_crtc_get_sequence *get_seq = data;
 	ktime_t now;
-	bool vblank_enabled;
+	bool vblank_enabled, predicted;
+	u64 seq;
 	int ret;
 
 	if (!drm_core_check_feature(dev, DRIVER_MODESET))
@@ -1716,8 +1793,10 @@ int drm_crtc_get_sequence_ioctl(struct drm_device *dev, void *data,
 
 	vblank = &dev->vblank[pipe];
 	vblank_enabled = dev->vblank_disable_immediate && READ_ONCE(vblank->enabled);
+	predicted = !READ_ONCE(vblank->enabled) &&
+		drm_vblank_predict_count_and_time(dev, pipe, &seq, &now);
 
-	if (!vblank_enabled) {
+	if (!vblank_enabled && !predicted) {
 		ret = drm_crtc_vblank_get(crtc);
 		if (ret) {
 			DRM_DEBUG("crtc %d failed to acquire vblank counter, %d\n", pipe, ret);
@@ -1730,9 +1809,11 @@ int drm_crtc_get_sequence_ioctl(struct drm_device *dev, void *data,
 	else
 		get_seq->active = crtc->enabled;
 	drm_modeset_unlock(&crtc->mutex);
-	get_seq->sequence = drm_vblank_count_and_time(dev, pipe, &now);
+	if (!predicted)
+		seq = drm_vblank_count_and_time(dev, pipe, &now);
+	get_seq->sequence = seq;
 	get_seq->sequence_ns = ktime_to_ns(now);
-	if (!vblank_enabled)
+	if (!vblank_enabled && !predicted)
 		drm_crtc_vblank_put(crtc);
 	return 0;
 }
@@ -1796,7 +1877,7 @@ int drm_crtc_queue_sequence_ioctl(struct drm_device *dev, void *data,
 	if (flags & DRM_CRTC_SEQUENCE_RELATIVE)
 		req_seq += seq;
 
-	if ((flags & DRM_CRTC_SEQUENCE_NEXT_ON_MISS) && vblank_passed(seq, req_seq))
+	if ((flags & DRM_CRTC_SEQUENCE_NEXT_ON_MISS) && drm_vblank_passed(seq, req_seq))
 		req_seq = seq + 1;
 
 	e->pipe = pipe;
@@ -1825,13 +1906,13 @@ int drm_crtc_queue_sequence_ioctl(struct drm_device *dev, void *data,
 
 	e->sequence = req_seq;
 
-	if (vblank_passed(seq, req_seq)) {
+	if (drm_vblank_passed(seq, req_seq)) {
 		drm_crtc_vblank_put(crtc);
 		send_vblank_event(dev, e, seq, now);
 		queue_seq->sequence = seq;
 	} else {
 		/* drm_handle_vblank_events will call drm_vblank_put */
-		list_add_tail(&e->base.link, &dev->vblank_event_list);
+		drm_vblank_event_insert(&vblank->event_list, e, seq);
 		queue_seq->sequence = req_seq;
 	}
 
@@ -3304,6 +3304,57 @@ static int i915_shrinker_info(struct seq_file *m, void *unused)
 	return 0;
 }
 
+static int i915_gem_clflush_info(struct seq_file *m, void *unused)
+{
+	struct drm_i915_private *i915 = node_to_i915(m->private);
+	struct i915_clflush_stats *stats = &i915->mm.clflush_stats;
+	u64 jobs = atomic64_read(&stats->jobs);
+	u64 time_ns = atomic64_read(&stats->time_ns);
+
+	seq_printf(m, "jobs = %llu\n", jobs);
+	seq_printf(m, "objects = %llu\n", (u64)atomic64_read(&stats->objects));
+	seq_printf(m, "bytes = %llu\n", (u64)atomic64_read(&stats->bytes));
+	seq_printf(m, "time = %llu ns\n", time_ns);
+	seq_printf(m, "avg latency = %llu ns\n",
+		   jobs ? div64_u64(time_ns, jobs) : 0);
+
+	return 0;
+}
+
+static int i915_gem_fault_info(struct seq_file *m, void *unused)
+{
+	struct drm_i915_private *i915 = node_to_i915(m->private);
+	struct i915_fault_stats *stats = &i915->mm.fault_stats;
+	u64 hits = READ_ONCE(stats->partial_hits);
+	u64 misses = READ_ONCE(stats->partial_misses);
+
+	seq_printf(m, "partial view hits = %llu\n", hits);
+	seq_printf(m, "partial view misses = %llu\n", misses);
+	seq_printf(m, "partial view hit rate = %llu%%\n",
+		   hits + misses ? div64_u64(100 * hits, hits + misses) : 0);
+	seq_printf(m, "aperture evictions = %llu\n",
+		   READ_ONCE(stats->aperture_evictions));
+
+	return 0;
+}
+
+static int i915_gem_userptr_info(struct seq_file *m, void *unused)
+{
+	struct drm_i915_private *i915 = node_to_i915(m->private);
+	struct i915_userptr_stats *stats = &i915->mm.userptr_stats;
+	u64 cancels = atomic64_read(&stats->cancels);
+	u64 objects = atomic64_read(&stats->objects);
+
+	seq_printf(m, "invalidations = %llu\n",
+		   (u64)atomic64_read(&stats->invalidations));
+	seq_printf(m, "cancels = %llu\n", cancels);
+	seq_printf(m, "objects = %llu\n", objects);
+	seq_printf(m, "avg objects per cancel = %llu\n",
+		   cancels ? div64_u64(objects, cancels) : 0);
+
+	return 0;
+}
+
 static int i915_shared_dplls_info(struct seq_file *m, void *unused)
 {
 	struct drm_i915_private *dev_priv = node_to_i915(m->private);
@@ -4830,6 +4881,9 @@ static const struct drm_info_list i915_debugfs_list[] = {
 	{"i915_display_info", i915_display_info, 0},
 	{"i915_engine_info", i915_engine_info, 0},
 	{"i915_shrinker_info", i915_shrinker_info, 0},
+	{"i915_gem_clflush", i915_gem_clflush_info, 0},
+	{"i915_gem_userptr", i915_gem_userptr_info, 0},
+	{"i915_gem_fault", i915_gem_fault_info, 0},
 	{"i915_shared_dplls_info", i915_shared_dplls_info, 0},
 	{"i915_dp_mst_info", i915_dp_mst_info, 0},
 	{"i915_wa_registers", i915_wa_registers, 0},
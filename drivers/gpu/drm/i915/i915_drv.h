@@ -476,6 +476,7 @@ struct i915_gpu_state {
 		struct intel_uc_fw guc_fw;
 		struct intel_uc_fw huc_fw;
 		struct drm_i915_error_object *guc_log;
+		struct work_struct compress_work;
 	} uc;
 
 	/* Generic register state */
@@ -569,6 +570,9 @@ struct i915_gpu_state {
 		struct drm_i915_error_object *wa_ctx;
 		struct drm_i915_error_object *default_state;
 
+		/* deferred compression of the objects above, see capture */
+		struct work_struct compress_work;
+
 		struct drm_i915_error_request {
 			long jiffies;
 			pid_t pid;
@@ -1118,6 +1122,31 @@ struct i915_gem_mm {
 	 */
 	struct workqueue_struct *userptr_wq;
 
+	/**
+	 * Accounting of partial GGTT views bound by GTT mmap faults and of
+	 * vma evicted from the mappable aperture, protected by struct_mutex
+	 */
+	struct i915_fault_stats {
+		u64 partial_hits;
+		u64 partial_misses;
+		u64 aperture_evictions;
+	} fault_stats;
+
+	/** Accounting of userptr mmu notifier invalidations */
+	struct i915_userptr_stats {
+		atomic64_t invalidations;
+		atomic64_t cancels;
+		atomic64_t objects;
+	} userptr_stats;
+
+	/** Accounting of CPU cache flushes, see i915_gem_clflush.c */
+	struct i915_clflush_stats {
+		atomic64_t jobs;
+		atomic64_t objects;
+		atomic64_t bytes;
+		atomic64_t time_ns;
+	} clflush_stats;
+
 	u64 unordered_timeline;
 
 	/* the indicator for dispatch video commands on two BSD rings */
@@ -1980,6 +2009,9 @@ struct drm_i915_private {
 	 */
 	struct workqueue_struct *wq;
 
+	/* unbound wq for flushing large objects of a clflush batch in parallel */
+	struct workqueue_struct *clflush_wq;
+
 	/* ordered wq for modesets */
 	struct workqueue_struct *modeset_wq;
 
@@ -3619,7 +3651,7 @@ static inline void intel_display_crc_init(struct drm_i915_private *dev_priv) {}
 __printf(2, 3)
 void i915_error_printf(struct drm_i915_error_state_buf *e, const char *f, ...);
 int i915_error_state_to_str(struct drm_i915_error_state_buf *estr,
-			    const struct i915_gpu_state *gpu);
+			    struct i915_gpu_state *gpu);
 int i915_error_state_buf_init(struct drm_i915_error_state_buf *eb,
 			      struct drm_i915_private *i915,
 			      size_t count, loff_t pos);
@@ -2050,13 +2050,31 @@ int i915_gem_fault(struct vm_area_struct *dummy, struct vm_fault *vmf)
 		 */
 		obj->frontbuffer_ggtt_origin = ORIGIN_CPU;
 
-		vma = i915_gem_object_ggtt_pin(obj, &view, 0, 0, PIN_MAPPABLE);
+		/* Note whether an earlier fault left this chunk bound */
+		vma = i915_vma_instance(obj, &ggtt->base, &view);
+		if (!IS_ERR(vma)) {
+			if (vma->flags & I915_VMA_GLOBAL_BIND)
+				dev_priv->mm.fault_stats.partial_hits++;
+			else
+				dev_priv->mm.fault_stats.partial_misses++;
+
+			vma = i915_gem_object_ggtt_pin(obj, &view, 0, 0,
+						       PIN_MAPPABLE);
+		}
 	}
 	if (IS_ERR(vma)) {
 		ret = PTR_ERR(vma);
 		goto err_unlock;
 	}
 
+	/*
+	 * Keep the aperture in LRU order of faulting, so that when it is
+	 * exhausted we evict the chunks which userspace has not touched for
+	 * the longest time, rather than those it is still working through.
+	 */
+	if (!i915_vma_is_active(vma))
+		list_move_tail(&vma->vm_link, &ggtt->base.inactive_list);
+
 	ret = i915_gem_object_set_to_gtt_domain(obj, write);
 	if (ret)
 		goto err_unpin;
@@ -28,11 +28,24 @@
 
 static DEFINE_SPINLOCK(clflush_lock);
 
+/*
+ * Objects at least this large are flushed from their own work item, so that
+ * a batch containing several of them is spread over multiple CPUs.
+ */
+#define I915_CLFLUSH_PARALLEL_SIZE SZ_2M
+
+struct clflush_obj {
+	struct work_struct work;
+	struct drm_i915_gem_object *obj;
+};
+
 struct clflush {
 	struct dma_fence dma; /* Must be first for dma_fence_free() */
 	struct i915_sw_fence wait;
 	struct work_struct work;
-	struct drm_i915_gem_object *obj;
+	struct drm_i915_private *i915;
+	unsigned int count;
+	struct clflush_obj objects[0];
 };
 
 static const char *i915_clflush_get_driver_name(struct dma_fence *fence)
@@ -68,6 +81,18 @@ static const struct dma_fence_ops i915_clflush_ops = {
 	.release = i915_clflush_release,
 };
 
+static void clflush_stats_add(struct drm_i915_private *i915,
+			      unsigned int count, u64 bytes, ktime_t start)
+{
+	struct i915_clflush_stats *stats = &i915->mm.clflush_stats;
+
+	atomic64_inc(&stats->jobs);
+	atomic64_add(count, &stats->objects);
+	atomic64_add(bytes, &stats->bytes);
+	atomic64_add(ktime_to_ns(ktime_sub(ktime_get(), start)),
+		     &stats->time_ns);
+}
+
 static void __i915_do_clflush(struct drm_i915_gem_object *obj)
 {
 	GEM_BUG_ON(!i915_gem_object_has_pages(obj));
@@ -75,22 +100,54 @@ static void __i915_do_clflush(struct drm_i915_gem_object *obj)
 	intel_fb_obj_flush(obj, ORIGIN_CPU);
 }
 
-static void i915_clflush_work(struct work_struct *work)
+static void i915_clflush_obj_work(struct work_struct *work)
 {
-	struct clflush *clflush = container_of(work, typeof(*clflush), work);
-	struct drm_i915_gem_object *obj = clflush->obj;
+	struct clflush_obj *c = container_of(work, typeof(*c), work);
+	struct drm_i915_gem_object *obj = c->obj;
 
 	if (i915_gem_object_pin_pages(obj)) {
 		DRM_ERROR("Failed to acquire obj->pages for clflushing\n");
-		goto out;
+		return;
 	}
 
 	__i915_do_clflush(obj);
 
 	i915_gem_object_unpin_pages(obj);
+}
+
+static void i915_clflush_work(struct work_struct *work)
+{
+	struct clflush *clflush = container_of(work, typeof(*clflush), work);
+	ktime_t start = ktime_get();
+	u64 bytes = 0;
+	unsigned int n;
+
+	/*
+	 * Small objects are cheaper to flush inline than to schedule, but
+	 * when the batch contains more than one large object we farm those
+	 * out to our own unbound workqueue to flush them in parallel. We run
+	 * from the system workqueue, which may have too few threads to run
+	 * them as well while we wait for them.
+	 */
+	for (n = 0; n < clflush->count; n++) {
+		struct clflush_obj *c = &clflush->objects[n];
+
+		bytes += c->obj->base.size;
+		if (clflush->count > 1 &&
+		    c->obj->base.size >= I915_CLFLUSH_PARALLEL_SIZE)
+			queue_work(clflush->i915->clflush_wq, &c->work);
+		else
+			i915_clflush_obj_work(&c->work);
+	}
+
+	for (n = 0; n < clflush->count; n++) {
+		struct clflush_obj *c = &clflush->objects[n];
 
-out:
-	i915_gem_object_put(obj);
+		flush_work(&c->work);
+		i915_gem_object_put(c->obj);
+	}
+
+	clflush_stats_add(clflush->i915, clflush->count, bytes, start);
 
 	dma_fence_signal(&clflush->dma);
 	dma_fence_put(&clflush->dma);
@@ -115,11 +172,73 @@ i915_clflush_notify(struct i915_sw_fence *fence,
 	return NOTIFY_DONE;
 }
 
-bool i915_gem_clflush_object(struct drm_i915_gem_object *obj,
-			     unsigned int flags)
+static struct clflush *
+clflush_create(struct drm_i915_private *i915, unsigned int max)
 {
 	struct clflush *clflush;
 
+	clflush = kmalloc(sizeof(*clflush) + max * sizeof(*clflush->objects),
+			  GFP_KERNEL);
+	if (!clflush)
+		return NULL;
+
+	dma_fence_init(&clflush->dma,
+		       &i915_clflush_ops,
+		       &clflush_lock,
+		       i915->mm.unordered_timeline,
+		       0);
+	i915_sw_fence_init(&clflush->wait, i915_clflush_notify);
+
+	INIT_WORK(&clflush->work, i915_clflush_work);
+	clflush->i915 = i915;
+	clflush->count = 0;
+
+	dma_fence_get(&clflush->dma);
+
+	return clflush;
+}
+
+static void clflush_add(struct clflush *clflush,
+			struct drm_i915_gem_object *obj)
+{
+	struct clflush_obj *c = &clflush->objects[clflush->count++];
+
+	GEM_BUG_ON(!obj->cache_dirty);
+
+	INIT_WORK(&c->work, i915_clflush_obj_work);
+	c->obj = i915_gem_object_get(obj);
+}
+
+static void clflush_commit(struct clflush *clflush)
+{
+	unsigned int n;
+
+	/*
+	 * Wait upon every object before publishing our fence on any of them,
+	 * as objects may share a reservation (e.g. imported dma-bufs) and we
+	 * must not end up waiting upon ourselves.
+	 */
+	for (n = 0; n < clflush->count; n++)
+		i915_sw_fence_await_reservation(&clflush->wait,
+						clflush->objects[n].obj->resv,
+						NULL,
+						true, I915_FENCE_TIMEOUT,
+						I915_FENCE_GFP);
+
+	for (n = 0; n < clflush->count; n++) {
+		struct reservation_object *resv = clflush->objects[n].obj->resv;
+
+		reservation_object_lock(resv, NULL);
+		reservation_object_add_excl_fence(resv, &clflush->dma);
+		reservation_object_unlock(resv);
+	}
+
+	i915_sw_fence_commit(&clflush->wait);
+}
+
+static bool clflush_needed(struct drm_i915_gem_object *obj,
+			   unsigned int flags)
+{
 	/*
 	 * Stolen memory is always coherent with the GPU as it is explicitly
 	 * marked as wc by the system, or the system is cache-coherent.
@@ -144,42 +263,101 @@ bool i915_gem_clflush_object(struct drm_i915_gem_object *obj,
 	    obj->cache_coherent & I915_BO_CACHE_COHERENT_FOR_READ)
 		return false;
 
+	return true;
+}
+
+bool i915_gem_clflush_object(struct drm_i915_gem_object *obj,
+			     unsigned int flags)
+{
+	struct clflush *clflush;
+
+	if (!clflush_needed(obj, flags))
+		return false;
+
 	trace_i915_gem_object_clflush(obj);
 
 	clflush = NULL;
 	if (!(flags & I915_CLFLUSH_SYNC))
-		clflush = kmalloc(sizeof(*clflush), GFP_KERNEL);
+		clflush = clflush_create(to_i915(obj->base.dev), 1);
 	if (clflush) {
-		GEM_BUG_ON(!obj->cache_dirty);
+		clflush_add(clflush, obj);
+		clflush_commit(clflush);
+	} else if (obj->mm.pages) {
+		ktime_t start = ktime_get();
+
+		__i915_do_clflush(obj);
+		clflush_stats_add(to_i915(obj->base.dev),
+				  1, obj->base.size, start);
+	} else {
+		GEM_BUG_ON(obj->base.write_domain != I915_GEM_DOMAIN_CPU);
+	}
+
+	obj->cache_dirty = false;
+	return true;
+}
 
-		dma_fence_init(&clflush->dma,
-			       &i915_clflush_ops,
-			       &clflush_lock,
-			       to_i915(obj->base.dev)->mm.unordered_timeline,
-			       0);
-		i915_sw_fence_init(&clflush->wait, i915_clflush_notify);
+/**
+ * i915_gem_clflush_batch_init - prepare to flush a set of objects together
+ * @batch: the batch to initialise
+ * @i915: the device
+ * @max: the maximum number of objects that will be added to the batch
+ *
+ * Objects added to the batch with i915_gem_clflush_batch_add() are flushed
+ * by a single asynchronous job with a single fence, rather than one job and
+ * one fence per object. The job is only allocated once the first object
+ * requiring a flush is added.
+ */
+void i915_gem_clflush_batch_init(struct i915_clflush_batch *batch,
+				 struct drm_i915_private *i915,
+				 unsigned int max)
+{
+	batch->i915 = i915;
+	batch->clflush = NULL;
+	batch->max = max;
+}
 
-		clflush->obj = i915_gem_object_get(obj);
-		INIT_WORK(&clflush->work, i915_clflush_work);
+/**
+ * i915_gem_clflush_batch_add - queue an object for flushing
+ * @batch: the batch
+ * @obj: the object to flush
+ *
+ * Returns true if the object will be flushed, with the same semantics as
+ * i915_gem_clflush_object(). The flush is not ordered against the object
+ * until i915_gem_clflush_batch_commit() is called.
+ */
+bool i915_gem_clflush_batch_add(struct i915_clflush_batch *batch,
+				struct drm_i915_gem_object *obj)
+{
+	if (!clflush_needed(obj, 0))
+		return false;
 
-		dma_fence_get(&clflush->dma);
+	if (!batch->clflush)
+		batch->clflush = clflush_create(batch->i915, batch->max);
+	if (!batch->clflush)
+		return i915_gem_clflush_object(obj, I915_CLFLUSH_SYNC);
 
-		i915_sw_fence_await_reservation(&clflush->wait,
-						obj->resv, NULL,
-						true, I915_FENCE_TIMEOUT,
-						I915_FENCE_GFP);
+	GEM_BUG_ON(batch->clflush->count >= batch->max);
 
-		reservation_object_lock(obj->resv, NULL);
-		reservation_object_add_excl_fence(obj->resv, &clflush->dma);
-		reservation_object_unlock(obj->resv);
+	trace_i915_gem_object_clflush(obj);
 
-		i915_sw_fence_commit(&clflush->wait);
-	} else if (obj->mm.pages) {
-		__i915_do_clflush(obj);
-	} else {
-		GEM_BUG_ON(obj->base.write_domain != I915_GEM_DOMAIN_CPU);
-	}
+	clflush_add(batch->clflush, obj);
 
 	obj->cache_dirty = false;
 	return true;
 }
+
+/**
+ * i915_gem_clflush_batch_commit - submit the batched flush
+ * @batch: the batch
+ *
+ * Installs the flush fence as the exclusive fence on every object in the
+ * batch, after which the objects may be waited upon as usual.
+ */
+void i915_gem_clflush_batch_commit(struct i915_clflush_batch *batch)
+{
+	if (!batch->clflush)
+		return;
+
+	clflush_commit(batch->clflush);
+	batch->clflush = NULL;
+}
@@ -27,10 +27,24 @@
 
 struct drm_i915_private;
 struct drm_i915_gem_object;
+struct clflush;
 
 bool i915_gem_clflush_object(struct drm_i915_gem_object *obj,
 			     unsigned int flags);
 #define I915_CLFLUSH_FORCE BIT(0)
 #define I915_CLFLUSH_SYNC BIT(1)
 
+struct i915_clflush_batch {
+	struct drm_i915_private *i915;
+	struct clflush *clflush;
+	unsigned int max;
+};
+
+void i915_gem_clflush_batch_init(struct i915_clflush_batch *batch,
+				 struct drm_i915_private *i915,
+				 unsigned int max);
+bool i915_gem_clflush_batch_add(struct i915_clflush_batch *batch,
+				struct drm_i915_gem_object *obj);
+void i915_gem_clflush_batch_commit(struct i915_clflush_batch *batch);
+
 #endif /* __I915_GEM_CLFLUSH_H__ */
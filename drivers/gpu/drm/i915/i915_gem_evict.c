@@ -93,6 +93,21 @@ mark_free(struct drm_mm_scan *scan,
 	return drm_mm_scan_add_block(scan, &vma->node);
 }
 
+static int evict_vma(struct i915_vma *vma)
+{
+	bool mappable;
+	int ret;
+
+	mappable = i915_vma_is_ggtt(vma) &&
+		vma->node.start < i915_vm_to_ggtt(vma->vm)->mappable_end;
+
+	ret = i915_vma_unbind(vma);
+	if (ret == 0 && mappable)
+		vma->vm->i915->mm.fault_stats.aperture_evictions++;
+
+	return ret;
+}
+
 /**
  * i915_gem_evict_something - Evict vmas to make room for binding a new one
  * @vm: address space to evict from
@@ -247,12 +262,12 @@ found:
 	list_for_each_entry_safe(vma, next, &eviction_list, evict_link) {
 		__i915_vma_unpin(vma);
 		if (ret == 0)
-			ret = i915_vma_unbind(vma);
+			ret = evict_vma(vma);
 	}
 
 	while (ret == 0 && (node = drm_mm_scan_color_evict(&scan))) {
 		vma = container_of(node, struct i915_vma, node);
-		ret = i915_vma_unbind(vma);
+		ret = evict_vma(vma);
 	}
 
 	return ret;
@@ -368,7 +383,7 @@ int i915_gem_evict_for_node(struct i915_address_space *vm,
 	list_for_each_entry_safe(vma, next, &eviction_list, evict_link) {
 		__i915_vma_unpin(vma);
 		if (ret == 0)
-			ret = i915_vma_unbind(vma);
+			ret = evict_vma(vma);
 	}
 
 	return ret;
@@ -427,7 +442,7 @@ int i915_gem_evict_vm(struct i915_address_space *vm)
 	list_for_each_entry_safe(vma, next, &eviction_list, evict_link) {
 		__i915_vma_unpin(vma);
 		if (ret == 0)
-			ret = i915_vma_unbind(vma);
+			ret = evict_vma(vma);
 	}
 	return ret;
 }
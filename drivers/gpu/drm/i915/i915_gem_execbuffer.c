@@ -1764,20 +1764,35 @@ static void eb_export_fence(struct i915_vma *vma,
 static int eb_move_to_gpu(struct i915_execbuffer *eb)
 {
 	const unsigned int count = eb->buffer_count;
-	unsigned int i;
-	int err;
+	struct i915_clflush_batch clflush;
+	unsigned int i, dirty = 0;
+	int err = 0;
 
+	/*
+	 * Collect all the objects that need their CPU cache flushing into
+	 * a single asynchronous job, rather than one per object. Only size
+	 * the job for those that may need it, usually there are none.
+	 */
+	for (i = 0; i < count; i++) {
+		struct drm_i915_gem_object *obj = eb->vma[i]->obj;
+
+		if (unlikely(obj->cache_dirty & ~obj->cache_coherent))
+			dirty++;
+	}
+
+	i915_gem_clflush_batch_init(&clflush, eb->i915, dirty);
 	for (i = 0; i < count; i++) {
-		unsigned int flags = eb->flags[i];
 		struct i915_vma *vma = eb->vma[i];
 		struct drm_i915_gem_object *obj = vma->obj;
 
-		if (flags & EXEC_OBJECT_CAPTURE) {
+		if (eb->flags[i] & EXEC_OBJECT_CAPTURE) {
 			struct i915_gem_capture_list *capture;
 
 			capture = kmalloc(sizeof(*capture), GFP_KERNEL);
-			if (unlikely(!capture))
-				return -ENOMEM;
+			if (unlikely(!capture)) {
+				err = -ENOMEM;
+				break;
+			}
 
 			capture->next = eb->request->capture_list;
 			capture->vma = eb->vma[i];
@@ -1797,15 +1812,22 @@ static int eb_move_to_gpu(struct i915_execbuffer *eb)
 		 * two jumps instead of one. Maybe one day...
 		 */
 		if (unlikely(obj->cache_dirty & ~obj->cache_coherent)) {
-			if (i915_gem_clflush_object(obj, 0))
-				flags &= ~EXEC_OBJECT_ASYNC;
+			if (i915_gem_clflush_batch_add(&clflush, obj))
+				eb->flags[i] &= ~EXEC_OBJECT_ASYNC;
 		}
+	}
+	i915_gem_clflush_batch_commit(&clflush);
+	if (err)
+		return err;
+
+	for (i = 0; i < count; i++) {
+		unsigned int flags = eb->flags[i];
 
 		if (flags & EXEC_OBJECT_ASYNC)
 			continue;
 
 		err = i915_gem_request_await_object
-			(eb->request, obj, flags & EXEC_OBJECT_WRITE);
+			(eb->request, eb->vma[i]->obj, flags & EXEC_OBJECT_WRITE);
 		if (err)
 			return err;
 	}
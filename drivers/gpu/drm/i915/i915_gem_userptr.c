@@ -50,7 +50,10 @@ struct i915_mmu_notifier {
 	struct hlist_node node;
 	struct mmu_notifier mn;
 	struct rb_root_cached objects;
+	/* bounds of all objects in the tree, protected by lock */
+	unsigned long start, last;
 	struct workqueue_struct *wq;
+	struct drm_i915_private *i915;
 };
 
 struct i915_mmu_object {
@@ -58,40 +61,93 @@ struct i915_mmu_object {
 	struct drm_i915_gem_object *obj;
 	struct interval_tree_node it;
 	struct list_head link;
-	struct work_struct work;
 	bool attached;
+	bool cancelling;
 };
 
+/*
+ * All the objects affected by a single invalidation are released by a single
+ * work item, so that e.g. a munmap spanning many userptr objects does not
+ * generate a storm of work items and struct_mutex acquisitions.
+ */
+struct i915_mmu_cancel {
+	struct work_struct work;
+	struct drm_i915_private *i915;
+	struct list_head objects;
+};
+
+static void cancel_done(struct i915_mmu_object *mo)
+{
+	spin_lock(&mo->mn->lock);
+	mo->cancelling = false;
+	spin_unlock(&mo->mn->lock);
+
+	i915_gem_object_put(mo->obj);
+}
+
 static void cancel_userptr(struct work_struct *work)
 {
-	struct i915_mmu_object *mo = container_of(work, typeof(*mo), work);
-	struct drm_i915_gem_object *obj = mo->obj;
-	struct work_struct *active;
+	struct i915_mmu_cancel *cancel = container_of(work, typeof(*cancel), work);
+	struct drm_i915_private *i915 = cancel->i915;
+	struct i915_mmu_object *mo, *next;
+
+	list_for_each_entry_safe(mo, next, &cancel->objects, link) {
+		struct drm_i915_gem_object *obj = mo->obj;
+		struct work_struct *active;
+
+		/* Cancel any active worker and force us to re-evaluate gup */
+		mutex_lock(&obj->mm.lock);
+		active = fetch_and_zero(&obj->userptr.work);
+		mutex_unlock(&obj->mm.lock);
+		if (active) {
+			list_del(&mo->link);
+			cancel_done(mo);
+			continue;
+		}
 
-	/* Cancel any active worker and force us to re-evaluate gup */
-	mutex_lock(&obj->mm.lock);
-	active = fetch_and_zero(&obj->userptr.work);
-	mutex_unlock(&obj->mm.lock);
-	if (active)
-		goto out;
+		i915_gem_object_wait(obj, I915_WAIT_ALL,
+				     MAX_SCHEDULE_TIMEOUT, NULL);
+	}
 
-	i915_gem_object_wait(obj, I915_WAIT_ALL, MAX_SCHEDULE_TIMEOUT, NULL);
+	if (list_empty(&cancel->objects))
+		return;
 
-	mutex_lock(&obj->base.dev->struct_mutex);
+	mutex_lock(&i915->drm.struct_mutex);
 
-	/* We are inside a kthread context and can't be interrupted */
-	if (i915_gem_object_unbind(obj) == 0)
-		__i915_gem_object_put_pages(obj, I915_MM_NORMAL);
-	WARN_ONCE(i915_gem_object_has_pages(obj),
-		  "Failed to release pages: bind_count=%d, pages_pin_count=%d, pin_global=%d\n",
-		  obj->bind_count,
-		  atomic_read(&obj->mm.pages_pin_count),
-		  obj->pin_global);
+	list_for_each_entry(mo, &cancel->objects, link) {
+		struct drm_i915_gem_object *obj = mo->obj;
 
-	mutex_unlock(&obj->base.dev->struct_mutex);
+		/* We are inside a kthread context and can't be interrupted */
+		if (i915_gem_object_unbind(obj) == 0)
+			__i915_gem_object_put_pages(obj, I915_MM_NORMAL);
+		WARN_ONCE(i915_gem_object_has_pages(obj),
+			  "Failed to release pages: bind_count=%d, pages_pin_count=%d, pin_global=%d\n",
+			  obj->bind_count,
+			  atomic_read(&obj->mm.pages_pin_count),
+			  obj->pin_global);
+	}
 
-out:
-	i915_gem_object_put(obj);
+	mutex_unlock(&i915->drm.struct_mutex);
+
+	list_for_each_entry_safe(mo, next, &cancel->objects, link)
+		cancel_done(mo);
+}
+
+static void update_bounds(struct i915_mmu_notifier *mn)
+{
+	struct rb_node *first = rb_first_cached(&mn->objects);
+	struct interval_tree_node *root;
+
+	if (!first) {
+		mn->start = ULONG_MAX;
+		mn->last = 0;
+		return;
+	}
+
+	root = rb_entry(mn->objects.rb_root.rb_node,
+			struct interval_tree_node, rb);
+	mn->start = rb_entry(first, struct interval_tree_node, rb)->start;
+	mn->last = root->__subtree_last;
 }
 
 static void add_object(struct i915_mmu_object *mo)
@@ -100,6 +156,7 @@ static void add_object(struct i915_mmu_object *mo)
 		return;
 
 	interval_tree_insert(&mo->it, &mo->mn->objects);
+	update_bounds(mo->mn);
 	mo->attached = true;
 }
 
@@ -109,6 +166,7 @@ static void del_object(struct i915_mmu_object *mo)
 		return;
 
 	interval_tree_remove(&mo->it, &mo->mn->objects);
+	update_bounds(mo->mn);
 	mo->attached = false;
 }
 
@@ -119,16 +177,31 @@ static void i915_gem_userptr_mn_invalidate_range_start(struct mmu_notifier *_mn,
 {
 	struct i915_mmu_notifier *mn =
 		container_of(_mn, struct i915_mmu_notifier, mn);
-	struct i915_mmu_object *mo;
+	struct i915_userptr_stats *stats = &mn->i915->mm.userptr_stats;
+	struct i915_mmu_cancel cancel;
+	struct i915_mmu_object *mo, *next;
 	struct interval_tree_node *it;
+	unsigned int count;
 	LIST_HEAD(cancelled);
 
-	if (RB_EMPTY_ROOT(&mn->objects.rb_root))
-		return;
+	atomic64_inc(&stats->invalidations);
 
 	/* interval ranges are inclusive, but invalidate range is exclusive */
 	end--;
 
+	/*
+	 * Most invalidations do not touch any of our objects, reject those
+	 * without taking the lock. As with checking for an empty tree, an
+	 * object being attached concurrently is no different from one that
+	 * is attached just after our lookup.
+	 */
+	if (end < READ_ONCE(mn->start) || start > READ_ONCE(mn->last))
+		return;
+
+	INIT_LIST_HEAD(&cancel.objects);
+	cancel.i915 = mn->i915;
+
+	count = 0;
 	spin_lock(&mn->lock);
 	it = interval_tree_iter_first(&mn->objects, start, end);
 	while (it) {
@@ -142,18 +215,31 @@ static void i915_gem_userptr_mn_invalidate_range_start(struct mmu_notifier *_mn,
 		 * object if it is not in the process of being destroyed.
 		 */
 		mo = container_of(it, struct i915_mmu_object, it);
-		if (kref_get_unless_zero(&mo->obj->base.refcount))
-			queue_work(mn->wq, &mo->work);
-
 		list_add(&mo->link, &cancelled);
 		it = interval_tree_iter_next(it, start, end);
 	}
-	list_for_each_entry(mo, &cancelled, link)
+	list_for_each_entry_safe(mo, next, &cancelled, link) {
 		del_object(mo);
+
+		list_del(&mo->link);
+		if (kref_get_unless_zero(&mo->obj->base.refcount)) {
+			list_add_tail(&mo->link, &cancel.objects);
+			mo->cancelling = true;
+			count++;
+		}
+	}
 	spin_unlock(&mn->lock);
 
-	if (!list_empty(&cancelled))
-		flush_workqueue(mn->wq);
+	if (!count)
+		return;
+
+	atomic64_inc(&stats->cancels);
+	atomic64_add(count, &stats->objects);
+
+	INIT_WORK_ONSTACK(&cancel.work, cancel_userptr);
+	queue_work(mn->wq, &cancel.work);
+	flush_work(&cancel.work);
+	destroy_work_on_stack(&cancel.work);
 }
 
 static const struct mmu_notifier_ops i915_gem_userptr_notifier = {
@@ -161,7 +247,7 @@ static const struct mmu_notifier_ops i915_gem_userptr_notifier = {
 };
 
 static struct i915_mmu_notifier *
-i915_mmu_notifier_create(struct mm_struct *mm)
+i915_mmu_notifier_create(struct drm_i915_private *i915)
 {
 	struct i915_mmu_notifier *mn;
 
@@ -172,6 +258,9 @@ i915_mmu_notifier_create(struct mm_struct *mm)
 	spin_lock_init(&mn->lock);
 	mn->mn.ops = &i915_gem_userptr_notifier;
 	mn->objects = RB_ROOT_CACHED;
+	mn->start = ULONG_MAX;
+	mn->last = 0;
+	mn->i915 = i915;
 	mn->wq = alloc_workqueue("i915-userptr-release",
 				 WQ_UNBOUND | WQ_MEM_RECLAIM,
 				 0);
@@ -210,7 +299,7 @@ i915_mmu_notifier_find(struct i915_mm_struct *mm)
 	if (mn)
 		return mn;
 
-	mn = i915_mmu_notifier_create(mm->mm);
+	mn = i915_mmu_notifier_create(mm->i915);
 	if (IS_ERR(mn))
 		err = PTR_ERR(mn);
 
@@ -266,7 +355,6 @@ i915_gem_userptr_init__mmu_notifier(struct drm_i915_gem_object *obj,
 	mo->obj = obj;
 	mo->it.start = obj->userptr.ptr;
 	mo->it.last = obj->userptr.ptr + obj->base.size - 1;
-	INIT_WORK(&mo->work, cancel_userptr);
 
 	obj->userptr.mmu_object = mo;
 	return 0;
@@ -411,6 +499,37 @@ struct get_pages_work {
 	struct task_struct *task;
 };
 
+/*
+ * Unlike shmemfs, which hands us naturally aligned huge pages, the physical
+ * layout of a userptr is whatever the process happened to fault in, e.g. a
+ * THP may be preceded by a run of small pages within the same coalesced
+ * segment. Rather than deriving the page sizes from the segment lengths, only
+ * report those sizes for which a segment actually contains a naturally
+ * aligned chunk, so that the vma is only aligned and padded for the huge
+ * pages the GTT will really be able to use.
+ */
+static unsigned int
+userptr_sg_page_sizes(struct drm_i915_gem_object *obj, struct sg_table *st)
+{
+	unsigned long supported = INTEL_INFO(to_i915(obj->base.dev))->page_sizes;
+	unsigned int page_sizes = 0;
+	struct scatterlist *sg;
+
+	for (sg = st->sgl; sg; sg = __sg_next(sg)) {
+		dma_addr_t start = sg_dma_address(sg);
+		dma_addr_t end = start + sg_dma_len(sg);
+		unsigned int bit;
+
+		for_each_set_bit(bit, &supported,
+				 ilog2(I915_GTT_MAX_PAGE_SIZE) + 1) {
+			if (round_up(start, BIT(bit)) + BIT(bit) <= end)
+				page_sizes |= BIT(bit);
+		}
+	}
+
+	return page_sizes;
+}
+
 static struct sg_table *
 __i915_gem_userptr_alloc_pages(struct drm_i915_gem_object *obj,
 			       struct page **pvec, int num_pages)
@@ -426,7 +545,7 @@ __i915_gem_userptr_alloc_pages(struct drm_i915_gem_object *obj,
 
 alloc_table:
 	ret = __sg_alloc_table_from_pages(st, pvec, num_pages,
-					  0, num_pages << PAGE_SHIFT,
+					  0, (unsigned long)num_pages << PAGE_SHIFT,
 					  max_segment,
 					  GFP_KERNEL);
 	if (ret) {
@@ -447,7 +566,7 @@ alloc_table:
 		return ERR_PTR(ret);
 	}
 
-	sg_page_sizes = i915_sg_page_sizes(st->sgl);
+	sg_page_sizes = userptr_sg_page_sizes(obj, st);
 
 	__i915_gem_object_set_pages(obj, st, sg_page_sizes);
 
@@ -480,7 +599,7 @@ __i915_gem_userptr_set_active(struct drm_i915_gem_object *obj,
 	 */
 	if (!value)
 		del_object(obj->userptr.mmu_object);
-	else if (!work_pending(&obj->userptr.mmu_object->work))
+	else if (!obj->userptr.mmu_object->cancelling)
 		add_object(obj->userptr.mmu_object);
 	else
 		ret = -EAGAIN;
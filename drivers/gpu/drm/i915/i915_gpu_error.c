@@ -196,11 +196,32 @@ i915_error_printer(struct drm_i915_error_state_buf *e)
 	return p;
 }
 
+/*
+ * Capture runs under stop_machine() while the GPU is wedged, so we only
+ * snapshot each page into system memory there. Any (expensive) compression
+ * is deferred to process context, see i915_gpu_state_compress().
+ */
+static int capture_page(void *src, struct drm_i915_error_object *dst)
+{
+	unsigned long page;
+	void *ptr;
+
+	page = __get_free_page(GFP_ATOMIC | __GFP_NOWARN);
+	if (!page)
+		return -ENOMEM;
+
+	ptr = (void *)page;
+	if (!i915_memcpy_from_wc(ptr, src, PAGE_SIZE))
+		memcpy(ptr, src, PAGE_SIZE);
+	dst->pages[dst->page_count++] = ptr;
+
+	return 0;
+}
+
 #ifdef CONFIG_DRM_I915_COMPRESS_ERROR
 
 struct compress {
 	struct z_stream_s zstream;
-	void *tmp;
 };
 
 static bool compress_init(struct compress *c)
@@ -209,7 +230,7 @@ static bool compress_init(struct compress *c)
 
 	zstream->workspace =
 		kmalloc(zlib_deflate_workspacesize(MAX_WBITS, MAX_MEM_LEVEL),
-			GFP_ATOMIC | __GFP_NOWARN);
+			GFP_KERNEL | __GFP_NOWARN);
 	if (!zstream->workspace)
 		return false;
 
@@ -218,10 +239,6 @@ static bool compress_init(struct compress *c)
 		return false;
 	}
 
-	c->tmp = NULL;
-	if (i915_has_memcpy_from_wc())
-		c->tmp = (void *)__get_free_page(GFP_ATOMIC | __GFP_NOWARN);
-
 	return true;
 }
 
@@ -232,15 +249,13 @@ static int compress_page(struct compress *c,
 	struct z_stream_s *zstream = &c->zstream;
 
 	zstream->next_in = src;
-	if (c->tmp && i915_memcpy_from_wc(c->tmp, src, PAGE_SIZE))
-		zstream->next_in = c->tmp;
 	zstream->avail_in = PAGE_SIZE;
 
 	do {
 		if (zstream->avail_out == 0) {
 			unsigned long page;
 
-			page = __get_free_page(GFP_ATOMIC | __GFP_NOWARN);
+			page = __get_free_page(GFP_KERNEL | __GFP_NOWARN);
 			if (!page)
 				return -ENOMEM;
 
@@ -273,9 +288,6 @@ static void compress_fini(struct compress *c,
 
 	zlib_deflateEnd(zstream);
 	kfree(zstream->workspace);
-
-	if (c->tmp)
-		free_page((unsigned long)c->tmp);
 }
 
 static void err_compression_marker(struct drm_i915_error_state_buf *m)
@@ -285,38 +297,6 @@ static void err_compression_marker(struct drm_i915_error_state_buf *m)
 
 #else
 
-struct compress {
-};
-
-static bool compress_init(struct compress *c)
-{
-	return true;
-}
-
-static int compress_page(struct compress *c,
-			 void *src,
-			 struct drm_i915_error_object *dst)
-{
-	unsigned long page;
-	void *ptr;
-
-	page = __get_free_page(GFP_ATOMIC | __GFP_NOWARN);
-	if (!page)
-		return -ENOMEM;
-
-	ptr = (void *)page;
-	if (!i915_memcpy_from_wc(ptr, src, PAGE_SIZE))
-		memcpy(ptr, src, PAGE_SIZE);
-	dst->pages[dst->page_count++] = ptr;
-
-	return 0;
-}
-
-static void compress_fini(struct compress *c,
-			  struct drm_i915_error_object *dst)
-{
-}
-
 static void err_compression_marker(struct drm_i915_error_state_buf *m)
 {
 	err_puts(m, "~");
@@ -609,8 +589,10 @@ static void err_print_uc(struct drm_i915_error_state_buf *m,
 	print_error_obj(m, NULL, "GuC log buffer", error_uc->guc_log);
 }
 
+static void i915_gpu_state_sync(struct i915_gpu_state *error);
+
 int i915_error_state_to_str(struct drm_i915_error_state_buf *m,
-			    const struct i915_gpu_state *error)
+			    struct i915_gpu_state *error)
 {
 	struct drm_i915_private *dev_priv = m->i915;
 	struct drm_i915_error_object *obj;
@@ -621,6 +603,9 @@ int i915_error_state_to_str(struct drm_i915_error_state_buf *m,
 		return 0;
 	}
 
+	/* Wait for any deferred compression of the captured objects */
+	i915_gpu_state_sync(error);
+
 	if (*error->error_msg)
 		err_printf(m, "%s\n", error->error_msg);
 	err_printf(m, "Kernel: " UTS_RELEASE "\n");
@@ -845,6 +830,148 @@ static void i915_error_object_free(struct drm_i915_error_object *obj)
 	kfree(obj);
 }
 
+#ifdef CONFIG_DRM_I915_COMPRESS_ERROR
+
+static struct drm_i915_error_object *
+i915_error_object_compress(const struct drm_i915_error_object *src)
+{
+	struct drm_i915_error_object *dst;
+	struct compress compress;
+	unsigned long num_pages;
+	int page;
+
+	num_pages = DIV_ROUND_UP(10 * src->page_count, 8); /* worstcase zlib growth */
+	dst = kmalloc(sizeof(*dst) + num_pages * sizeof(u32 *),
+		      GFP_KERNEL | __GFP_NOWARN);
+	if (!dst)
+		return NULL;
+
+	dst->gtt_offset = src->gtt_offset;
+	dst->gtt_size = src->gtt_size;
+	dst->page_count = 0;
+	dst->unused = 0;
+
+	if (!compress_init(&compress)) {
+		kfree(dst);
+		return NULL;
+	}
+
+	for (page = 0; page < src->page_count; page++) {
+		if (compress_page(&compress, src->pages[page], dst))
+			goto unwind;
+
+		cond_resched();
+	}
+	goto out;
+
+unwind:
+	while (dst->page_count--)
+		free_page((unsigned long)dst->pages[dst->page_count]);
+	kfree(dst);
+	dst = NULL;
+
+out:
+	compress_fini(&compress, dst);
+	return dst;
+}
+
+/*
+ * Replace the raw snapshot by its compressed copy. The printed error state
+ * marks every object as compressed, so if we fail to compress we have to
+ * drop the object entirely, just as if we had failed to capture it.
+ */
+static void compress_object(struct drm_i915_error_object **obj)
+{
+	struct drm_i915_error_object *raw = *obj;
+
+	if (!raw)
+		return;
+
+	*obj = i915_error_object_compress(raw);
+	i915_error_object_free(raw);
+}
+
+static void engine_compress_worker(struct work_struct *work)
+{
+	struct drm_i915_error_engine *ee =
+		container_of(work, typeof(*ee), compress_work);
+	long i;
+
+	compress_object(&ee->batchbuffer);
+	compress_object(&ee->wa_batchbuffer);
+	compress_object(&ee->ringbuffer);
+	compress_object(&ee->hws_page);
+	compress_object(&ee->ctx);
+	compress_object(&ee->wa_ctx);
+	compress_object(&ee->default_state);
+
+	for (i = 0; i < ee->user_bo_count; i++)
+		compress_object(&ee->user_bo[i]);
+}
+
+static void uc_compress_worker(struct work_struct *work)
+{
+	struct i915_error_uc *error_uc =
+		container_of(work, typeof(*error_uc), compress_work);
+
+	compress_object(&error_uc->guc_log);
+}
+
+/*
+ * Compress the captured objects off the reset path: each engine is handed
+ * to its own work item on the unbound workqueue so that large dumps are
+ * compressed in parallel, after the GPU has already been allowed to reset.
+ */
+static void i915_gpu_state_compress(struct i915_gpu_state *error)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(error->engine); i++) {
+		struct drm_i915_error_engine *ee = &error->engine[i];
+
+		INIT_WORK(&ee->compress_work, engine_compress_worker);
+		if (ee->engine_id != -1)
+			queue_work(system_unbound_wq, &ee->compress_work);
+	}
+
+	INIT_WORK(&error->uc.compress_work, uc_compress_worker);
+	queue_work(system_unbound_wq, &error->uc.compress_work);
+}
+
+static void i915_gpu_state_sync(struct i915_gpu_state *error)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(error->engine); i++)
+		flush_work(&error->engine[i].compress_work);
+	flush_work(&error->uc.compress_work);
+}
+
+static void i915_gpu_state_cancel(struct i915_gpu_state *error)
+{
+	int i;
+
+	for (i = 0; i < ARRAY_SIZE(error->engine); i++)
+		cancel_work_sync(&error->engine[i].compress_work);
+	cancel_work_sync(&error->uc.compress_work);
+}
+
+#else
+
+static void i915_gpu_state_compress(struct i915_gpu_state *error)
+{
+}
+
+static void i915_gpu_state_sync(struct i915_gpu_state *error)
+{
+}
+
+static void i915_gpu_state_cancel(struct i915_gpu_state *error)
+{
+}
+
+#endif
+
 static __always_inline void free_param(const char *type, void *x)
 {
 	if (!__builtin_strcmp(type, "char *"))
@@ -873,6 +1000,8 @@ void __i915_gpu_state_free(struct kref *error_ref)
 		container_of(error_ref, typeof(*error), ref);
 	long i, j;
 
+	i915_gpu_state_cancel(error);
+
 	for (i = 0; i < ARRAY_SIZE(error->engine); i++) {
 		struct drm_i915_error_engine *ee = &error->engine[i];
 
@@ -886,6 +1015,7 @@ void __i915_gpu_state_free(struct kref *error_ref)
 		i915_error_object_free(ee->hws_page);
 		i915_error_object_free(ee->ctx);
 		i915_error_object_free(ee->wa_ctx);
+		i915_error_object_free(ee->default_state);
 
 		kfree(ee->requests);
 		if (!IS_ERR_OR_NULL(ee->waiters))
@@ -912,7 +1042,6 @@ i915_error_object_create(struct drm_i915_private *i915,
 	struct i915_ggtt *ggtt = &i915->ggtt;
 	const u64 slot = ggtt->error_capture.start;
 	struct drm_i915_error_object *dst;
-	struct compress compress;
 	unsigned long num_pages;
 	struct sgt_iter iter;
 	dma_addr_t dma;
@@ -921,7 +1050,6 @@ i915_error_object_create(struct drm_i915_private *i915,
 		return NULL;
 
 	num_pages = min_t(u64, vma->size, vma->obj->base.size) >> PAGE_SHIFT;
-	num_pages = DIV_ROUND_UP(10 * num_pages, 8); /* worstcase zlib growth */
 	dst = kmalloc(sizeof(*dst) + num_pages * sizeof(u32 *),
 		      GFP_ATOMIC | __GFP_NOWARN);
 	if (!dst)
@@ -932,20 +1060,18 @@ i915_error_object_create(struct drm_i915_private *i915,
 	dst->page_count = 0;
 	dst->unused = 0;
 
-	if (!compress_init(&compress)) {
-		kfree(dst);
-		return NULL;
-	}
-
 	for_each_sgt_dma(dma, iter, vma->pages) {
 		void __iomem *s;
 		int ret;
 
+		if (dst->page_count == num_pages)
+			break;
+
 		ggtt->base.insert_page(&ggtt->base, dma, slot,
 				       I915_CACHE_NONE, 0);
 
 		s = io_mapping_map_atomic_wc(&ggtt->iomap, slot);
-		ret = compress_page(&compress, (void  __force *)s, dst);
+		ret = capture_page((void  __force *)s, dst);
 		io_mapping_unmap_atomic(s);
 
 		if (ret)
@@ -960,7 +1086,6 @@ unwind:
 	dst = NULL;
 
 out:
-	compress_fini(&compress, dst);
 	ggtt->base.clear_range(&ggtt->base, slot, PAGE_SIZE);
 	return dst;
 }
@@ -1779,6 +1904,7 @@ i915_capture_gpu_state(struct drm_i915_private *i915)
 	error->i915 = i915;
 
 	stop_machine(capture, error, NULL);
+	i915_gpu_state_compress(error);
 
 	return error;
 }
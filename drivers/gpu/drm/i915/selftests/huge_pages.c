@@ -24,6 +24,7 @@
 
 #include "../i915_selftest.h"
 
+#include <linux/mman.h>
 #include <linux/prime_numbers.h>
 
 #include "mock_drm.h"
@@ -1404,6 +1405,104 @@ out_put:
 	return err;
 }
 
+static int igt_ppgtt_userptr_huge(void *arg)
+{
+	struct i915_gem_context *ctx = arg;
+	struct drm_i915_private *i915 = ctx->i915;
+	struct drm_file *file = ctx->file_priv->file;
+	struct drm_i915_gem_object *obj;
+	static const unsigned int sizes[] = {
+		SZ_2M,
+		SZ_4M,
+		SZ_8M,
+		SZ_16M,
+		SZ_32M,
+	};
+	int i;
+	int err = 0;
+
+	/*
+	 * Sanity check that THP backing a userptr is picked up as huge-pages
+	 * by the GTT -- ensure that our writes land in the right place.
+	 */
+
+	if (!has_transparent_hugepage()) {
+		pr_info("missing THP support, skipping\n");
+		return 0;
+	}
+
+	for (i = 0; i < ARRAY_SIZE(sizes); ++i) {
+		unsigned int size = sizes[i];
+		struct drm_i915_gem_userptr arg = {};
+		unsigned long addr, ptr;
+
+		/* Over-allocate so that we can align the userptr to 2M */
+		addr = vm_mmap(NULL, 0, size + SZ_2M,
+			       PROT_READ | PROT_WRITE,
+			       MAP_ANONYMOUS | MAP_PRIVATE,
+			       0);
+		if (IS_ERR_VALUE(addr))
+			return addr;
+
+		ptr = round_up(addr, SZ_2M);
+
+		/* Fault in the backing storage, hopefully as THP */
+		if (clear_user(u64_to_user_ptr(ptr), size)) {
+			err = -EFAULT;
+			goto out_unmap;
+		}
+
+		arg.user_ptr = ptr;
+		arg.user_size = size;
+		err = i915_gem_userptr_ioctl(&i915->drm, &arg, file);
+		if (err == -ENODEV) {
+			pr_info("userptr not supported, skipping\n");
+			err = 0;
+			goto out_unmap;
+		}
+		if (err)
+			goto out_unmap;
+
+		obj = i915_gem_object_lookup(file, arg.handle);
+		drm_gem_handle_delete(file, arg.handle);
+		if (!obj) {
+			err = -ENOENT;
+			goto out_unmap;
+		}
+
+		err = i915_gem_object_pin_pages(obj);
+		if (err == -EAGAIN) {
+			/* Let the worker finish pinning the pages for us */
+			flush_workqueue(i915->mm.userptr_wq);
+			err = i915_gem_object_pin_pages(obj);
+		}
+		if (err)
+			goto out_put;
+
+		if (obj->mm.page_sizes.phys < I915_GTT_PAGE_SIZE_2M) {
+			pr_info("skipping size=%u, userptr not backed by huge-page(s)\n",
+				size);
+			goto out_unpin;
+		}
+
+		err = igt_write_huge(ctx, obj);
+		if (err)
+			pr_err("userptr write-huge failed with size=%u\n",
+			       size);
+
+out_unpin:
+		i915_gem_object_unpin_pages(obj);
+out_put:
+		i915_gem_object_put(obj);
+out_unmap:
+		vm_munmap(addr, size + SZ_2M);
+		if (err)
+			break;
+	}
+
+	return err;
+}
+
 static int igt_ppgtt_pin_update(void *arg)
 {
 	struct i915_gem_context *ctx = arg;
@@ -1734,6 +1833,7 @@ int i915_gem_huge_page_live_selftests(struct drm_i915_private *dev_priv)
 		SUBTEST(igt_ppgtt_exhaust_huge),
 		SUBTEST(igt_ppgtt_gemfs_huge),
 		SUBTEST(igt_ppgtt_internal_huge),
+		SUBTEST(igt_ppgtt_userptr_huge),
 	};
 	struct drm_file *file;
 	struct i915_gem_context *ctx;
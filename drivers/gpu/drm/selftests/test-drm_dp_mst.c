@@ -0,0 +1,717 @@
+/*
+ * Test cases and benchmarks for the DP MST topology manager, run against
+ * a topology of MST branch devices emulated behind a fake AUX channel
+ */
+
+#define pr_fmt(fmt) "drm_dp_mst: " fmt
+
+#include <linux/module.h>
+#include <linux/device.h>
+#include <linux/slab.h>
+#include <linux/ktime.h>
+#include <linux/workqueue.h>
+
+#include <drm/drmP.h>
+#include <drm/drm_dp_helper.h>
+#include <drm/drm_dp_mst_helper.h>
+
+#define TESTS "drm_dp_mst_selftests.h"
+#include "drm_selftest.h"
+
+static unsigned int latency_ms = 2;
+static unsigned int tree_depth = 3;
+static unsigned int tree_fanout = 3;
+static unsigned int chain_length = 4;
+
+#define EMU_MAX_BRANCHES 64
+#define EMU_MAX_PORTS 8
+#define EMU_SINKS 2
+#define EMU_DPCD_SIZE (DP_DEVICE_SERVICE_IRQ_VECTOR_ESI0 + 0x10)
+#define EMU_CHUNK_SIZE 48
+#define EMU_PBN 2560
+
+/*
+ * The emulated branch devices answer LINK_ADDRESS and ENUM_PATH_RESOURCES
+ * and NAK everything else. Each branch device processes its requests one
+ * after another, taking latency_ms for each, while different branch devices
+ * work in parallel - roughly what a dock with daisy-chained hubs does.
+ *
+ * A chunk written to the down request buffer is only read from the irq
+ * worker, before it raises the next short pulse, so a source which writes
+ * another chunk without waiting for a short pulse overwrites it.
+ */
+struct emu_port {
+	bool input;
+	u8 pdt;
+	int child;
+};
+
+struct emu_branch {
+	u8 guid[16];
+	unsigned int nports;
+	struct emu_port ports[EMU_MAX_PORTS];
+	unsigned long busy_until;
+};
+
+struct emu_hdr {
+	u8 lct;
+	u8 rad[8];
+	bool path_msg;
+	bool somt;
+	bool eomt;
+	u8 seqno;
+	u8 msg_len;
+};
+
+struct emu_reply {
+	struct list_head link;
+	unsigned long ready;
+	bool last;
+	int len;
+	u8 chunk[EMU_CHUNK_SIZE];
+};
+
+struct mst_emu {
+	struct device *dev;
+	struct drm_device drm;
+	struct drm_dp_aux aux;
+	struct drm_dp_mst_topology_mgr mgr;
+
+	/* protects everything below */
+	struct mutex lock;
+	u8 dpcd[EMU_DPCD_SIZE];
+	u8 req[256];
+	unsigned int req_len;
+	/* a down request chunk waits in the buffer for the branch to read it */
+	bool req_full;
+
+	/* down reply chunks, in the order the branch devices finish them */
+	struct list_head replies;
+	bool rep_pending;
+	struct delayed_work irq_work;
+
+	struct emu_branch branches[EMU_MAX_BRANCHES];
+	unsigned int num_branches;
+
+	unsigned int requests;
+	unsigned int inflight;
+	unsigned int max_inflight;
+	unsigned int errors;
+};
+
+static u8 emu_crc4(const u8 *data, int num_nibbles)
+{
+	u8 remainder = 0;
+	int i;
+
+	for (i = 0; i < num_nibbles * 4; i++) {
+		remainder <<= 1;
+		remainder |= (data[i / 8] >> (7 - i % 8)) & 1;
+		if (remainder & 0x10)
+			remainder ^= 0x13;
+	}
+
+	for (i = 0; i < 4; i++) {
+		remainder <<= 1;
+		if (remainder & 0x10)
+			remainder ^= 0x13;
+	}
+
+	return remainder & 0xf;
+}
+
+static u8 emu_crc8(const u8 *data, int num_bytes)
+{
+	u16 remainder = 0;
+	int i;
+
+	for (i = 0; i < num_bytes * 8; i++) {
+		remainder <<= 1;
+		remainder |= (data[i / 8] >> (7 - i % 8)) & 1;
+		if (remainder & 0x100)
+			remainder ^= 0xd5;
+	}
+
+	for (i = 0; i < 8; i++) {
+		remainder <<= 1;
+		if (remainder & 0x100)
+			remainder ^= 0xd5;
+	}
+
+	return remainder & 0xff;
+}
+
+static int emu_encode_hdr(u8 *buf, const struct emu_hdr *hdr)
+{
+	int idx = 0;
+	int i;
+
+	buf[idx++] = (hdr->lct << 4) | ((hdr->lct - 1) & 0xf);
+	for (i = 0; i < hdr->lct / 2; i++)
+		buf[idx++] = hdr->rad[i];
+	buf[idx++] = (hdr->path_msg << 6) | (hdr->msg_len & 0x3f);
+	buf[idx++] = (hdr->somt << 7) | (hdr->eomt << 6) | (hdr->seqno << 4);
+	buf[idx - 1] |= emu_crc4(buf, idx * 2 - 1);
+
+	return idx;
+}
+
+static int emu_add_branch(struct mst_emu *emu, unsigned int depth,
+			  unsigned int fanout)
+{
+	struct emu_branch *branch;
+	struct emu_port *port;
+	unsigned int i;
+	int b;
+
+	if (emu->num_branches == EMU_MAX_BRANCHES)
+		return -1;
+
+	b = emu->num_branches++;
+	branch = &emu->branches[b];
+	branch->guid[0] = 0x5a;
+	branch->guid[15] = b + 1;
+
+	port = &branch->ports[branch->nports++];
+	port->input = true;
+	port->pdt = DP_PEER_DEVICE_SOURCE_OR_SST;
+	port->child = -1;
+
+	for (i = 0; depth > 1 && i < fanout; i++) {
+		port = &branch->ports[branch->nports++];
+		port->pdt = DP_PEER_DEVICE_MST_BRANCHING;
+		port->child = emu_add_branch(emu, depth - 1, fanout);
+		if (port->child < 0)
+			port->pdt = DP_PEER_DEVICE_NONE;
+	}
+
+	for (i = 0; i < EMU_SINKS; i++) {
+		port = &branch->ports[branch->nports++];
+		port->pdt = DP_PEER_DEVICE_SST_SINK;
+		port->child = -1;
+	}
+
+	return b;
+}
+
+/* Follow the RAD of a request to the branch device it is addressed to */
+static struct emu_branch *emu_route(struct mst_emu *emu,
+				    const struct emu_hdr *hdr)
+{
+	int b = 0;
+	int i;
+
+	for (i = 0; i < hdr->lct - 1; i++) {
+		unsigned int port_num = (hdr->rad[i / 2] >> ((i % 2) ? 0 : 4)) & 0xf;
+
+		if (port_num >= emu->branches[b].nports)
+			return NULL;
+
+		b = emu->branches[b].ports[port_num].child;
+		if (b < 0)
+			return NULL;
+	}
+
+	return &emu->branches[b];
+}
+
+static void emu_queue_reply(struct mst_emu *emu, struct emu_branch *branch,
+			    const struct emu_hdr *req, const u8 *body, int len)
+{
+	int space = EMU_CHUNK_SIZE - (3 + req->lct / 2) - 1;
+	unsigned long now = jiffies;
+	unsigned long ready;
+	int offset = 0;
+
+	ready = time_after(branch->busy_until, now) ? branch->busy_until : now;
+	ready += msecs_to_jiffies(latency_ms);
+	branch->busy_until = ready;
+
+	do {
+		struct emu_reply *rep, *pos;
+		struct emu_hdr hdr = *req;
+		int n = min(len - offset, space);
+		int idx;
+
+		rep = kzalloc(sizeof(*rep), GFP_KERNEL);
+		if (!rep) {
+			emu->errors++;
+			return;
+		}
+
+		hdr.somt = offset == 0;
+		hdr.eomt = offset + n == len;
+		hdr.msg_len = n + 1;
+		idx = emu_encode_hdr(rep->chunk, &hdr);
+		memcpy(&rep->chunk[idx], &body[offset], n);
+		rep->chunk[idx + n] = emu_crc8(&body[offset], n);
+		rep->len = idx + n + 1;
+		rep->last = hdr.eomt;
+		rep->ready = ready;
+
+		/* chunks of one reply must not interleave with other replies */
+		list_for_each_entry_reverse(pos, &emu->replies, link) {
+			if (!time_after(pos->ready, ready))
+				break;
+		}
+		list_add(&rep->link, &pos->link);
+
+		offset += n;
+	} while (offset < len);
+
+	schedule_delayed_work(&emu->irq_work, ready - now);
+}
+
+static void emu_handle_req(struct mst_emu *emu, const struct emu_hdr *hdr)
+{
+	struct emu_branch *branch;
+	unsigned int i, port_num;
+	u8 rep[256];
+	int len = 0;
+
+	branch = emu_route(emu, hdr);
+	if (!branch) {
+		pr_err("down request to unknown branch device, lct=%d\n",
+		       hdr->lct);
+		emu->errors++;
+		return;
+	}
+
+	emu->requests++;
+	emu->inflight++;
+	emu->max_inflight = max(emu->max_inflight, emu->inflight);
+
+	switch (emu->req[0] & 0x7f) {
+	case DP_LINK_ADDRESS:
+		rep[len++] = DP_LINK_ADDRESS;
+		memcpy(&rep[len], branch->guid, 16);
+		len += 16;
+		rep[len++] = branch->nports;
+		for (i = 0; i < branch->nports; i++) {
+			const struct emu_port *port = &branch->ports[i];
+			bool plugged = port->pdt != DP_PEER_DEVICE_NONE;
+
+			rep[len++] = (port->input << 7) | (port->pdt << 4) | i;
+			rep[len++] = ((port->pdt == DP_PEER_DEVICE_MST_BRANCHING) << 7) |
+				     (plugged << 6);
+			if (port->input)
+				continue;
+
+			rep[len++] = 0x12;
+			if (port->child >= 0)
+				memcpy(&rep[len], emu->branches[port->child].guid, 16);
+			else
+				memset(&rep[len], 0, 16);
+			len += 16;
+			rep[len++] = plugged ? 0x11 : 0;
+		}
+		break;
+	case DP_ENUM_PATH_RESOURCES:
+		port_num = emu->req[1] >> 4;
+		rep[len++] = DP_ENUM_PATH_RESOURCES;
+		rep[len++] = port_num << 4;
+		rep[len++] = EMU_PBN >> 8;
+		rep[len++] = EMU_PBN & 0xff;
+		rep[len++] = EMU_PBN >> 8;
+		rep[len++] = EMU_PBN & 0xff;
+		break;
+	default:
+		rep[len++] = 0x80 | (emu->req[0] & 0x7f);
+		memcpy(&rep[len], branch->guid, 16);
+		len += 16;
+		rep[len++] = DP_NAK_BAD_PARAM;
+		rep[len++] = 0;
+		break;
+	}
+
+	emu_queue_reply(emu, branch, hdr, rep, len);
+}
+
+/* Called once the last byte of a down request chunk has been written */
+static void emu_down_req_chunk(struct mst_emu *emu, const u8 *chunk,
+			       int hdrlen)
+{
+	struct emu_hdr hdr = {};
+	int body;
+
+	if ((chunk[hdrlen - 1] & 0xf) != emu_crc4(chunk, hdrlen * 2 - 1)) {
+		pr_err("down request with bad header CRC\n");
+		emu->errors++;
+		return;
+	}
+
+	hdr.lct = chunk[0] >> 4;
+	memcpy(hdr.rad, &chunk[1], hdr.lct / 2);
+	hdr.path_msg = (chunk[hdrlen - 2] >> 6) & 0x1;
+	hdr.msg_len = chunk[hdrlen - 2] & 0x3f;
+	hdr.somt = (chunk[hdrlen - 1] >> 7) & 0x1;
+	hdr.eomt = (chunk[hdrlen - 1] >> 6) & 0x1;
+	hdr.seqno = (chunk[hdrlen - 1] >> 4) & 0x1;
+
+	body = hdr.msg_len - 1;
+	if (body < 0 || emu_crc8(&chunk[hdrlen], body) != chunk[hdrlen + body]) {
+		pr_err("down request with bad data CRC\n");
+		emu->errors++;
+		return;
+	}
+
+	if (hdr.somt)
+		emu->req_len = 0;
+
+	if (emu->req_len + body > sizeof(emu->req)) {
+		pr_err("down request too long\n");
+		emu->errors++;
+		return;
+	}
+
+	memcpy(&emu->req[emu->req_len], &chunk[hdrlen], body);
+	emu->req_len += body;
+
+	if (hdr.eomt)
+		emu_handle_req(emu, &hdr);
+}
+
+static void emu_dpcd_write(struct mst_emu *emu, unsigned int offset,
+			   const u8 *buf, unsigned int size)
+{
+	unsigned int end = offset + size;
+	unsigned int i;
+
+	for (i = offset; i < end; i++) {
+		u8 val = buf[i - offset];
+
+		switch (i) {
+		case DP_DEVICE_SERVICE_IRQ_VECTOR_ESI0:
+			/* write 1 to clear, the ack of the down reply */
+			emu->dpcd[i] &= ~val;
+			if (val & DP_DOWN_REP_MSG_RDY && emu->rep_pending) {
+				emu->rep_pending = false;
+				schedule_delayed_work(&emu->irq_work, 0);
+			}
+			break;
+		case DP_PAYLOAD_TABLE_UPDATE_STATUS:
+			emu->dpcd[i] &= ~val;
+			break;
+		default:
+			emu->dpcd[i] = val;
+			break;
+		}
+	}
+
+	if (offset <= DP_PAYLOAD_ALLOCATE_SET && end > DP_PAYLOAD_ALLOCATE_SET)
+		emu->dpcd[DP_PAYLOAD_TABLE_UPDATE_STATUS] |= DP_PAYLOAD_TABLE_UPDATED;
+
+	if (offset >= DP_SIDEBAND_MSG_DOWN_REQ_BASE &&
+	    end <= DP_SIDEBAND_MSG_DOWN_REQ_BASE + EMU_CHUNK_SIZE) {
+		const u8 *chunk = &emu->dpcd[DP_SIDEBAND_MSG_DOWN_REQ_BASE];
+		int hdrlen = 3 + (chunk[0] >> 4) / 2;
+		int len = end - DP_SIDEBAND_MSG_DOWN_REQ_BASE;
+
+		if (offset == DP_SIDEBAND_MSG_DOWN_REQ_BASE && emu->req_full) {
+			pr_err("down request chunk overwritten before it was read\n");
+			emu->errors++;
+		}
+
+		if (len >= hdrlen && len == hdrlen + (chunk[hdrlen - 2] & 0x3f)) {
+			emu->req_full = true;
+			mod_delayed_work(system_wq, &emu->irq_work, 0);
+		}
+	}
+}
+
+static ssize_t emu_aux_transfer(struct drm_dp_aux *aux,
+				struct drm_dp_aux_msg *msg)
+{
+	struct mst_emu *emu = container_of(aux, struct mst_emu, aux);
+
+	if (msg->address + msg->size > EMU_DPCD_SIZE) {
+		msg->reply = DP_AUX_NATIVE_REPLY_NACK;
+		return 0;
+	}
+
+	mutex_lock(&emu->lock);
+	switch (msg->request) {
+	case DP_AUX_NATIVE_READ:
+		memcpy(msg->buffer, &emu->dpcd[msg->address], msg->size);
+		break;
+	case DP_AUX_NATIVE_WRITE:
+		emu_dpcd_write(emu, msg->address, msg->buffer, msg->size);
+		break;
+	default:
+		mutex_unlock(&emu->lock);
+		return -EIO;
+	}
+	mutex_unlock(&emu->lock);
+
+	msg->reply = DP_AUX_NATIVE_REPLY_ACK;
+	return msg->size;
+}
+
+/*
+ * Read a pending down request chunk, then present the next finished reply
+ * chunk in the down reply buffer and handle the resulting short pulse the
+ * way drivers do.
+ */
+static void emu_irq_work(struct work_struct *work)
+{
+	struct mst_emu *emu =
+		container_of(to_delayed_work(work), struct mst_emu, irq_work);
+	struct emu_reply *rep;
+	unsigned long now;
+	bool handled;
+	u8 esi[4];
+
+	mutex_lock(&emu->lock);
+	if (emu->req_full) {
+		const u8 *chunk = &emu->dpcd[DP_SIDEBAND_MSG_DOWN_REQ_BASE];
+
+		emu_down_req_chunk(emu, chunk, 3 + (chunk[0] >> 4) / 2);
+		emu->req_full = false;
+	}
+
+	if (!emu->rep_pending) {
+		rep = list_first_entry_or_null(&emu->replies,
+					       struct emu_reply, link);
+		if (!rep) {
+			mutex_unlock(&emu->lock);
+			return;
+		}
+
+		now = jiffies;
+		if (time_before(now, rep->ready)) {
+			schedule_delayed_work(&emu->irq_work, rep->ready - now);
+			mutex_unlock(&emu->lock);
+			return;
+		}
+
+		memcpy(&emu->dpcd[DP_SIDEBAND_MSG_DOWN_REP_BASE],
+		       rep->chunk, rep->len);
+		emu->dpcd[DP_DEVICE_SERVICE_IRQ_VECTOR_ESI0] |= DP_DOWN_REP_MSG_RDY;
+		emu->rep_pending = true;
+		if (rep->last)
+			emu->inflight--;
+
+		list_del(&rep->link);
+		kfree(rep);
+	}
+	mutex_unlock(&emu->lock);
+
+	if (drm_dp_dpcd_read(&emu->aux, DP_SINK_COUNT_ESI, esi, 4) != 4)
+		return;
+
+	drm_dp_mst_hpd_irq(&emu->mgr, esi, &handled);
+	if (handled)
+		drm_dp_dpcd_write(&emu->aux, DP_SINK_COUNT_ESI + 1, &esi[1], 3);
+}
+
+static struct drm_connector *
+emu_add_connector(struct drm_dp_mst_topology_mgr *mgr,
+		  struct drm_dp_mst_port *port, const char *path)
+{
+	return kzalloc(sizeof(struct drm_connector), GFP_KERNEL);
+}
+
+static void emu_register_connector(struct drm_connector *connector)
+{
+}
+
+static void emu_destroy_connector(struct drm_dp_mst_topology_mgr *mgr,
+				  struct drm_connector *connector)
+{
+	kfree(connector);
+}
+
+static void emu_hotplug(struct drm_dp_mst_topology_mgr *mgr)
+{
+}
+
+static const struct drm_dp_mst_topology_cbs emu_cbs = {
+	.add_connector = emu_add_connector,
+	.register_connector = emu_register_connector,
+	.destroy_connector = emu_destroy_connector,
+	.hotplug = emu_hotplug,
+};
+
+static struct mst_emu *mst_emu_create(unsigned int depth, unsigned int fanout)
+{
+	struct mst_emu *emu;
+	int ret;
+
+	if (!depth || 1 + fanout + EMU_SINKS > EMU_MAX_PORTS)
+		return ERR_PTR(-EINVAL);
+
+	emu = kzalloc(sizeof(*emu), GFP_KERNEL);
+	if (!emu)
+		return ERR_PTR(-ENOMEM);
+
+	emu->dev = root_device_register("drm_dp_mst_emu");
+	if (IS_ERR(emu->dev)) {
+		ret = PTR_ERR(emu->dev);
+		kfree(emu);
+		return ERR_PTR(ret);
+	}
+
+	mutex_init(&emu->lock);
+	INIT_LIST_HEAD(&emu->replies);
+	INIT_DELAYED_WORK(&emu->irq_work, emu_irq_work);
+
+	emu->dpcd[DP_DPCD_REV] = 0x12;
+	emu->dpcd[DP_MAX_LINK_RATE] = DP_LINK_BW_5_4;
+	emu->dpcd[DP_MAX_LANE_COUNT] = 4;
+	emu->dpcd[DP_MSTM_CAP] = DP_MST_CAP;
+	emu_add_branch(emu, depth, fanout);
+
+	emu->drm.dev = emu->dev;
+	emu->aux.name = "mst-emu";
+	emu->aux.dev = emu->dev;
+	emu->aux.transfer = emu_aux_transfer;
+	drm_dp_aux_init(&emu->aux);
+
+	ret = drm_dp_mst_topology_mgr_init(&emu->mgr, &emu->drm, &emu->aux,
+					   16, 4, 0);
+	if (ret) {
+		root_device_unregister(emu->dev);
+		kfree(emu);
+		return ERR_PTR(ret);
+	}
+	emu->mgr.cbs = &emu_cbs;
+
+	return emu;
+}
+
+static void mst_emu_destroy(struct mst_emu *emu)
+{
+	struct emu_reply *rep, *next;
+
+	flush_work(&emu->mgr.work);
+	flush_work(&emu->mgr.tx_work);
+	cancel_delayed_work_sync(&emu->irq_work);
+
+	drm_dp_mst_topology_mgr_set_mst(&emu->mgr, false);
+	drm_dp_mst_topology_mgr_destroy(&emu->mgr);
+
+	list_for_each_entry_safe(rep, next, &emu->replies, link)
+		kfree(rep);
+
+	root_device_unregister(emu->dev);
+	kfree(emu);
+}
+
+static void count_topology(struct drm_dp_mst_branch *mstb,
+			   unsigned int *branches, unsigned int *ports,
+			   unsigned int *missing_pbn)
+{
+	struct drm_dp_mst_port *port;
+
+	(*branches)++;
+	list_for_each_entry(port, &mstb->ports, next) {
+		(*ports)++;
+		if (!port->input && port->ddps && !port->available_pbn)
+			(*missing_pbn)++;
+		if (port->mstb)
+			count_topology(port->mstb, branches, ports, missing_pbn);
+	}
+}
+
+static int probe_topology(unsigned int depth, unsigned int fanout)
+{
+	unsigned int branches = 0, ports = 0, missing_pbn = 0;
+	unsigned int expected_ports = 0;
+	struct mst_emu *emu;
+	ktime_t start, end;
+	unsigned int n;
+	int err;
+
+	emu = mst_emu_create(depth, fanout);
+	if (IS_ERR(emu))
+		return PTR_ERR(emu);
+
+	for (n = 0; n < emu->num_branches; n++)
+		expected_ports += emu->branches[n].nports;
+
+	start = ktime_get();
+	err = drm_dp_mst_topology_mgr_set_mst(&emu->mgr, true);
+	if (err) {
+		pr_err("failed to enable MST, err=%d\n", err);
+		goto out;
+	}
+	flush_work(&emu->mgr.work);
+	end = ktime_get();
+
+	mutex_lock(&emu->mgr.lock);
+	if (emu->mgr.mst_primary)
+		count_topology(emu->mgr.mst_primary,
+			       &branches, &ports, &missing_pbn);
+	mutex_unlock(&emu->mgr.lock);
+
+	pr_info("%s: %u branch devices, %u ports probed in %lldus (%u requests, at most %u in flight, %ums latency)\n",
+		__func__, branches, ports, ktime_us_delta(end, start),
+		emu->requests, emu->max_inflight, latency_ms);
+
+	err = -EINVAL;
+	if (emu->errors) {
+		pr_err("emulated branch devices saw %u bad requests\n",
+		       emu->errors);
+		goto out;
+	}
+
+	if (branches != emu->num_branches || ports != expected_ports) {
+		pr_err("probed %u branch devices and %u ports, expected %u and %u\n",
+		       branches, ports, emu->num_branches, expected_ports);
+		goto out;
+	}
+
+	if (missing_pbn) {
+		pr_err("%u connected ports without path resources\n",
+		       missing_pbn);
+		goto out;
+	}
+
+	err = 0;
+out:
+	mst_emu_destroy(emu);
+	return err;
+}
+
+static int igt_sanitycheck(void *ignored)
+{
+	pr_info("%s - ok!\n", __func__);
+	return 0;
+}
+
+static int igt_probe_tree(void *ignored)
+{
+	return probe_topology(tree_depth, tree_fanout);
+}
+
+static int igt_probe_chain(void *ignored)
+{
+	return probe_topology(chain_length, 1);
+}
+
+#include "drm_selftest.c"
+
+static int __init test_drm_dp_mst_init(void)
+{
+	int err;
+
+	pr_info("Testing MST topology probing with latency_ms=%u\n",
+		latency_ms);
+	err = run_selftests(selftests, ARRAY_SIZE(selftests), NULL);
+
+	return err > 0 ? 0 : err;
+}
+
+static void __exit test_drm_dp_mst_exit(void)
+{
+}
+
+module_init(test_drm_dp_mst_init);
+module_exit(test_drm_dp_mst_exit);
+
+module_param(latency_ms, uint, 0400);
+module_param(tree_depth, uint, 0400);
+module_param(tree_fanout, uint, 0400);
+module_param(chain_length, uint, 0400);
+
+MODULE_LICENSE("GPL");
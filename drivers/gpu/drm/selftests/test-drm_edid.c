@@ -0,0 +1,567 @@
+/*
+ * Test cases and benchmarks for EDID parsing
+ */
+
+#define pr_fmt(fmt) "drm_edid: " fmt
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+
+#include <drm/drmP.h>
+#include <drm/drm_edid.h>
+
+#define TESTS "drm_edid_selftests.h"
+#include "drm_selftest.h"
+
+static unsigned int random_seed;
+static unsigned int max_iterations = 1000;
+
+/*
+ * A small corpus of EDIDs: two of the generic EDIDs from drm_edid_load.c,
+ * and the 1920x1080 one extended with CEA-861 blocks as found on typical
+ * HDMI 1.4 and HDMI 2.0 sinks, and with every CEA-861 VIC.
+ */
+/* 1024x768 */
+static const u8 edid_xga[] = {
+	0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00,
+	0x31, 0xd8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x05, 0x16, 0x01, 0x03, 0x6d, 0x23, 0x1a, 0x78,
+	0xea, 0x5e, 0xc0, 0xa4, 0x59, 0x4a, 0x98, 0x25,
+	0x20, 0x50, 0x54, 0x00, 0x08, 0x00, 0x61, 0x40,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x64, 0x19,
+	0x00, 0x40, 0x41, 0x00, 0x26, 0x30, 0x08, 0x90,
+	0x36, 0x00, 0x63, 0x0a, 0x11, 0x00, 0x00, 0x18,
+	0x00, 0x00, 0x00, 0xff, 0x00, 0x4c, 0x69, 0x6e,
+	0x75, 0x78, 0x20, 0x23, 0x30, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x3b,
+	0x3d, 0x2f, 0x31, 0x07, 0x00, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xfc,
+	0x00, 0x4c, 0x69, 0x6e, 0x75, 0x78, 0x20, 0x58,
+	0x47, 0x41, 0x0a, 0x20, 0x20, 0x20, 0x00, 0x55,
+};
+
+/* 1920x1080 */
+static const u8 edid_fhd[] = {
+	0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00,
+	0x31, 0xd8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x05, 0x16, 0x01, 0x03, 0x6d, 0x32, 0x1c, 0x78,
+	0xea, 0x5e, 0xc0, 0xa4, 0x59, 0x4a, 0x98, 0x25,
+	0x20, 0x50, 0x54, 0x00, 0x00, 0x00, 0xd1, 0xc0,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x02, 0x3a,
+	0x80, 0x18, 0x71, 0x38, 0x2d, 0x40, 0x58, 0x2c,
+	0x45, 0x00, 0xf4, 0x19, 0x11, 0x00, 0x00, 0x1e,
+	0x00, 0x00, 0x00, 0xff, 0x00, 0x4c, 0x69, 0x6e,
+	0x75, 0x78, 0x20, 0x23, 0x30, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x3b,
+	0x3d, 0x42, 0x44, 0x0f, 0x00, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xfc,
+	0x00, 0x4c, 0x69, 0x6e, 0x75, 0x78, 0x20, 0x46,
+	0x48, 0x44, 0x0a, 0x20, 0x20, 0x20, 0x00, 0x05,
+};
+
+/* 1920x1080 hdmi */
+static const u8 edid_fhd_hdmi[] = {
+	0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00,
+	0x31, 0xd8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x05, 0x16, 0x01, 0x03, 0x6d, 0x32, 0x1c, 0x78,
+	0xea, 0x5e, 0xc0, 0xa4, 0x59, 0x4a, 0x98, 0x25,
+	0x20, 0x50, 0x54, 0x00, 0x00, 0x00, 0xd1, 0xc0,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x02, 0x3a,
+	0x80, 0x18, 0x71, 0x38, 0x2d, 0x40, 0x58, 0x2c,
+	0x45, 0x00, 0xf4, 0x19, 0x11, 0x00, 0x00, 0x1e,
+	0x00, 0x00, 0x00, 0xff, 0x00, 0x4c, 0x69, 0x6e,
+	0x75, 0x78, 0x20, 0x23, 0x30, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x3b,
+	0x3d, 0x42, 0x44, 0x0f, 0x00, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xfc,
+	0x00, 0x4c, 0x69, 0x6e, 0x75, 0x78, 0x20, 0x46,
+	0x48, 0x44, 0x0a, 0x20, 0x20, 0x20, 0x01, 0x04,
+	0x02, 0x03, 0x21, 0xf0, 0x4b, 0x90, 0x04, 0x03,
+	0x01, 0x05, 0x13, 0x14, 0x1f, 0x20, 0x21, 0x22,
+	0x23, 0x09, 0x07, 0x07, 0x83, 0x01, 0x00, 0x00,
+	0x68, 0x03, 0x0c, 0x00, 0x10, 0x00, 0xb8, 0x3c,
+	0x00, 0x01, 0x1d, 0x00, 0x72, 0x51, 0xd0, 0x1e,
+	0x20, 0x6e, 0x28, 0x55, 0x00, 0xc4, 0x8e, 0x21,
+	0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xb5,
+};
+
+/* 1920x1080 hdmi 2.0 */
+static const u8 edid_fhd_hdmi2[] = {
+	0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00,
+	0x31, 0xd8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x05, 0x16, 0x01, 0x03, 0x6d, 0x32, 0x1c, 0x78,
+	0xea, 0x5e, 0xc0, 0xa4, 0x59, 0x4a, 0x98, 0x25,
+	0x20, 0x50, 0x54, 0x00, 0x00, 0x00, 0xd1, 0xc0,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x02, 0x3a,
+	0x80, 0x18, 0x71, 0x38, 0x2d, 0x40, 0x58, 0x2c,
+	0x45, 0x00, 0xf4, 0x19, 0x11, 0x00, 0x00, 0x1e,
+	0x00, 0x00, 0x00, 0xff, 0x00, 0x4c, 0x69, 0x6e,
+	0x75, 0x78, 0x20, 0x23, 0x30, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x3b,
+	0x3d, 0x42, 0x44, 0x0f, 0x00, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xfc,
+	0x00, 0x4c, 0x69, 0x6e, 0x75, 0x78, 0x20, 0x46,
+	0x48, 0x44, 0x0a, 0x20, 0x20, 0x20, 0x02, 0x03,
+	0x02, 0x03, 0x21, 0xf0, 0x4b, 0x90, 0x04, 0x03,
+	0x01, 0x05, 0x13, 0x14, 0x1f, 0x20, 0x21, 0x22,
+	0x23, 0x09, 0x07, 0x07, 0x83, 0x01, 0x00, 0x00,
+	0x68, 0x03, 0x0c, 0x00, 0x10, 0x00, 0xb8, 0x3c,
+	0x00, 0x01, 0x1d, 0x00, 0x72, 0x51, 0xd0, 0x1e,
+	0x20, 0x6e, 0x28, 0x55, 0x00, 0xc4, 0x8e, 0x21,
+	0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0xb5,
+	0x02, 0x03, 0x2c, 0xf0, 0x4b, 0x90, 0x04, 0x03,
+	0x01, 0x05, 0x10, 0x1f, 0x5d, 0x5e, 0x5f, 0x61,
+	0x23, 0x09, 0x07, 0x07, 0x68, 0x03, 0x0c, 0x00,
+	0x10, 0x00, 0xb8, 0x3c, 0x00, 0x67, 0xd8, 0x5d,
+	0xc4, 0x01, 0x78, 0x80, 0x00, 0xe3, 0x0e, 0x60,
+	0x61, 0xe2, 0x0f, 0x01, 0x01, 0x1d, 0x00, 0x72,
+	0x51, 0xd0, 0x1e, 0x20, 0x6e, 0x28, 0x55, 0x00,
+	0xc4, 0x8e, 0x21, 0x00, 0x00, 0x1e, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x30,
+};
+
+/* 1920x1080 with every CEA-861 VIC */
+static const u8 edid_fhd_all_vics[] = {
+	0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00,
+	0x31, 0xd8, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x05, 0x16, 0x01, 0x03, 0x6d, 0x32, 0x1c, 0x78,
+	0xea, 0x5e, 0xc0, 0xa4, 0x59, 0x4a, 0x98, 0x25,
+	0x20, 0x50, 0x54, 0x00, 0x00, 0x00, 0xd1, 0xc0,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+	0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x02, 0x3a,
+	0x80, 0x18, 0x71, 0x38, 0x2d, 0x40, 0x58, 0x2c,
+	0x45, 0x00, 0xf4, 0x19, 0x11, 0x00, 0x00, 0x1e,
+	0x00, 0x00, 0x00, 0xff, 0x00, 0x4c, 0x69, 0x6e,
+	0x75, 0x78, 0x20, 0x23, 0x30, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x00, 0x00, 0x00, 0xfd, 0x00, 0x3b,
+	0x3d, 0x42, 0x44, 0x0f, 0x00, 0x0a, 0x20, 0x20,
+	0x20, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0xfc,
+	0x00, 0x4c, 0x69, 0x6e, 0x75, 0x78, 0x20, 0x46,
+	0x48, 0x44, 0x0a, 0x20, 0x20, 0x20, 0x01, 0x04,
+	0x02, 0x03, 0x73, 0x00, 0x5b, 0x01, 0x02, 0x03,
+	0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b,
+	0x0c, 0x0d, 0x0e, 0x0f, 0x10, 0x11, 0x12, 0x13,
+	0x14, 0x15, 0x16, 0x17, 0x18, 0x19, 0x1a, 0x1b,
+	0x5b, 0x1c, 0x1d, 0x1e, 0x1f, 0x20, 0x21, 0x22,
+	0x23, 0x24, 0x25, 0x26, 0x27, 0x28, 0x29, 0x2a,
+	0x2b, 0x2c, 0x2d, 0x2e, 0x2f, 0x30, 0x31, 0x32,
+	0x33, 0x34, 0x35, 0x36, 0x5b, 0x37, 0x38, 0x39,
+	0x3a, 0x3b, 0x3c, 0x3d, 0x3e, 0x3f, 0x40, 0x41,
+	0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48, 0x49,
+	0x4a, 0x4b, 0x4c, 0x4d, 0x4e, 0x4f, 0x50, 0x51,
+	0x5a, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
+	0x59, 0x5a, 0x5b, 0x5c, 0x5d, 0x5e, 0x5f, 0x60,
+	0x61, 0x62, 0x63, 0x64, 0x65, 0x66, 0x67, 0x68,
+	0x69, 0x6a, 0x6b, 0x00, 0x00, 0x00, 0x00, 0x00,
+	0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x8b,
+};
+
+static const struct {
+	const char *name;
+	const u8 *data;
+	size_t size;
+} corpus[] = {
+#define EDID(x) { #x, x, sizeof(x) }
+	EDID(edid_xga),
+	EDID(edid_fhd),
+	EDID(edid_fhd_hdmi),
+	EDID(edid_fhd_hdmi2),
+	EDID(edid_fhd_all_vics),
+#undef EDID
+};
+
+static int igt_sanitycheck(void *ignored)
+{
+	unsigned int n;
+
+	for (n = 0; n < ARRAY_SIZE(corpus); n++) {
+		struct edid *edid = (struct edid *)corpus[n].data;
+
+		if ((edid->extensions + 1) * EDID_LENGTH != corpus[n].size ||
+		    !drm_edid_is_valid(edid)) {
+			pr_err("corpus EDID %s is invalid\n", corpus[n].name);
+			return -EINVAL;
+		}
+	}
+
+	pr_info("%s - ok!\n", __func__);
+	return 0;
+}
+
+static struct drm_driver mock_driver = {
+	.driver_features = DRIVER_MODESET,
+};
+static const struct drm_mode_config_funcs mock_mode_config_funcs;
+static const struct drm_connector_funcs mock_connector_funcs;
+
+struct mock_connector {
+	struct drm_device dev;
+	struct drm_connector connector;
+};
+
+static struct drm_connector *mock_connector(void)
+{
+	struct mock_connector *mock;
+	int ret;
+
+	mock = kzalloc(sizeof(*mock), GFP_KERNEL);
+	if (!mock)
+		return NULL;
+
+	mock->dev.driver = &mock_driver;
+	drm_mode_config_init(&mock->dev);
+	mock->dev.mode_config.funcs = &mock_mode_config_funcs;
+
+	ret = drm_connector_init(&mock->dev, &mock->connector,
+				 &mock_connector_funcs,
+				 DRM_MODE_CONNECTOR_HDMIA);
+	if (ret) {
+		drm_mode_config_cleanup(&mock->dev);
+		kfree(mock);
+		return NULL;
+	}
+
+	return &mock->connector;
+}
+
+static void mock_connector_free(struct drm_connector *connector)
+{
+	struct mock_connector *mock =
+		container_of(connector, struct mock_connector, connector);
+
+	drm_connector_cleanup(&mock->connector);
+	drm_mode_config_cleanup(&mock->dev);
+	kfree(mock);
+}
+
+static void free_probed_modes(struct drm_connector *connector)
+{
+	struct drm_display_mode *mode, *t;
+
+	list_for_each_entry_safe(mode, t, &connector->probed_modes, head) {
+		list_del(&mode->head);
+		drm_mode_destroy(connector->dev, mode);
+	}
+}
+
+/* Moves the probed modes over to @modes for comparing them later on */
+static int add_modes(struct drm_connector *connector, unsigned int n,
+		     struct list_head *modes)
+{
+	int count;
+
+	count = drm_add_edid_modes(connector,
+				   (struct edid *)corpus[n].data);
+	list_splice_tail_init(&connector->probed_modes, modes);
+
+	return count;
+}
+
+static bool modes_equal(struct list_head *a, struct list_head *b)
+{
+	struct drm_display_mode *x, *y;
+
+	y = list_first_entry(b, typeof(*y), head);
+	list_for_each_entry(x, a, head) {
+		if (&y->head == b || !drm_mode_equal(x, y) ||
+		    x->type != y->type || strcmp(x->name, y->name))
+			return false;
+		y = list_next_entry(y, head);
+	}
+
+	return &y->head == b;
+}
+
+static int igt_cache(void *ignored)
+{
+	struct drm_connector *connector;
+	struct drm_hdmi_info hdmi;
+	LIST_HEAD(cold);
+	LIST_HEAD(warm);
+	unsigned long hits;
+	int count, err = 0;
+	unsigned int n;
+
+	connector = mock_connector();
+	if (!connector)
+		return -ENOMEM;
+
+	for (n = 0; n < ARRAY_SIZE(corpus); n++) {
+		drm_edid_cache_invalidate(connector);
+		count = add_modes(connector, n, &cold);
+		hdmi = connector->display_info.hdmi;
+
+		hits = connector->edid_cache.parse_hits;
+		if (add_modes(connector, n, &warm) != count) {
+			pr_err("%s: cached mode count differs\n",
+			       corpus[n].name);
+			err = -EINVAL;
+		} else if (connector->edid_cache.parse_hits != hits + 1) {
+			pr_err("%s: cache not used\n", corpus[n].name);
+			err = -EINVAL;
+		} else if (!modes_equal(&cold, &warm)) {
+			pr_err("%s: cached modes differ\n", corpus[n].name);
+			err = -EINVAL;
+		} else if (memcmp(&hdmi, &connector->display_info.hdmi,
+				  sizeof(hdmi))) {
+			pr_err("%s: cached hdmi info differs\n",
+			       corpus[n].name);
+			err = -EINVAL;
+		}
+
+		list_splice_init(&cold, &connector->probed_modes);
+		list_splice_init(&warm, &connector->probed_modes);
+		free_probed_modes(connector);
+		if (err)
+			break;
+	}
+
+	mock_connector_free(connector);
+	return err;
+}
+
+static int igt_add_modes(void *ignored)
+{
+	struct drm_connector *connector;
+	ktime_t cold, warm, start;
+	unsigned int n, i;
+	int count;
+
+	connector = mock_connector();
+	if (!connector)
+		return -ENOMEM;
+
+	for (n = 0; n < ARRAY_SIZE(corpus); n++) {
+		const struct edid *edid = (const struct edid *)corpus[n].data;
+
+		cold = 0;
+		warm = 0;
+		count = 0;
+		for (i = 0; i < max_iterations; i++) {
+			drm_edid_cache_invalidate(connector);
+
+			start = ktime_get();
+			count = drm_add_edid_modes(connector,
+						   (struct edid *)edid);
+			cold = ktime_add(cold, ktime_sub(ktime_get(), start));
+			free_probed_modes(connector);
+
+			start = ktime_get();
+			drm_add_edid_modes(connector, (struct edid *)edid);
+			warm = ktime_add(warm, ktime_sub(ktime_get(), start));
+			free_probed_modes(connector);
+
+			cond_resched();
+		}
+
+		pr_info("%s: %d modes, parsed in %lluns, cached in %lluns\n",
+			corpus[n].name, count,
+			div_u64(ktime_to_ns(cold), max(max_iterations, 1u)),
+			div_u64(ktime_to_ns(warm), max(max_iterations, 1u)));
+	}
+
+	mock_connector_free(connector);
+	return 0;
+}
+
+static int igt_match_vic(void *ignored)
+{
+	struct drm_connector *connector;
+	struct drm_display_mode *mode;
+	struct drm_display_mode miss;
+	unsigned int matched = 0, total = 0, lookups = 0, i;
+	ktime_t hits, misses, start;
+	int err = 0;
+
+	connector = mock_connector();
+	if (!connector)
+		return -ENOMEM;
+
+	drm_add_edid_modes(connector, (struct edid *)edid_fhd_all_vics);
+
+	list_for_each_entry(mode, &connector->probed_modes, head) {
+		if (drm_match_cea_mode(mode))
+			matched++;
+		total++;
+
+		/* No VIC is one pixel wider than another one */
+		miss = *mode;
+		miss.hdisplay++;
+		if (drm_match_cea_mode(&miss)) {
+			pr_err("%s with hdisplay %d matched VIC %u\n",
+			       mode->name, miss.hdisplay,
+			       drm_match_cea_mode(&miss));
+			err = -EINVAL;
+			goto out;
+		}
+	}
+
+	/* Every VIC from the video data blocks must match again */
+	if (matched < 107) {
+		pr_err("only %u modes matched a VIC\n", matched);
+		err = -EINVAL;
+		goto out;
+	}
+
+	hits = 0;
+	misses = 0;
+	for (i = 0; i < max_iterations; i++) {
+		start = ktime_get();
+		list_for_each_entry(mode, &connector->probed_modes, head)
+			drm_match_cea_mode(mode);
+		hits = ktime_add(hits, ktime_sub(ktime_get(), start));
+
+		start = ktime_get();
+		list_for_each_entry(mode, &connector->probed_modes, head) {
+			miss = *mode;
+			miss.clock += 1000;
+			drm_match_cea_mode(&miss);
+		}
+		misses = ktime_add(misses, ktime_sub(ktime_get(), start));
+
+		lookups += total;
+		cond_resched();
+	}
+
+	pr_info("VIC matching: %u of %u modes matched, %llups per lookup, %llups per miss\n",
+		matched, total,
+		div_u64(ktime_to_ns(hits) * 1000, max(lookups, 1u)),
+		div_u64(ktime_to_ns(misses) * 1000, max(lookups, 1u)));
+out:
+	free_probed_modes(connector);
+	mock_connector_free(connector);
+	return err;
+}
+
+static void fix_checksums(u8 *raw, size_t size)
+{
+	unsigned int block, i;
+	u8 csum;
+
+	for (block = 0; block < size / EDID_LENGTH; block++) {
+		u8 *data = raw + block * EDID_LENGTH;
+
+		csum = 0;
+		for (i = 0; i < EDID_LENGTH - 1; i++)
+			csum += data[i];
+		data[EDID_LENGTH - 1] = -csum;
+	}
+}
+
+static int igt_fuzz(void *ignored)
+{
+	unsigned int valid = 0, modes = 0, i, n, mutations, offset;
+	struct drm_connector *connector;
+	struct rnd_state prng;
+	size_t size;
+	u8 *raw;
+
+	prandom_seed_state(&prng, random_seed);
+
+	connector = mock_connector();
+	if (!connector)
+		return -ENOMEM;
+
+	raw = kmalloc(4 * EDID_LENGTH, GFP_KERNEL);
+	if (!raw) {
+		mock_connector_free(connector);
+		return -ENOMEM;
+	}
+
+	for (i = 0; i < max_iterations; i++) {
+		n = prandom_u32_state(&prng) % ARRAY_SIZE(corpus);
+		size = corpus[n].size;
+		if (WARN_ON(size > 4 * EDID_LENGTH))
+			continue;
+		memcpy(raw, corpus[n].data, size);
+
+		/*
+		 * Keep the header, extension count and block tags intact
+		 * and fix up the checksums afterwards, everything else is
+		 * fair game for the parser to cope with.
+		 */
+		mutations = 1 + prandom_u32_state(&prng) % 16;
+		while (mutations--) {
+			offset = prandom_u32_state(&prng) % size;
+			if (offset < 8 || offset == 0x7e ||
+			    offset % EDID_LENGTH == 0)
+				continue;
+			raw[offset] = prandom_u32_state(&prng);
+		}
+		fix_checksums(raw, size);
+
+		if (!drm_edid_is_valid((struct edid *)raw))
+			continue;
+
+		valid++;
+		modes += drm_add_edid_modes(connector, (struct edid *)raw);
+		free_probed_modes(connector);
+		cond_resched();
+	}
+
+	pr_info("%u mutated EDIDs, %u valid, %u modes added\n",
+		max_iterations, valid, modes);
+
+	kfree(raw);
+	mock_connector_free(connector);
+	return 0;
+}
+
+#include "drm_selftest.c"
+
+static int __init test_drm_edid_init(void)
+{
+	int err;
+
+	while (!random_seed)
+		random_seed = get_random_int();
+
+	pr_info("Testing EDID parsing with random_seed=0x%x max_iterations=%u\n",
+		random_seed, max_iterations);
+	err = run_selftests(selftests, ARRAY_SIZE(selftests), NULL);
+
+	return err > 0 ? 0 : err;
+}
+
+static void __exit test_drm_edid_exit(void)
+{
+}
+
+module_init(test_drm_edid_init);
+module_exit(test_drm_edid_exit);
+
+module_param(random_seed, uint, 0400);
+module_param(max_iterations, uint, 0400);
+
+MODULE_LICENSE("GPL");
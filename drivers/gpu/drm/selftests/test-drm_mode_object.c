@@ -0,0 +1,366 @@
+/*
+ * Test cases for drm_mode_object lookups
+ */
+
+#define pr_fmt(fmt) "drm_mode_object: " fmt
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/kthread.h>
+#include <linux/ktime.h>
+
+#include <drm/drmP.h>
+#include <drm/drm_mode_object.h>
+#include <drm/drm_property.h>
+
+#define TESTS "drm_mode_object_selftests.h"
+#include "drm_selftest.h"
+
+static unsigned int max_objects = 1024;
+static unsigned int max_lookups = 1 << 20;
+
+static int igt_sanitycheck(void *ignored)
+{
+	pr_info("%s - ok!\n", __func__);
+	return 0;
+}
+
+static const struct drm_mode_config_funcs mock_mode_config_funcs;
+
+static struct drm_device *mock_device(void)
+{
+	struct drm_device *dev;
+
+	dev = kzalloc(sizeof(*dev), GFP_KERNEL);
+	if (!dev)
+		return NULL;
+
+	drm_mode_config_init(dev);
+	dev->mode_config.funcs = &mock_mode_config_funcs;
+	return dev;
+}
+
+static void mock_device_free(struct drm_device *dev)
+{
+	drm_mode_config_cleanup(dev);
+	kfree(dev);
+}
+
+static struct drm_property_blob **create_blobs(struct drm_device *dev,
+					       unsigned int count)
+{
+	struct drm_property_blob **blobs;
+	unsigned int n;
+
+	blobs = kcalloc(count, sizeof(*blobs), GFP_KERNEL);
+	if (!blobs)
+		return NULL;
+
+	for (n = 0; n < count; n++) {
+		blobs[n] = drm_property_create_blob(dev, sizeof(n), &n);
+		if (IS_ERR(blobs[n])) {
+			while (n--)
+				drm_property_blob_put(blobs[n]);
+			kfree(blobs);
+			return NULL;
+		}
+	}
+
+	return blobs;
+}
+
+static void free_blobs(struct drm_property_blob **blobs, unsigned int count)
+{
+	unsigned int n;
+
+	for (n = 0; n < count; n++)
+		drm_property_blob_put(blobs[n]);
+	kfree(blobs);
+}
+
+static int igt_find(void *ignored)
+{
+	struct drm_property_blob **blobs;
+	struct drm_mode_object *obj;
+	struct drm_device *dev;
+	unsigned int n;
+	u32 id;
+	int err = -EINVAL;
+
+	dev = mock_device();
+	if (!dev)
+		return -ENOMEM;
+
+	blobs = create_blobs(dev, max_objects);
+	if (!blobs) {
+		err = -ENOMEM;
+		goto out_dev;
+	}
+
+	for (n = 0; n < max_objects; n++) {
+		id = blobs[n]->base.id;
+
+		obj = drm_mode_object_find(dev, NULL, id, DRM_MODE_OBJECT_BLOB);
+		if (obj != &blobs[n]->base) {
+			pr_err("lookup of blob %u returned %p, expected %p\n",
+			       id, obj, &blobs[n]->base);
+			goto out_blobs;
+		}
+		if (kref_read(&obj->refcount) != 2) {
+			pr_err("lookup of blob %u did not take a reference\n",
+			       id);
+			drm_mode_object_put(obj);
+			goto out_blobs;
+		}
+		drm_mode_object_put(obj);
+
+		obj = drm_mode_object_find(dev, NULL, id, DRM_MODE_OBJECT_ANY);
+		if (obj != &blobs[n]->base) {
+			pr_err("untyped lookup of blob %u failed\n", id);
+			goto out_blobs;
+		}
+		drm_mode_object_put(obj);
+
+		obj = drm_mode_object_find(dev, NULL, id, DRM_MODE_OBJECT_CRTC);
+		if (obj) {
+			pr_err("lookup of blob %u as a crtc succeeded\n", id);
+			drm_mode_object_put(obj);
+			goto out_blobs;
+		}
+	}
+
+	/* Once the last reference is gone the id must no longer resolve */
+	id = blobs[0]->base.id;
+	drm_property_blob_put(blobs[0]);
+	blobs[0] = NULL;
+
+	obj = drm_mode_object_find(dev, NULL, id, DRM_MODE_OBJECT_BLOB);
+	if (obj) {
+		pr_err("lookup of freed blob %u returned a stale object\n", id);
+		drm_mode_object_put(obj);
+		goto out_blobs;
+	}
+
+	err = 0;
+out_blobs:
+	for (n = 0; n < max_objects; n++)
+		if (blobs[n])
+			drm_property_blob_put(blobs[n]);
+	kfree(blobs);
+out_dev:
+	mock_device_free(dev);
+	return err;
+}
+
+struct lookup_thread {
+	struct drm_device *dev;
+	struct drm_property_blob **blobs;
+	unsigned int count;
+	unsigned int lookups;
+	unsigned long failed;
+	u64 elapsed_ns;
+};
+
+static int lookup_thread_fn(void *arg)
+{
+	struct lookup_thread *t = arg;
+	struct drm_mode_object *obj;
+	ktime_t start;
+	unsigned int n;
+
+	start = ktime_get();
+	for (n = 0; n < t->lookups; n++) {
+		obj = drm_mode_object_find(t->dev, NULL,
+					   t->blobs[n % t->count]->base.id,
+					   DRM_MODE_OBJECT_BLOB);
+		if (!obj) {
+			t->failed++;
+			continue;
+		}
+		drm_mode_object_put(obj);
+	}
+	t->elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	while (!kthread_should_stop())
+		schedule_timeout_interruptible(1);
+
+	return 0;
+}
+
+static int igt_lookup(void *ignored)
+{
+	const unsigned int ncpus = num_online_cpus();
+	struct drm_property_blob **blobs;
+	struct lookup_thread *threads;
+	struct task_struct **tsk;
+	struct drm_device *dev;
+	unsigned int nthreads, n;
+	int err = 0;
+
+	dev = mock_device();
+	if (!dev)
+		return -ENOMEM;
+
+	blobs = create_blobs(dev, max_objects);
+	threads = kcalloc(ncpus, sizeof(*threads), GFP_KERNEL);
+	tsk = kcalloc(ncpus, sizeof(*tsk), GFP_KERNEL);
+	if (!blobs || !threads || !tsk) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	/* Scale the number of readers to show whether lookups serialise */
+	for (nthreads = 1; nthreads <= ncpus; nthreads <<= 1) {
+		unsigned long failed = 0;
+		u64 total_ns = 0;
+
+		for (n = 0; n < nthreads; n++) {
+			threads[n].dev = dev;
+			threads[n].blobs = blobs;
+			threads[n].count = max_objects;
+			threads[n].lookups = max_lookups / nthreads;
+			threads[n].failed = 0;
+			threads[n].elapsed_ns = 0;
+
+			tsk[n] = kthread_run(lookup_thread_fn, &threads[n],
+					     "igt/lookup:%u", n);
+			if (IS_ERR(tsk[n])) {
+				err = PTR_ERR(tsk[n]);
+				break;
+			}
+		}
+
+		while (n--) {
+			kthread_stop(tsk[n]);
+			failed += threads[n].failed;
+			total_ns = max(total_ns, threads[n].elapsed_ns);
+		}
+		if (err)
+			goto out;
+
+		if (failed) {
+			pr_err("%lu lookups failed with %u threads\n",
+			       failed, nthreads);
+			err = -EINVAL;
+			goto out;
+		}
+
+		pr_info("%u threads: %u lookups in %llu us, %llu ns/lookup\n",
+			nthreads, max_lookups, div_u64(total_ns, NSEC_PER_USEC),
+			div_u64(total_ns * nthreads, max_lookups));
+	}
+
+out:
+	kfree(tsk);
+	kfree(threads);
+	if (blobs)
+		free_blobs(blobs, max_objects);
+	mock_device_free(dev);
+	return err;
+}
+
+static int igt_property_index(void *ignored)
+{
+	struct drm_property *props[DRM_OBJECT_MAX_PROPERTY];
+	struct drm_object_properties *properties;
+	struct drm_mode_object obj = {};
+	struct drm_device *dev;
+	ktime_t start;
+	u64 elapsed_ns;
+	unsigned int n;
+	uint64_t val;
+	int err = -EINVAL;
+
+	dev = mock_device();
+	if (!dev)
+		return -ENOMEM;
+
+	properties = kzalloc(sizeof(*properties), GFP_KERNEL);
+	if (!properties) {
+		err = -ENOMEM;
+		goto out_dev;
+	}
+
+	obj.type = DRM_MODE_OBJECT_ENCODER;
+	obj.properties = properties;
+
+	for (n = 0; n < ARRAY_SIZE(props); n++) {
+		props[n] = drm_property_create_range(dev, 0, "igt", 0, U64_MAX);
+		if (!props[n]) {
+			err = -ENOMEM;
+			goto out_props;
+		}
+		drm_object_attach_property(&obj, props[n], n);
+	}
+
+	for (n = 0; n < ARRAY_SIZE(props); n++) {
+		if (drm_object_property_get_value(&obj, props[n], &val) ||
+		    val != n) {
+			pr_err("property %u has value %llu, expected %u\n",
+			       props[n]->base.id, val, n);
+			goto out_props;
+		}
+
+		if (drm_object_property_set_value(&obj, props[n], 2 * n) ||
+		    drm_object_property_get_value(&obj, props[n], &val) ||
+		    val != 2 * n) {
+			pr_err("property %u did not keep its new value\n",
+			       props[n]->base.id);
+			goto out_props;
+		}
+	}
+
+	/* Lookups of properties that aren't attached must miss */
+	props[0] = drm_property_create_range(dev, 0, "igt", 0, U64_MAX);
+	if (!props[0]) {
+		err = -ENOMEM;
+		goto out_props;
+	}
+	if (!drm_object_property_get_value(&obj, props[0], &val)) {
+		pr_err("unattached property %u was found\n", props[0]->base.id);
+		goto out_props;
+	}
+
+	start = ktime_get();
+	for (n = 0; n < max_lookups; n++)
+		drm_object_property_get_value(&obj,
+					      props[1 + n % (ARRAY_SIZE(props) - 1)],
+					      &val);
+	elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+
+	pr_info("%u property lookups in %llu us, %llu ns/lookup\n",
+		max_lookups, div_u64(elapsed_ns, NSEC_PER_USEC),
+		div_u64(elapsed_ns, max_lookups));
+
+	err = 0;
+out_props:
+	kfree(properties);
+out_dev:
+	mock_device_free(dev);
+	return err;
+}
+
+#include "drm_selftest.c"
+
+static int __init test_drm_mode_object_init(void)
+{
+	int err;
+
+	pr_info("Testing mode object lookups with max_objects=%u max_lookups=%u\n",
+		max_objects, max_lookups);
+	err = run_selftests(selftests, ARRAY_SIZE(selftests), NULL);
+
+	return err > 0 ? 0 : err;
+}
+
+static void __exit test_drm_mode_object_exit(void)
+{
+}
+
+module_init(test_drm_mode_object_init);
+module_exit(test_drm_mode_object_exit);
+
+module_param(max_objects, uint, 0400);
+module_param(max_lookups, uint, 0400);
+
+MODULE_LICENSE("GPL");
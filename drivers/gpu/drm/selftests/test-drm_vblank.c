@@ -0,0 +1,344 @@
+/*
+ * Test cases for the per-pipe vblank event queues
+ */
+
+#define pr_fmt(fmt) "drm_vblank: " fmt
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/random.h>
+#include <linux/ktime.h>
+
+#include <drm/drmP.h>
+#include <drm/drm_vblank.h>
+
+#include "../drm_internal.h"
+
+#define TESTS "drm_vblank_selftests.h"
+#include "drm_selftest.h"
+
+static unsigned int random_seed;
+static unsigned int max_events = 8192;
+static unsigned int max_distance = 256;
+
+static int igt_sanitycheck(void *ignored)
+{
+	pr_info("%s - ok!\n", __func__);
+	return 0;
+}
+
+/* The queue position is tracked in user_data to check delivery order */
+static struct drm_pending_vblank_event *
+create_events(struct list_head *queue, unsigned int count, u64 base,
+	      struct rnd_state *prng)
+{
+	struct drm_pending_vblank_event *events;
+	unsigned int n;
+
+	events = kvmalloc_array(count, sizeof(*events), GFP_KERNEL | __GFP_ZERO);
+	if (!events)
+		return NULL;
+
+	for (n = 0; n < count; n++) {
+		events[n].sequence = base + 1 +
+			prandom_u32_state(prng) % max_distance;
+		events[n].event.vbl.user_data = n;
+		drm_vblank_event_insert(queue, &events[n], base);
+	}
+
+	return events;
+}
+
+/*
+ * Dispatches all events due at @seq like drm_handle_vblank_events() onto @done
+ * and checks that they come out in target sequence order, and in queueing
+ * order for the same sequence.
+ */
+static int dispatch_events(struct list_head *queue, u64 seq,
+			   struct list_head *done,
+			   struct drm_pending_vblank_event **last,
+			   unsigned int *count)
+{
+	struct drm_pending_vblank_event *e;
+
+	while ((e = drm_vblank_event_next_due(queue, seq))) {
+		/* Callers advance one vblank at a time, nothing may be late */
+		if (e->sequence != seq) {
+			pr_err("event for %llu delivered on %llu\n",
+			       e->sequence, seq);
+			return -EINVAL;
+		}
+
+		if (*last && (*last)->sequence == e->sequence &&
+		    (*last)->event.vbl.user_data > e->event.vbl.user_data) {
+			pr_err("events for %llu delivered out of order\n",
+			       e->sequence);
+			return -EINVAL;
+		}
+
+		if (*last && !drm_vblank_passed(e->sequence, (*last)->sequence)) {
+			pr_err("event for %llu delivered after %llu\n",
+			       e->sequence, (*last)->sequence);
+			return -EINVAL;
+		}
+
+		list_move_tail(&e->base.link, done);
+		*last = e;
+		(*count)++;
+	}
+
+	return 0;
+}
+
+static int check_order(u64 base, struct rnd_state *prng)
+{
+	struct drm_pending_vblank_event *events, *last = NULL;
+	unsigned int count = 0;
+	LIST_HEAD(queue);
+	LIST_HEAD(done);
+	u64 seq;
+	int err;
+
+	events = create_events(&queue, max_events, base, prng);
+	if (!events)
+		return -ENOMEM;
+
+	for (seq = base; seq != base + max_distance + 1; seq++) {
+		err = dispatch_events(&queue, seq, &done, &last, &count);
+		if (err)
+			goto out;
+	}
+
+	if (count != max_events || !list_empty(&queue)) {
+		pr_err("only %u of %u events delivered\n", count, max_events);
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = 0;
+out:
+	kvfree(events);
+	return err;
+}
+
+static int igt_order(void *ignored)
+{
+	struct rnd_state prng;
+
+	prandom_seed_state(&prng, random_seed);
+
+	return check_order(0, &prng);
+}
+
+static int igt_wrap(void *ignored)
+{
+	struct rnd_state prng;
+	int err;
+
+	prandom_seed_state(&prng, random_seed);
+
+	/* Sequences are compared with wraparound, check both 32 and 64 bits */
+	err = check_order(U32_MAX - max_distance / 2, &prng);
+	if (err)
+		return err;
+
+	return check_order(U64_MAX - max_distance / 2, &prng);
+}
+
+static int igt_pending(void *ignored)
+{
+	struct drm_pending_vblank_event *events, *last = NULL, *e, *t;
+	unsigned int count = 0, serial = max_events, pending;
+	unsigned int num_vblanks = 4 * max_distance;
+	struct rnd_state prng;
+	ktime_t start, elapsed;
+	LIST_HEAD(queue);
+	LIST_HEAD(done);
+	u64 seq;
+	int err;
+
+	prandom_seed_state(&prng, random_seed);
+
+	events = create_events(&queue, max_events, 0, &prng);
+	if (!events)
+		return -ENOMEM;
+
+	/*
+	 * Keep max_events pending at all times, like lots of clients
+	 * continuously queueing vblank waits, by requeueing every delivered
+	 * event a random number of vblanks ahead.
+	 */
+	start = ktime_get();
+	for (seq = 1; seq <= num_vblanks; seq++) {
+		err = dispatch_events(&queue, seq, &done, &last, &count);
+		if (err)
+			goto out;
+
+		list_for_each_entry_safe(e, t, &done, base.link) {
+			list_del(&e->base.link);
+			e->sequence = seq + 1 +
+				prandom_u32_state(&prng) % max_distance;
+			e->event.vbl.user_data = serial++;
+			drm_vblank_event_insert(&queue, e, seq);
+		}
+	}
+	elapsed = ktime_sub(ktime_get(), start);
+
+	pending = 0;
+	list_for_each_entry(e, &queue, base.link)
+		pending++;
+	if (pending != max_events) {
+		pr_err("%u events pending, expected %u\n", pending, max_events);
+		err = -EINVAL;
+		goto out;
+	}
+
+	pr_info("%u events delivered over %u vblanks with %u pending, %lluns per vblank\n",
+		count, num_vblanks, max_events,
+		div_u64(ktime_to_ns(elapsed), num_vblanks));
+
+	err = 0;
+out:
+	kvfree(events);
+	return err;
+}
+
+static int check_far_future(u64 base, struct rnd_state *prng)
+{
+	static const u64 far[] = {
+		0x10000000,		/* relative WAIT_VBLANK */
+		1ull << 23 | 1,		/* just outside drm_vblank_passed() */
+		U32_MAX,		/* far absolute 32 bit request */
+		1ull << 40,		/* 64 bit CRTC_QUEUE_SEQUENCE */
+	};
+	struct drm_pending_vblank_event *events, *last = NULL, *e;
+	struct drm_pending_vblank_event far_events[ARRAY_SIZE(far)] = {};
+	unsigned int count = 0, n;
+	LIST_HEAD(queue);
+	LIST_HEAD(done);
+	u64 seq;
+	int err;
+
+	/* Queue the far away targets first so they'd end up in front */
+	for (n = 0; n < ARRAY_SIZE(far); n++) {
+		far_events[n].sequence = base + far[n];
+		far_events[n].event.vbl.user_data = max_events + n;
+		drm_vblank_event_insert(&queue, &far_events[n], base);
+	}
+
+	events = create_events(&queue, max_events, base, prng);
+	if (!events)
+		return -ENOMEM;
+
+	for (seq = base; seq != base + max_distance + 1; seq++) {
+		err = dispatch_events(&queue, seq, &done, &last, &count);
+		if (err)
+			goto out;
+	}
+
+	if (count != max_events) {
+		pr_err("only %u of %u due events delivered with far away events queued\n",
+		       count, max_events);
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* Only the far away events are left, nearest first */
+	last = NULL;
+	n = 0;
+	list_for_each_entry(e, &queue, base.link) {
+		if (last && drm_vblank_event_distance(e->sequence, seq) <
+			 drm_vblank_event_distance(last->sequence, seq)) {
+			pr_err("event for %llu queued after %llu\n",
+			       e->sequence, last->sequence);
+			err = -EINVAL;
+			goto out;
+		}
+		last = e;
+		n++;
+	}
+	if (n != ARRAY_SIZE(far)) {
+		pr_err("%u far away events pending, expected %zu\n",
+		       n, ARRAY_SIZE(far));
+		err = -EINVAL;
+		goto out;
+	}
+
+	/* And each of them is delivered exactly when its vblank arrives */
+	count = 0;
+	while ((e = list_first_entry_or_null(&queue, typeof(*e), base.link))) {
+		if (drm_vblank_event_next_due(&queue, e->sequence - 1) ||
+		    drm_vblank_event_next_due(&queue, e->sequence) != e) {
+			pr_err("event for %llu not delivered on time\n",
+			       e->sequence);
+			err = -EINVAL;
+			goto out;
+		}
+
+		list_del(&e->base.link);
+		count++;
+	}
+
+	if (count != ARRAY_SIZE(far)) {
+		pr_err("only %u of %zu far away events delivered\n",
+		       count, ARRAY_SIZE(far));
+		err = -EINVAL;
+		goto out;
+	}
+
+	err = 0;
+out:
+	kvfree(events);
+	return err;
+}
+
+static int igt_far_future(void *ignored)
+{
+	struct rnd_state prng;
+	int err;
+
+	prandom_seed_state(&prng, random_seed);
+
+	/*
+	 * Events far ahead must not block due events behind them, also when
+	 * the distance crosses a 32 or 64 bit wraparound.
+	 */
+	err = check_far_future(0, &prng);
+	if (err)
+		return err;
+
+	err = check_far_future(U32_MAX - max_distance / 2, &prng);
+	if (err)
+		return err;
+
+	return check_far_future(U64_MAX - max_distance / 2, &prng);
+}
+
+#include "drm_selftest.c"
+
+static int __init test_drm_vblank_init(void)
+{
+	int err;
+
+	while (!random_seed)
+		random_seed = get_random_int();
+
+	pr_info("Testing vblank event queues with random_seed=0x%x max_events=%u max_distance=%u\n",
+		random_seed, max_events, max_distance);
+	err = run_selftests(selftests, ARRAY_SIZE(selftests), NULL);
+
+	return err > 0 ? 0 : err;
+}
+
+static void __exit test_drm_vblank_exit(void)
+{
+}
+
+module_init(test_drm_vblank_init);
+module_exit(test_drm_vblank_exit);
+
+module_param(random_seed, uint, 0400);
+module_param(max_events, uint, 0400);
+module_param(max_distance, uint, 0400);
+
+MODULE_LICENSE("GPL");
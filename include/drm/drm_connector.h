@@ -160,6 +160,43 @@ struct drm_hdmi_info {
 	u8 y420_dc_modes;
 };
 
+/**
+ * struct drm_edid_cache - last EDID parsed for a connector
+ *
+ * Sinks behind KVMs and docks tend to generate lots of hotplug events without
+ * actually changing, so drm_add_edid_modes() keeps the last result around to
+ * skip re-parsing an unchanged EDID. The EDID itself is always read again
+ * completely, the cache is only matched against what was read.
+ */
+struct drm_edid_cache {
+	/** @lock: Protects all members. */
+	struct mutex lock;
+
+	/**
+	 * @parsed: Last EDID parsed by drm_add_edid_modes() into an empty
+	 * probed mode list, or NULL.
+	 */
+	struct edid *parsed;
+
+	/** @modes: Modes drm_add_edid_modes() added for @parsed. */
+	struct list_head modes;
+
+	/** @num_modes: What drm_add_edid_modes() returned for @parsed. */
+	int num_modes;
+
+	/**
+	 * @hdmi: &drm_display_info.hdmi after parsing @parsed, which
+	 * mode parsing updates as well.
+	 */
+	struct drm_hdmi_info hdmi;
+
+	/** @color_formats: &drm_display_info.color_formats, likewise. */
+	u32 color_formats;
+
+	/** @parse_hits: Number of mode list parses that hit @parsed. */
+	unsigned long parse_hits;
+};
+
 /**
  * enum drm_link_status - connector's link_status property value
  *
@@ -755,6 +792,7 @@ struct drm_cmdline_mode {
  * @null_edid_counter: track sinks that give us all zeros for the EDID
  * @bad_edid_counter: track sinks that give us an EDID with invalid checksum
  * @edid_corrupt: indicates whether the last read EDID was corrupt
+ * @edid_cache: last EDID parsed for this connector
  * @debugfs_entry: debugfs directory for this connector
  * @has_tile: is this connector connected to a tiled monitor
  * @tile_group: tile group for the connected monitor
@@ -883,6 +921,8 @@ struct drm_connector {
 /* can cleanly poll for disconnections without flickering the screen */
 /* DACs should rarely do this without a lot of testing */
 #define DRM_CONNECTOR_POLL_DISCONNECT (1 << 2)
+/* detect can run concurrently with other connectors, see @polled */
+#define DRM_CONNECTOR_POLL_PARALLEL (1 << 3)
 
 	/**
 	 * @polled:
@@ -900,11 +940,49 @@ struct drm_connector {
 	 * DRM_CONNECTOR_POLL_DISCONNECT
 	 *     Periodically poll the connector for disconnection.
 	 *
+	 * DRM_CONNECTOR_POLL_PARALLEL
+	 *     The output poll worker may call &drm_connector_funcs.detect
+	 *     for this connector from a worker thread, concurrently with the
+	 *     detection of other connectors and without holding
+	 *     &drm_mode_config.mutex or &drm_mode_config.connection_mutex,
+	 *     so that slow DDC or AUX timeouts don't delay polling the
+	 *     remaining connectors. Calls are serialized against each other
+	 *     and against drm_helper_probe_single_connector_modes() with
+	 *     @detect_mutex. Only for connectors without
+	 *     &drm_connector_helper_funcs.detect_ctx whose detect callback
+	 *     doesn't rely on these locks.
+	 *
 	 * Set to 0 for connectors that don't support connection status
 	 * discovery.
 	 */
 	uint8_t polled;
 
+	/**
+	 * @detect_mutex: Serializes detection of %DRM_CONNECTOR_POLL_PARALLEL
+	 * connectors. drm_helper_probe_single_connector_modes() holds it
+	 * across &drm_connector_helper_funcs.get_modes as well, so that the
+	 * output poll worker doesn't change what detect left behind.
+	 */
+	struct mutex detect_mutex;
+
+	/**
+	 * @detect_work: Used by the output poll worker to detect
+	 * %DRM_CONNECTOR_POLL_PARALLEL connectors concurrently.
+	 */
+	struct work_struct detect_work;
+
+	/** @detect_status: Result of the last run of @detect_work. */
+	int detect_status;
+
+	/**
+	 * @detect_ns: Duration of the last call to the detect callbacks
+	 * through the probe helpers, to spot slow outputs.
+	 */
+	u64 detect_ns;
+
+	/** @detect_max_ns: Longest @detect_ns seen so far. */
+	u64 detect_max_ns;
+
 	/* requested DPMS state */
 	int dpms;
 
@@ -939,6 +1017,8 @@ struct drm_connector {
 	 */
 	bool edid_corrupt;
 
+	struct drm_edid_cache edid_cache;
+
 	struct dentry *debugfs_entry;
 
 	/**
@@ -957,6 +1037,15 @@ struct drm_connector {
 	 */
 	struct drm_connector_state *state;
 
+	/**
+	 * @spare_state:
+	 *
+	 * A released connector state kept by drm_atomic_helper_connector_destroy_state()
+	 * for reuse by drm_atomic_helper_connector_duplicate_state(). Only accessed
+	 * through xchg(), since states are released without holding any locks.
+	 */
+	struct drm_connector_state *spare_state;
+
 	/* DisplayID bits */
 	bool has_tile;
 	struct drm_tile_group *tile_group;
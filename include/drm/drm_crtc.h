@@ -813,6 +813,15 @@ struct drm_crtc {
 	 */
 	struct drm_crtc_state *state;
 
+	/**
+	 * @spare_state:
+	 *
+	 * A released CRTC state kept by drm_atomic_helper_crtc_destroy_state()
+	 * for reuse by drm_atomic_helper_crtc_duplicate_state(). Only accessed
+	 * through xchg(), since states are released without holding any locks.
+	 */
+	struct drm_crtc_state *spare_state;
+
 	/**
 	 * @commit_list:
 	 *
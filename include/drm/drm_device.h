@@ -154,9 +154,8 @@ struct drm_device {
 	u32 max_vblank_count;           /**< size of vblank counter register */
 
 	/**
-	 * List of events
+	 * Protects pending events, including &drm_vblank_crtc.event_list
 	 */
-	struct list_head vblank_event_list;
 	spinlock_t event_lock;
 
 	/*@} */
@@ -516,6 +516,17 @@ struct drm_dp_mst_topology_mgr {
 	 * @tx_msg_downq: List of pending down replies.
 	 */
 	struct list_head tx_msg_downq;
+	/**
+	 * @tx_down_inflight: Number of down requests sent completely and
+	 * still waiting for their reply. Protected by @qlock.
+	 */
+	int tx_down_inflight;
+	/**
+	 * @tx_down_busy: A down request chunk has been written since the last
+	 * short pulse, so the sink may not have consumed it yet. Protected by
+	 * @qlock.
+	 */
+	bool tx_down_busy;
 
 	/**
 	 * @payload_lock: Protect payload information.
@@ -315,6 +315,35 @@ struct drm_mode_config_funcs {
 	void (*atomic_state_free)(struct drm_atomic_state *state);
 };
 
+#define DRM_ATOMIC_STATE_CACHE_SIZE 4
+
+/**
+ * struct drm_atomic_state_cache - recycled atomic state containers
+ *
+ * Drivers which don't subclass &drm_atomic_state get their states from this
+ * per-device cache, so that the arrays sized to the number of CRTCs, planes
+ * and connectors don't have to be allocated again for every commit. The
+ * default CRTC, plane and connector state helpers similarly keep one spare
+ * state per object around, see drm_atomic_helper_plane_duplicate_state().
+ */
+struct drm_atomic_state_cache {
+	/** @lock: Protects @states and @count. */
+	spinlock_t lock;
+	/** @count: Number of cached states in @states. */
+	unsigned int count;
+	/** @states: Cleared states ready for reuse. */
+	struct drm_atomic_state *states[DRM_ATOMIC_STATE_CACHE_SIZE];
+
+	/** @allocs: Atomic states allocated from scratch. */
+	atomic_long_t allocs;
+	/** @reuses: Atomic states taken from @states instead. */
+	atomic_long_t reuses;
+	/** @obj_allocs: Object states allocated by the default helpers. */
+	atomic_long_t obj_allocs;
+	/** @obj_reuses: Object states the default helpers recycled instead. */
+	atomic_long_t obj_reuses;
+};
+
 /**
  * struct drm_mode_config - Mode configuration control structure
  * @min_width: minimum pixel width on this device
@@ -801,6 +830,14 @@ struct drm_mode_config {
 	 */
 	struct drm_atomic_state *suspend_state;
 
+	/**
+	 * @atomic_state_cache:
+	 *
+	 * Recycled atomic state containers and allocation statistics, see
+	 * &struct drm_atomic_state_cache.
+	 */
+	struct drm_atomic_state_cache atomic_state_cache;
+
 	const struct drm_mode_config_helper_funcs *helper_private;
 };
 
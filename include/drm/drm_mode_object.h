@@ -61,6 +61,7 @@ struct drm_mode_object {
 };
 
 #define DRM_OBJECT_MAX_PROPERTY 24
+#define DRM_OBJECT_PROPERTY_INDEX_BITS 5
 /**
  * struct drm_object_properties - property tracking for &drm_mode_object
  */
@@ -100,6 +101,22 @@ struct drm_object_properties {
 	 * without the DRM_MODE_PROP_IMMUTABLE flag set.
 	 */
 	uint64_t values[DRM_OBJECT_MAX_PROPERTY];
+
+	/**
+	 * @index: Open addressed hash table mapping property ids to their
+	 * slot in @properties plus one, zero marks an empty bucket. Built by
+	 * drm_object_attach_property() so that lookups by id or pointer don't
+	 * have to scan @properties.
+	 */
+	u8 index[1 << DRM_OBJECT_PROPERTY_INDEX_BITS];
+
+	/**
+	 * @kinds: Which core state member each entry in @properties decodes
+	 * to, classified once at attach time so that atomic property parsing
+	 * can switch on it instead of comparing against every core property.
+	 * Zero for driver private properties.
+	 */
+	u8 kinds[DRM_OBJECT_MAX_PROPERTY];
 };
 
 /* Avoid boilerplate.  I'm tired of typing. */
@@ -28,6 +28,23 @@
 
 struct drm_modeset_lock;
 
+/**
+ * struct drm_modeset_lock_stats - lock statistics of an acquire context
+ * @locks: number of locks taken
+ * @deadlocks: number of times -EDEADLK was returned
+ * @backoffs: number of calls to drm_modeset_backoff()
+ * @wait_ns: total time spent acquiring locks
+ *
+ * Only collected when &drm_modeset_acquire_ctx.stats is set, which is meant
+ * for benchmarks like the atomic_replay debugfs file.
+ */
+struct drm_modeset_lock_stats {
+	unsigned long locks;
+	unsigned long deadlocks;
+	unsigned long backoffs;
+	u64 wait_ns;
+};
+
 /**
  * struct drm_modeset_acquire_ctx - locking context (see ww_acquire_ctx)
  * @ww_ctx: base acquire ctx
@@ -35,6 +52,7 @@ struct drm_modeset_lock;
  * @locked: list of held locks
  * @trylock_only: trylock mode used in atomic contexts/panic notifiers
  * @interruptible: whether interruptible locking should be used.
+ * @stats: optional lock statistics, set after drm_modeset_acquire_init()
  *
  * Each thread competing for a set of locks must use one acquire
  * ctx.  And if any lock fxn returns -EDEADLK, it must backoff and
@@ -63,6 +81,9 @@ struct drm_modeset_acquire_ctx {
 
 	/* Perform interruptible waits on this context. */
 	bool interruptible;
+
+	/* Lock statistics, NULL unless someone is measuring. */
+	struct drm_modeset_lock_stats *stats;
 };
 
 /**
@@ -556,6 +556,15 @@ struct drm_plane {
 	 */
 	struct drm_plane_state *state;
 
+	/**
+	 * @spare_state:
+	 *
+	 * A released plane state kept by drm_atomic_helper_plane_destroy_state()
+	 * for reuse by drm_atomic_helper_plane_duplicate_state(). Only accessed
+	 * through xchg(), since states are released without holding any locks.
+	 */
+	struct drm_plane_state *spare_state;
+
 	struct drm_property *zpos_property;
 	struct drm_property *rotation_property;
 };
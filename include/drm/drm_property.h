@@ -195,6 +195,8 @@ struct drm_property {
  * 	&drm_mode_config.property_blob_list.
  * @head_file: entry on the per-file blob list in &drm_file.blobs list.
  * @length: size of the blob in bytes, invariant over the lifetime of the object
+ * @rcu: RCU head, blobs are freed after a grace period since
+ * 	__drm_mode_object_find() looks them up without &drm_mode_config.idr_mutex
  * @data: actual data, embedded at the end of this structure
  *
  * Blobs are used to store bigger values than what fits directly into the 64
@@ -209,6 +211,7 @@ struct drm_property_blob {
 	struct list_head head_global;
 	struct list_head head_file;
 	size_t length;
+	struct rcu_head rcu;
 	unsigned char data[];
 };
 
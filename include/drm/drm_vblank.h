@@ -150,6 +150,13 @@ struct drm_vblank_crtc {
 	 */
 	struct drm_display_mode hwmode;
 
+	/**
+	 * @event_list: Pending vblank events for this pipe, sorted by
+	 * &drm_pending_vblank_event.sequence. Protected by
+	 * &drm_device.event_lock.
+	 */
+	struct list_head event_list;
+
 	/**
 	 * @enabled: Tracks the enabling state of the corresponding &drm_crtc to
 	 * avoid double-disabling and hence corrupting saved state. Needed by